@@ -0,0 +1,119 @@
+//
+// Generated by protoc-gen-protorpc. DO NOT EDIT!
+// source: checks.proto
+//
+#ifndef __PROTORPC_CHECKS_H__
+#define __PROTORPC_CHECKS_H__
+
+#include "checks.pb.h"
+#include "protoServer.hpp"
+#include "protoClient.hpp"
+
+namespace checks {
+
+//
+// CheckerMethods: method ids (REQ_ID) of service Checker
+//
+struct CheckerMethods
+{
+    static constexpr uint32_t EchoId = gen::MethodId("/checks.Checker/Echo");
+    static constexpr uint32_t UploadId = gen::MethodId("/checks.Checker/Upload");
+};
+
+//
+// CheckerService: ProtoServer base class for service Checker
+//
+template<class BASE = gen::ProtoServer>
+class CheckerService : public BASE
+{
+public:
+    using BASE::BASE;
+    virtual ~CheckerService() = default;
+
+    static constexpr uint32_t EchoId = CheckerMethods::EchoId;
+    static constexpr uint32_t UploadId = CheckerMethods::UploadId;
+
+protected:
+    using typename BASE::Context;
+    using typename BASE::Handler;
+    template<class REQ> using StreamReader = typename BASE::template StreamReader<REQ>;
+
+    // Service methods to implement
+    virtual void OnEcho(const Context& ctx, const ::checks::EchoRequest& req, ::checks::EchoResponse& resp) = 0;
+    virtual void OnUpload(const Context& ctx, StreamReader<::checks::EchoRequest>& reader, ::checks::EchoResponse& resp) = 0;
+
+    // Method id dispatch
+    virtual Handler* GetMethodHandler(uint32_t methodId) override
+    {
+        switch(methodId)
+        {
+        case EchoId: return &mEchoHandler;
+        case UploadId: return &mUploadHandler;
+        default: return BASE::GetMethodHandler(methodId);
+        }
+    }
+
+private:
+    // The ids are checked against those of the other services of the server
+    const bool mMethodIdsRegistered{this->RegisterMethodIds({
+        {EchoId, "/checks.Checker/Echo"},
+        {UploadId, "/checks.Checker/Upload"}
+    })};
+
+    typename BASE::template HandlerImpl<CheckerService, ::checks::EchoRequest, ::checks::EchoResponse> mEchoHandler{this, &CheckerService::OnEcho};
+    typename BASE::template ClientStreamHandlerImpl<CheckerService, ::checks::EchoRequest, ::checks::EchoResponse> mUploadHandler{this, &CheckerService::OnUpload};
+};
+
+//
+// CheckerClient: ProtoClient stub for service Checker
+//
+class CheckerClient : public gen::ProtoClient
+{
+public:
+    using gen::ProtoClient::ProtoClient;
+
+    bool Echo(const ::checks::EchoRequest& req, ::checks::EchoResponse& resp,
+            const std::map<std::string, std::string>& metadata,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(CheckerMethods::EchoId, req, resp, metadata, errMsg, timeoutMs);
+    }
+
+    bool Echo(const ::checks::EchoRequest& req, ::checks::EchoResponse& resp,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(CheckerMethods::EchoId, req, resp,
+                    std::map<std::string, std::string>(), errMsg, timeoutMs);
+    }
+
+    // Receives the file attached to the response (see gen::ProtoAttachment)
+    bool Echo(const ::checks::EchoRequest& req, ::checks::EchoResponse& resp,
+            const std::map<std::string, std::string>& metadata,
+            gen::ProtoAttachment& attachment,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(CheckerMethods::EchoId, req, resp, metadata, attachment, errMsg, timeoutMs);
+    }
+
+    // Client streaming: nextRequest fills the next message, or returns false at the end of the stream
+    bool Upload(const std::function<bool(::checks::EchoRequest&)>& nextRequest,
+            ::checks::EchoResponse& resp,
+            const std::map<std::string, std::string>& metadata,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        ::checks::EchoRequest req;
+        return CallBidiStream(CheckerMethods::UploadId, req, [&]() { req.Clear(); return nextRequest(req); },
+                              resp, []() { return true; }, metadata, errMsg, timeoutMs);
+    }
+
+    bool Upload(const std::function<bool(::checks::EchoRequest&)>& nextRequest,
+            ::checks::EchoResponse& resp,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Upload(nextRequest, resp, std::map<std::string, std::string>(), errMsg, timeoutMs);
+    }
+};
+
+} // namespace checks
+
+#endif // __PROTORPC_CHECKS_H__
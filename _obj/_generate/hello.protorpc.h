@@ -0,0 +1,94 @@
+//
+// Generated by protoc-gen-protorpc. DO NOT EDIT!
+// source: hello.proto
+//
+#ifndef __PROTORPC_HELLO_H__
+#define __PROTORPC_HELLO_H__
+
+#include "hello.pb.h"
+#include "protoServer.hpp"
+#include "protoClient.hpp"
+
+namespace test {
+
+//
+// GreeterMethods: method ids (REQ_ID) of service Greeter
+//
+struct GreeterMethods
+{
+    static constexpr uint32_t PingId = gen::MethodId("/test.Greeter/Ping");
+};
+
+//
+// GreeterService: ProtoServer base class for service Greeter
+//
+template<class BASE = gen::ProtoServer>
+class GreeterService : public BASE
+{
+public:
+    using BASE::BASE;
+    virtual ~GreeterService() = default;
+
+    static constexpr uint32_t PingId = GreeterMethods::PingId;
+
+protected:
+    using typename BASE::Context;
+    using typename BASE::Handler;
+
+    // Service methods to implement
+    virtual void OnPing(const Context& ctx, const ::test::PingRequest& req, ::test::PingResponse& resp) = 0;
+
+    // Method id dispatch
+    virtual Handler* GetMethodHandler(uint32_t methodId) override
+    {
+        switch(methodId)
+        {
+        case PingId: return &mPingHandler;
+        default: return BASE::GetMethodHandler(methodId);
+        }
+    }
+
+private:
+    // The ids are checked against those of the other services of the server
+    const bool mMethodIdsRegistered{this->RegisterMethodIds({
+        {PingId, "/test.Greeter/Ping"}
+    })};
+
+    typename BASE::template HandlerImpl<GreeterService, ::test::PingRequest, ::test::PingResponse> mPingHandler{this, &GreeterService::OnPing};
+};
+
+//
+// GreeterClient: ProtoClient stub for service Greeter
+//
+class GreeterClient : public gen::ProtoClient
+{
+public:
+    using gen::ProtoClient::ProtoClient;
+
+    bool Ping(const ::test::PingRequest& req, ::test::PingResponse& resp,
+            const std::map<std::string, std::string>& metadata,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(GreeterMethods::PingId, req, resp, metadata, errMsg, timeoutMs);
+    }
+
+    bool Ping(const ::test::PingRequest& req, ::test::PingResponse& resp,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(GreeterMethods::PingId, req, resp,
+                    std::map<std::string, std::string>(), errMsg, timeoutMs);
+    }
+
+    // Receives the file attached to the response (see gen::ProtoAttachment)
+    bool Ping(const ::test::PingRequest& req, ::test::PingResponse& resp,
+            const std::map<std::string, std::string>& metadata,
+            gen::ProtoAttachment& attachment,
+            std::string& errMsg, long timeoutMs = 5000)
+    {
+        return Call(GreeterMethods::PingId, req, resp, metadata, attachment, errMsg, timeoutMs);
+    }
+};
+
+} // namespace test
+
+#endif // __PROTORPC_HELLO_H__
@@ -0,0 +1,1036 @@
+//
+// checks.cpp
+//
+// Runnable checks of the transports and of the server features, each one
+// against a server started in this process for it.
+//
+// Usage: checks [check name ...]  (default: all of them, see make check)
+//
+#include <iostream>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <signal.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include "checks.protorpc.h"
+
+const char* CHECK_SOCKET = "protorpc_checks.sock";     // In the abstract namespace
+
+// The server of the checks: Echo replies with the request's id and data,
+// after the request's delay and with its error. Upload reads the requests
+// after their delay, and replies with their count.
+class CheckServer : public checks::CheckerService<>
+{
+public:
+    using checks::CheckerService<>::CheckerService;
+
+    std::atomic<int> echoCalls{0};
+
+    // Upload: the request data bytes the client has sent (counted by the client),
+    // and the most of them sent but not read yet by the handler
+    std::atomic<size_t> uploadSent{0};
+    size_t uploadMaxAhead{0};
+
+    std::vector<std::string> GetErrors() const
+    {
+        std::lock_guard<std::mutex> lock(mErrorsMutex);
+        return mErrors;
+    }
+
+private:
+    virtual bool OnInit() override { return true; }
+
+    // The errors are kept for the checks, and shown if one fails
+    virtual void OnError(const char* fname, int lineNum, const std::string& err) const override
+    {
+        std::lock_guard<std::mutex> lock(mErrorsMutex);
+        mErrors.push_back(std::string(fname) + ":" + std::to_string(lineNum) + " " + err);
+    }
+
+    virtual void OnInfo(const char* /*fname*/, int /*lineNum*/, const std::string& /*info*/) const override {}
+
+    virtual void OnEcho(const Context& ctx, const checks::EchoRequest& req, checks::EchoResponse& resp) override
+    {
+        echoCalls++;
+        if(req.delay_ms() > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(req.delay_ms()));
+        if(!req.error().empty())
+            ctx.SetError(req.error());
+        resp.set_id(req.id());
+        resp.set_data(req.data());
+    }
+
+    virtual void OnUpload(const Context& ctx, StreamReader<checks::EchoRequest>& reader,
+                          checks::EchoResponse& resp) override
+    {
+        checks::EchoRequest req;
+        int count = 0;
+        size_t read = 0;
+        while(reader.Read(req))
+        {
+            if(req.id() != count++)
+                ctx.SetError("Request " + std::to_string(req.id()) + " out of order");
+            read += req.data().size();
+            uploadMaxAhead = std::max(uploadMaxAhead, uploadSent - read);
+            if(req.delay_ms() > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(req.delay_ms()));
+        }
+        resp.set_id(count);
+    }
+
+    mutable std::mutex mErrorsMutex;
+    mutable std::vector<std::string> mErrors;
+};
+
+// size bytes that differ with seed, to tell a misplaced byte
+std::string Pattern(size_t size, int seed)
+{
+    std::string data(size, '\0');
+    for(size_t i = 0; i < size; i++)
+        data[i] = static_cast<char>(seed + i * 31 + i / 251);
+    return data;
+}
+
+bool Connect(gen::ProtoClient& client, std::string& errMsg)
+{
+    std::string path = std::string(1, '\0') + CHECK_SOCKET;
+    return client.Init(path.c_str(), errMsg);
+}
+
+// Start server, run check once it accepts connections, and stop it.
+// On failure, errMsg ends with the errors the server logged.
+bool RunWithServer(CheckServer& server, const std::function<bool(std::string&)>& check, std::string& errMsg)
+{
+    bool started = true;
+    std::thread serverThread([&server, &started]() { started = server.Start(CHECK_SOCKET, true); });
+
+    // Note: The probe connection is closed before the check
+    bool connected = false;
+    for(int i = 0; i < 300 && !connected; i++)
+    {
+        gen::ProtoClient client;
+        if(!(connected = Connect(client, errMsg)))
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    bool res = (connected && check(errMsg));
+
+    server.Stop();
+    serverThread.join();
+    if(!started)
+        errMsg = "The server failed to start";
+    if(!res)
+    {
+        for(const std::string& err : server.GetErrors())
+            errMsg += "\n    server: " + err;
+    }
+    return (res && started);
+}
+
+// A connection without ProtoClient, to send the frames it never would
+class RawConnection
+{
+public:
+    static constexpr long TIMEOUT_MS = 3000;
+
+    RawConnection()
+    {
+        std::string path = std::string(1, '\0') + CHECK_SOCKET;
+        mSock = gen::SetupClientDomainSocket(path.c_str(), mErrMsg, SOCK_STREAM);
+    }
+    ~RawConnection() { if(mSock > 0) close(mSock); }
+
+    int Get() const { return mSock; }
+
+    bool Send(std::initializer_list<uint32_t> values, std::string& errMsg)
+    {
+        for(uint32_t value : values)
+        {
+            if(!gen::ProtoSendInteger(mSock, value, TIMEOUT_MS, errMsg))
+                return false;
+        }
+        return true;
+    }
+
+    bool Send(const void* data, size_t len, std::string& errMsg)
+    {
+        return gen::ProtoSend(mSock, data, len, TIMEOUT_MS, errMsg);
+    }
+
+    // REQ_ID of methodId, answered with ACK
+    bool StartCall(uint32_t methodId, std::string& errMsg)
+    {
+        uint32_t code = 0;
+        return (Send({gen::PROTO_CODE::REQ_ID, methodId}, errMsg) &&
+                gen::ProtoRecvInteger(mSock, code, TIMEOUT_MS, errMsg) &&
+                gen::ProtoValidateCode(code, gen::PROTO_CODE::ACK, errMsg));
+    }
+
+    // The error of a failed call: an empty response, then ERR
+    bool RecvError(std::string& error, std::string& errMsg)
+    {
+        std::string resp;
+        return (gen::ProtoRecvData(mSock, gen::PROTO_CODE::RESP, resp, TIMEOUT_MS, errMsg) &&
+                gen::ProtoRecvData(mSock, gen::PROTO_CODE::ERR, error, TIMEOUT_MS, errMsg));
+    }
+
+    // Does the server close the connection (skipping what it sends before)?
+    bool IsClosedByServer()
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+        while(std::chrono::steady_clock::now() < deadline)
+        {
+            pollfd fds = {mSock, POLLIN, 0};
+            if(poll(&fds, 1, 100) <= 0)
+                continue;
+            char buf[4096];
+            ssize_t res = recv(mSock, buf, sizeof(buf), 0);
+            if(res == 0 || (res < 0 && errno == ECONNRESET))
+                return true;
+        }
+        return false;
+    }
+
+private:
+    int mSock{-1};
+    std::string mErrMsg;
+};
+
+// Echo req and check the response
+bool CheckEcho(checks::CheckerClient& client, const checks::EchoRequest& req, std::string& errMsg)
+{
+    checks::EchoResponse resp;
+    if(!client.Echo(req, resp, errMsg))
+    {
+        errMsg = "Echo " + std::to_string(req.id()) + " failed: " + errMsg;
+        return false;
+    }
+    if(!errMsg.empty() || resp.id() != req.id() || resp.data() != req.data())
+    {
+        errMsg = "Echo " + std::to_string(req.id()) + ": wrong response (" + errMsg + ")";
+        return false;
+    }
+    return true;
+}
+
+// Shared memory transport: a ring much smaller than the messages, so that they
+// wrap around it at every offset and those larger than the ring go in pieces
+bool CheckShmWraparound(std::string& errMsg)
+{
+    const size_t ringSize = 64 * 1024;
+    CheckServer server(2);
+    server.SetShmTransport(true);
+    return RunWithServer(server, [ringSize](std::string& errMsg)
+    {
+        checks::CheckerClient client;
+        if(!Connect(client, errMsg) || !client.InitShm(errMsg, ringSize))
+            return false;
+
+        checks::EchoRequest req;
+        for(int i = 0; i < 300; i++)
+        {
+            req.set_id(i);
+            req.set_data(Pattern((i * 7919) % (3 * ringSize), i));
+            if(!CheckEcho(client, req, errMsg))
+                return false;
+        }
+        return true;
+    }, errMsg);
+}
+
+// The same calls with the epoll and the io_uring event loops: concurrent
+// connections, messages from empty to a few MB (memfd payloads), and errors
+bool CheckEventBackends(std::string& errMsg)
+{
+    for(gen::EventBackend backend : {gen::EventBackend::EPOLL, gen::EventBackend::IO_URING})
+    {
+        const char* name = (backend == gen::EventBackend::EPOLL ? "epoll" : "io_uring");
+        CheckServer server(4, backend);
+        bool res = RunWithServer(server, [](std::string& errMsg)
+        {
+            std::vector<std::thread> threads;
+            std::vector<std::string> errors(8);
+            for(size_t i = 0; i < errors.size(); i++)
+            {
+                threads.emplace_back([i, &errors]()
+                {
+                    checks::CheckerClient client;
+                    if(!Connect(client, errors[i]))
+                        return;
+
+                    checks::EchoRequest req;
+                    for(int j = 0; j < 100 && errors[i].empty(); j++)
+                    {
+                        req.set_id(j);
+                        req.set_data(Pattern(j % 25 == 24 ? 3 * 1024 * 1024 : (j * j * 97) % 300000, j));
+                        std::string err;
+                        if(!CheckEcho(client, req, err))
+                            errors[i] = err;
+                    }
+
+                    req.set_error("refused");
+                    checks::EchoResponse resp;
+                    std::string err;
+                    if(!client.Echo(req, resp, err) || err != "refused")
+                        errors[i] = "Echo with an error: '" + err + "'";
+                });
+            }
+            for(std::thread& thread : threads)
+                thread.join();
+
+            for(const std::string& err : errors)
+            {
+                if(!err.empty())
+                {
+                    errMsg = err;
+                    return false;
+                }
+            }
+            return true;
+        }, errMsg);
+        if(!res)
+        {
+            errMsg = std::string(name) + ": " + errMsg;
+            return false;
+        }
+
+        for(const std::string& err : server.GetErrors())
+        {
+            if(err.find("falling back to epoll") != std::string::npos)
+                std::cout << "  note: io_uring is not available, both runs used epoll" << std::endl;
+        }
+    }
+    return true;
+}
+
+// Client-streaming flow control: a handler reading slower than the client
+// sends. The client must stay within the window the server grants, instead
+// of filling the socket (and the server's memory).
+bool CheckStreamWindow(std::string& errMsg)
+{
+    const size_t window = 64 * 1024;
+    const size_t messageSize = 4 * 1024;
+    const int count = 256;     // 1 MB, 16 windows
+    CheckServer server(2);
+    server.SetStreamWindow(window);
+    return RunWithServer(server, [&server, window, messageSize, count](std::string& errMsg)
+    {
+        checks::CheckerClient client;
+        if(!Connect(client, errMsg))
+            return false;
+
+        int sent = 0;
+        checks::EchoResponse resp;
+        if(!client.Upload([&](checks::EchoRequest& req)
+        {
+            if(sent == count)
+                return false;
+            req.set_id(sent++);
+            req.set_data(Pattern(messageSize, sent));
+            req.set_delay_ms(2);
+            server.uploadSent += messageSize;
+            return true;
+        }, resp, errMsg) || !errMsg.empty())
+        {
+            errMsg = "Upload failed: " + errMsg;
+            return false;
+        }
+
+        if(resp.id() != count)
+        {
+            errMsg = "The handler read " + std::to_string(resp.id()) + " requests of " + std::to_string(count);
+            return false;
+        }
+        // The request being filled may be counted before it waits for the window
+        if(server.uploadMaxAhead > window + messageSize)
+        {
+            errMsg = "The client sent " + std::to_string(server.uploadMaxAhead) + " bytes ahead of the handler, " +
+                     "the window is " + std::to_string(window);
+            return false;
+        }
+        return true;
+    }, errMsg);
+}
+
+// Frames no client would send: the server must close the connection (without
+// allocating the lengths announced) and keep serving the other clients
+bool CheckMalformedFrames(std::string& errMsg)
+{
+    const uint32_t echoId = checks::CheckerService<>::EchoId;
+    const uint64_t hugeLength = htobe64(1ull << 40);
+    const char partial[10] = {};
+    // The frames of a case close the connection, except for a request that
+    // doesn't parse: well framed, it only fails its call
+    struct Case
+    {
+        const char* name;
+        std::function<bool(RawConnection&, std::string&)> send;
+        bool closes{true};
+    };
+    const Case cases[] =
+    {
+        {"unknown code", [](RawConnection& conn, std::string& errMsg)
+        {
+            return conn.Send({4242}, errMsg);
+        }},
+        {"unexpected code", [](RawConnection& conn, std::string& errMsg)
+        {
+            return conn.Send({gen::PROTO_CODE::RESP, 0}, errMsg);
+        }},
+        {"request without its method", [](RawConnection& conn, std::string& errMsg)
+        {
+            return conn.Send({gen::PROTO_CODE::REQ, 0}, errMsg);
+        }},
+        {"truncated request", [&](RawConnection& conn, std::string& errMsg)
+        {
+            bool res = (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, 1000}, errMsg) &&
+                        conn.Send(partial, sizeof(partial), errMsg));
+            shutdown(conn.Get(), SHUT_WR);
+            return res;
+        }},
+        {"truncated length", [&](RawConnection& conn, std::string& errMsg)
+        {
+            bool res = (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, gen::PROTO_LONG_PAYLOAD}, errMsg) &&
+                        conn.Send(partial, 3, errMsg));
+            shutdown(conn.Get(), SHUT_WR);
+            return res;
+        }},
+        {"unparsable request", [&](RawConnection& conn, std::string& errMsg)
+        {
+            const char garbage[] = "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff";
+            return (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, sizeof(garbage)}, errMsg) &&
+                    conn.Send(garbage, sizeof(garbage), errMsg) &&
+                    gen::ProtoSendData(conn.Get(), gen::PROTO_CODE::METADATA, std::map<std::string, std::string>(),
+                                       RawConnection::TIMEOUT_MS, errMsg));
+        }, false},
+        {"unparsable metadata", [&](RawConnection& conn, std::string& errMsg)
+        {
+            const char garbage[] = "\xff\xff\xff\xff";
+            return (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, 0, gen::PROTO_CODE::METADATA, sizeof(garbage)}, errMsg) &&
+                    conn.Send(garbage, sizeof(garbage), errMsg));
+        }},
+        {"length over the limit", [&](RawConnection& conn, std::string& errMsg)
+        {
+            return (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, 0xF0000000}, errMsg));
+        }},
+        {"64-bit length over the limit", [&](RawConnection& conn, std::string& errMsg)
+        {
+            return (conn.StartCall(echoId, errMsg) && conn.Send({gen::PROTO_CODE::REQ, gen::PROTO_LONG_PAYLOAD}, errMsg) &&
+                    conn.Send(&hugeLength, sizeof(hugeLength), errMsg));
+        }},
+        {"oversized compressed length", [&](RawConnection& conn, std::string& errMsg)
+        {
+            // Negotiated, so that the uncompressed size is what gets it refused
+            uint32_t ack = 0;
+            return (conn.Send({gen::PROTO_CODE::COMPRESSION, static_cast<uint32_t>(gen::Codec::LZ)}, errMsg) &&
+                    gen::ProtoRecvInteger(conn.Get(), ack, RawConnection::TIMEOUT_MS, errMsg) &&
+                    ack == gen::PROTO_CODE::ACK && conn.StartCall(echoId, errMsg) &&
+                    conn.Send({gen::PROTO_CODE::REQ, gen::PROTO_COMPRESSED_PAYLOAD, static_cast<uint32_t>(gen::Codec::LZ)}, errMsg) &&
+                    conn.Send(&hugeLength, sizeof(hugeLength), errMsg) && conn.Send({4, 0}, errMsg));
+        }},
+    };
+
+    CheckServer server(2);
+    server.SetMaxRequestSize(1 << 20);
+    server.EnableCompression(gen::Codec::LZ);
+    return RunWithServer(server, [&cases](std::string& errMsg)
+    {
+        for(const Case& c : cases)
+        {
+            // Note: The server may close the connection before all is sent
+            RawConnection conn;
+            std::string sendErr, error;
+            if(!c.send(conn, sendErr) && !c.closes)
+            {
+                errMsg = std::string(c.name) + ": " + sendErr;
+                return false;
+            }
+            else if(c.closes && !conn.IsClosedByServer())
+            {
+                errMsg = std::string(c.name) + ": the server kept the connection";
+                return false;
+            }
+            else if(!c.closes && !conn.RecvError(error, errMsg))
+            {
+                errMsg = std::string(c.name) + ": " + errMsg;
+                return false;
+            }
+            else if(!c.closes && error.empty())
+            {
+                errMsg = std::string(c.name) + ": the call succeeded";
+                return false;
+            }
+
+            checks::CheckerClient client;
+            checks::EchoRequest req;
+            req.set_data(Pattern(1000, 1));
+            if(!Connect(client, errMsg) || !CheckEcho(client, req, errMsg))
+            {
+                errMsg = std::string("After ") + c.name + ": " + errMsg;
+                return false;
+            }
+        }
+        return true;
+    }, errMsg);
+}
+
+// Checksums: calls go through with them, and a payload corrupted on the way
+// (a byte flipped after its CRC32C was computed) closes the connection
+bool CheckChecksumMismatch(std::string& errMsg)
+{
+    CheckServer server(2);
+    server.SetChecksums(true);
+    return RunWithServer(server, [&server](std::string& errMsg)
+    {
+        checks::CheckerClient client;
+        if(!Connect(client, errMsg) || !client.InitChecksums(errMsg))
+            return false;
+
+        checks::EchoRequest req;
+        for(int i = 0; i < 20; i++)
+        {
+            req.set_id(i);
+            req.set_data(Pattern((i * i * 7919) % 500000, i));
+            if(!CheckEcho(client, req, errMsg))
+                return false;
+        }
+
+        std::string data = req.SerializeAsString();
+        uint32_t crc = gen::Crc32c(data.data(), data.size());
+        data[data.size() / 2] ^= 0x10;
+
+        RawConnection conn;
+        uint32_t ack = 0;
+        if(!conn.Send({gen::PROTO_CODE::CHECKSUM, gen::PROTO_CHECKSUM_CRC32C}, errMsg) ||
+           !gen::ProtoRecvInteger(conn.Get(), ack, RawConnection::TIMEOUT_MS, errMsg) ||
+           !gen::ProtoValidateCode(ack, gen::PROTO_CODE::ACK, errMsg) ||
+           !conn.StartCall(checks::CheckerService<>::EchoId, errMsg) ||
+           !conn.Send({gen::PROTO_CODE::REQ, gen::PROTO_CHECKSUM_PAYLOAD, static_cast<uint32_t>(data.size())}, errMsg) ||
+           !conn.Send(data.data(), data.size(), errMsg) || !conn.Send({crc}, errMsg))
+        {
+            errMsg = "Corrupted request: " + errMsg;
+            return false;
+        }
+        if(!conn.IsClosedByServer())
+        {
+            errMsg = "The server kept the connection of a corrupted request";
+            return false;
+        }
+
+        bool logged = false;
+        for(const std::string& err : server.GetErrors())
+            logged |= (err.find("CRC32C mismatch") != std::string::npos);
+        if(!logged)
+        {
+            errMsg = "The server didn't report the CRC32C mismatch";
+            return false;
+        }
+
+        // The other connections go on
+        return CheckEcho(client, req, errMsg);
+    }, errMsg);
+}
+
+// Response cache: a call with the same request and cacheMetadataKeys values
+// is served without the handler until the TTL expires. Errors and responses
+// over the cache's entry limit aren't cached.
+bool CheckResponseCache(std::string& errMsg)
+{
+    const auto ttl = std::chrono::milliseconds(500);
+    CheckServer server(2);
+    server.SetResponseCacheSize(1024 * 1024);   // Entries up to 64 KB
+    gen::ProtoBindOptions options;
+    options.cache = true;
+    options.cacheTtl = ttl;
+    options.cacheMetadataKeys = {"user"};
+    if(!server.SetMethodOptions(checks::CheckerService<>::EchoId, options))
+    {
+        errMsg = "SetMethodOptions() failed";
+        return false;
+    }
+
+    return RunWithServer(server, [&server, ttl](std::string& errMsg)
+    {
+        // The workers read the options without a lock: they're set before Start() only
+        if(server.SetMethodOptions(checks::CheckerService<>::EchoId, gen::ProtoBindOptions()))
+        {
+            errMsg = "SetMethodOptions() succeeded on the running server";
+            return false;
+        }
+
+        checks::CheckerClient client;
+        if(!Connect(client, errMsg))
+            return false;
+
+        // Call, and check the response and whether the handler ran
+        auto call = [&](const char* step, const checks::EchoRequest& req,
+                        const std::map<std::string, std::string>& metadata, bool cached)
+        {
+            int calls = server.echoCalls;
+            checks::EchoResponse resp;
+            std::string err;
+            if(!client.Echo(req, resp, metadata, err) || err != req.error() ||
+               (err.empty() && (resp.id() != req.id() || resp.data() != req.data())))
+            {
+                errMsg = std::string(step) + ": wrong response (" + err + ")";
+                return false;
+            }
+            if((server.echoCalls == calls) != cached)
+            {
+                errMsg = std::string(step) + (cached ? ": the handler ran" : ": served from the cache");
+                return false;
+            }
+            return true;
+        };
+
+        checks::EchoRequest req, other, failed, large;
+        req.set_id(1);
+        req.set_data(Pattern(1000, 1));
+        other.set_id(2);
+        other.set_data(Pattern(1000, 2));
+        failed.set_id(3);
+        failed.set_error("refused");
+        large.set_id(4);
+        large.set_data(Pattern(100 * 1024, 4));
+        if(!call("first call", req, {{"user", "a"}}, false) ||
+           !call("same call", req, {{"user", "a"}}, true) ||
+           !call("other metadata key", req, {{"user", "a"}, {"trace", "1"}}, true) ||
+           !call("other user", req, {{"user", "b"}}, false) ||
+           !call("other request", other, {{"user", "a"}}, false) ||
+           !call("no user", req, {}, false) ||
+           !call("empty user", req, {{"user", ""}}, false) ||
+           !call("no user again", req, {}, true) ||
+           !call("error", failed, {{"user", "a"}}, false) ||
+           !call("same error", failed, {{"user", "a"}}, false) ||
+           !call("large response", large, {{"user", "a"}}, false) ||
+           !call("same large response", large, {{"user", "a"}}, false))
+            return false;
+
+        std::this_thread::sleep_for(ttl + std::chrono::milliseconds(100));
+        return (call("expired", req, {{"user", "a"}}, false) &&
+                call("cached again", req, {{"user", "a"}}, true));
+    }, errMsg);
+}
+
+// Coalescing: identical calls in flight run the handler once, and all get its
+// response or error. Callers that wait longer than coalesceTimeout run it
+// themselves.
+bool CheckCoalescing(std::string& errMsg)
+{
+    const int count = 6;
+    for(auto timeout : {std::chrono::milliseconds(5000), std::chrono::milliseconds(50)})
+    {
+        CheckServer server(count + 2);
+        gen::ProtoBindOptions options;
+        options.coalesce = true;
+        options.coalesceTimeout = timeout;
+        if(!server.SetMethodOptions(checks::CheckerService<>::EchoId, options))
+        {
+            errMsg = "SetMethodOptions() failed";
+            return false;
+        }
+
+        bool shared = (timeout.count() > 300);
+        bool res = RunWithServer(server, [&server, count, shared](std::string& errMsg)
+        {
+            // The clients connect first, then call together
+            checks::CheckerClient clients[count];
+            for(checks::CheckerClient& client : clients)
+            {
+                if(!Connect(client, errMsg))
+                    return false;
+            }
+
+            for(const char* error : {"", "boom"})
+            {
+                checks::EchoRequest req;
+                req.set_id(7);
+                req.set_data(Pattern(5000, 7));
+                req.set_delay_ms(300);
+                req.set_error(error);
+
+                int calls = server.echoCalls;
+                std::vector<std::thread> threads;
+                std::vector<std::string> errors(count);
+                for(int i = 0; i < count; i++)
+                {
+                    threads.emplace_back([&, i]()
+                    {
+                        checks::EchoResponse resp;
+                        std::string err;
+                        if(!clients[i].Echo(req, resp, err))
+                            errors[i] = "Echo failed: " + err;
+                        else if(err != req.error() || (err.empty() && resp.data() != req.data()))
+                            errors[i] = "wrong response (" + err + ")";
+                    });
+                }
+                for(std::thread& thread : threads)
+                    thread.join();
+
+                for(const std::string& err : errors)
+                {
+                    if(!err.empty())
+                    {
+                        errMsg = std::string(*error ? "Error" : "Response") + ": " + err;
+                        return false;
+                    }
+                }
+                int handlerCalls = server.echoCalls - calls;
+                if(handlerCalls != (shared ? 1 : count))
+                {
+                    errMsg = std::string(*error ? "Error" : "Response") + ": " + std::to_string(count) +
+                             " calls ran the handler " + std::to_string(handlerCalls) + " times";
+                    return false;
+                }
+            }
+            return true;
+        }, errMsg);
+        if(!res)
+        {
+            errMsg = "coalesceTimeout of " + std::to_string(timeout.count()) + " ms: " + errMsg;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Publish-subscribe backpressure: a subscriber that stops reading is evicted
+// once its queue is over the limit, while a subscriber keeping up gets every
+// message in order
+bool CheckSlowSubscriber(std::string& errMsg)
+{
+    const char* topic = "prices";
+    const int count = 1000;     // 4 MB, well over the socket buffers and the queue limit
+    CheckServer server(2);
+    server.SetSubscriberQueueLimit(256 * 1024);
+    return RunWithServer(server, [&server, topic, count](std::string& errMsg)
+    {
+        checks::CheckerClient fastClient, slowClient;
+        if(!Connect(fastClient, errMsg) || !Connect(slowClient, errMsg))
+            return false;
+
+        std::atomic<bool> published{false};
+        int fastReceived = 0;
+        std::string fastErr;
+        std::thread fast([&]()
+        {
+            checks::EchoRequest msg;
+            if(!fastClient.Subscribe(topic, msg, [&]()
+            {
+                if(msg.id() != fastReceived)
+                    fastErr = "message " + std::to_string(msg.id()) + " instead of " + std::to_string(fastReceived);
+                return (fastErr.empty() && ++fastReceived < count);
+            }, fastErr, 5000) && fastErr.empty())
+                fastErr = "the subscription ended";
+        });
+
+        // Blocked in the first message until all are published
+        int slowReceived = 0;
+        bool slowRes = true;
+        std::string slowErr;
+        std::thread slow([&]()
+        {
+            checks::EchoRequest msg;
+            slowRes = slowClient.Subscribe(topic, msg, [&]()
+            {
+                while(!published)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                slowReceived++;
+                return true;
+            }, slowErr, 5000);
+        });
+
+        for(int i = 0; i < 300 && server.GetSubscriberCount(topic) < 2; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        size_t subscribers = server.GetSubscriberCount(topic);
+
+        size_t lastQueued = 0;
+        checks::EchoRequest msg;
+        msg.set_data(Pattern(4 * 1024, 0));
+        for(int i = 0; i < count && subscribers == 2; i++)
+        {
+            msg.set_id(i);
+            lastQueued = server.Publish(topic, msg);
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        published = true;
+        fast.join();
+        slow.join();
+
+        if(subscribers != 2)
+            errMsg = std::to_string(subscribers) + " subscribers instead of 2";
+        else if(!fastErr.empty() || fastReceived != count)
+            errMsg = "Fast subscriber: " + std::to_string(fastReceived) + " messages received (" + fastErr + ")";
+        else if(slowRes || slowReceived >= count)
+            errMsg = "Slow subscriber: not evicted, " + std::to_string(slowReceived) + " messages received";
+        else if(lastQueued != 1)
+            errMsg = "The last message was queued to " + std::to_string(lastQueued) + " subscribers";
+        else
+            return true;
+        return false;
+    }, errMsg);
+}
+
+// Run child in a forked process. Returns its errMsg (empty on success), or why
+// it didn't finish within timeoutMs.
+std::string RunForked(const std::function<bool(std::string&)>& child, long timeoutMs)
+{
+    int fds[2];
+    if(pipe(fds) == -1)
+        return "pipe() failed: " + std::string(strerror(errno));
+
+    pid_t pid = fork();
+    if(pid == -1)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return "fork() failed: " + std::string(strerror(errno));
+    }
+    else if(pid == 0)
+    {
+        // Note: _exit(), the parent's objects are not destroyed in the child
+        close(fds[0]);
+        std::string errMsg;
+        if(!child(errMsg) && errMsg.empty())
+            errMsg = "failed";
+        bool sent = (write(fds[1], errMsg.data(), errMsg.size()) == static_cast<ssize_t>(errMsg.size()));
+        _exit(sent ? 0 : 1);
+    }
+
+    close(fds[1]);
+    std::string errMsg;
+    bool finished = false;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while(!finished && std::chrono::steady_clock::now() < deadline)
+    {
+        pollfd pfd = {fds[0], POLLIN, 0};
+        if(poll(&pfd, 1, 100) <= 0)
+            continue;
+        char buf[256];
+        ssize_t res = read(fds[0], buf, sizeof(buf));
+        if(res > 0)
+            errMsg.append(buf, res);
+        finished = (res == 0);
+    }
+    close(fds[0]);
+
+    int status = 0;
+    if(!finished)
+    {
+        kill(pid, SIGKILL);
+        errMsg = "The child process didn't finish in " + std::to_string(timeoutMs) + " ms";
+    }
+    waitpid(pid, &status, 0);
+    if(finished && errMsg.empty() && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+        errMsg = "The child process failed";
+    return errMsg;
+}
+
+// Fork while a server, a client and a thread pool are live, and calls are
+// running: in the child, the pool restarts its threads on first use and the
+// client reconnects instead of sharing the parent's connection
+bool CheckFork(std::string& errMsg)
+{
+    CheckServer server(4);
+    return RunWithServer(server, [](std::string& errMsg)
+    {
+        checks::CheckerClient client, busyClient;
+        ThreadPool pool;
+        pool.Start(2);
+        std::atomic<int> tasks{0};
+        pool.Post([&tasks]() { tasks++; });
+        pool.Wait();
+
+        checks::EchoRequest req;
+        req.set_data(Pattern(1000, 1));
+        if(!Connect(client, errMsg) || !Connect(busyClient, errMsg) || !CheckEcho(client, req, errMsg))
+            return false;
+
+        // Calls in flight on another thread while forking
+        std::atomic<bool> busy{true};
+        std::string busyErr;
+        std::thread caller([&]()
+        {
+            checks::EchoRequest req;
+            for(int i = 0; busy && busyErr.empty(); i++)
+            {
+                req.set_id(i);
+                req.set_data(Pattern(i * 997 % 100000, i));
+                CheckEcho(busyClient, req, busyErr);
+            }
+        });
+
+        std::string childErr;
+        for(int i = 0; i < 3 && childErr.empty(); i++)
+        {
+            childErr = RunForked([&](std::string& errMsg)
+            {
+                for(int j = 0; j < 10; j++)
+                    pool.Post([&tasks]() { tasks++; });
+                pool.Wait();
+                if(tasks != 11)
+                {
+                    errMsg = "The pool ran " + std::to_string(tasks - 1) + " tasks of 10";
+                    return false;
+                }
+
+                checks::EchoRequest req;
+                for(int j = 0; j < 20; j++)
+                {
+                    req.set_id(j);
+                    req.set_data(Pattern(j * 7919 % 200000, j));
+                    if(!CheckEcho(client, req, errMsg) || !CheckEcho(busyClient, req, errMsg))
+                        return false;
+                }
+                return true;
+            }, 10000);
+        }
+        busy = false;
+        caller.join();
+
+        if(!childErr.empty())
+            errMsg = "Child: " + childErr;
+        else if(!busyErr.empty())
+            errMsg = "Calls while forking: " + busyErr;
+        else if(!CheckEcho(client, req, errMsg))
+            errMsg = "After the children exited: " + errMsg;
+        else
+            return true;
+        return false;
+    }, errMsg);
+}
+
+// Zero-downtime restart: a second server takes the listening socket over while
+// clients keep calling. No call may fail: the first server serves its
+// connections until they close, then stops; new connections go to the second.
+bool CheckListenerHandoff(std::string& errMsg)
+{
+    const char* handoffSocket = "protorpc_checks_handoff.sock";
+    CheckServer first(2), second(2);
+    first.SetHandoffSocket(handoffSocket, true);
+    second.SetHandoffSocket(handoffSocket, true);
+    return RunWithServer(first, [&first, &second](std::string& errMsg)
+    {
+        // One caller keeps its connection, the others connect for every call
+        std::atomic<bool> calling{true};
+        std::vector<std::string> errors(3);
+        std::vector<int> calls(errors.size());
+        std::vector<std::thread> callers;
+        for(size_t i = 0; i < errors.size(); i++)
+        {
+            callers.emplace_back([&, i]()
+            {
+                checks::CheckerClient kept;
+                if(i == 0 && !Connect(kept, errors[i]))
+                    return;
+
+                checks::EchoRequest req;
+                for(int j = 0; calling && errors[i].empty(); j++)
+                {
+                    checks::CheckerClient reconnected;
+                    checks::CheckerClient& client = (i == 0 ? kept : reconnected);
+                    if(i > 0 && !Connect(client, errors[i]))
+                        break;
+                    req.set_id(j);
+                    req.set_data(Pattern(j * 997 % 50000, j));
+                    CheckEcho(client, req, errors[i]);
+                    calls[i]++;
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        bool started = true;
+        std::thread secondThread([&second, &started]() { started = second.Start(CHECK_SOCKET, true); });
+        for(int i = 0; i < 300 && second.echoCalls == 0; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        int firstCalls = first.echoCalls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        bool drained = (first.echoCalls > firstCalls);
+        calling = false;
+        for(std::thread& caller : callers)
+            caller.join();
+
+        // Once its connections are closed, the first server stops by itself
+        for(int i = 0; i < 300 && first.IsRunning(); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        bool firstStopped = !first.IsRunning();
+
+        checks::CheckerClient client;
+        checks::EchoRequest req;
+        req.set_data(Pattern(1000, 1));
+        bool served = (Connect(client, errMsg) && CheckEcho(client, req, errMsg));
+        second.Stop();
+        secondThread.join();
+
+        for(size_t i = 0; i < errors.size() && errMsg.empty(); i++)
+        {
+            if(!errors[i].empty())
+                errMsg = "Caller " + std::to_string(i) + ", call " + std::to_string(calls[i]) + ": " + errors[i];
+        }
+        if(!served || !errMsg.empty())
+            errMsg = (served ? errMsg : "After the handoff: " + errMsg);
+        else if(!started || second.echoCalls == 0)
+            errMsg = "The second server didn't take over";
+        else if(!drained)
+            errMsg = "The first server stopped serving its connection";
+        else if(!firstStopped)
+            errMsg = "The first server kept running";
+        else
+            return true;
+
+        for(const std::string& err : second.GetErrors())
+            errMsg += "\n    second server: " + err;
+        return false;
+    }, errMsg);
+}
+
+struct Check
+{
+    const char* name;
+    bool (*run)(std::string& errMsg);
+};
+
+const Check CHECKS[] =
+{
+    {"shm-wraparound", CheckShmWraparound},
+    {"event-backends", CheckEventBackends},
+    {"stream-window", CheckStreamWindow},
+    {"malformed-frames", CheckMalformedFrames},
+    {"checksum-mismatch", CheckChecksumMismatch},
+    {"response-cache", CheckResponseCache},
+    {"coalescing", CheckCoalescing},
+    {"slow-subscriber", CheckSlowSubscriber},
+    {"fork", CheckFork},
+    {"listener-handoff", CheckListenerHandoff},
+};
+
+int main(int argc, char* argv[])
+{
+    // The checks that close connections on purpose must not kill the process
+    signal(SIGPIPE, SIG_IGN);
+
+    int failed = 0;
+    int run = 0;
+    for(const Check& check : CHECKS)
+    {
+        bool selected = (argc < 2);
+        for(int i = 1; i < argc; i++)
+            selected |= (strcmp(argv[i], check.name) == 0);
+        if(!selected)
+            continue;
+
+        std::string errMsg;
+        auto start = std::chrono::steady_clock::now();
+        bool res = check.run(errMsg);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+        std::cout << (res ? "PASS " : "FAIL ") << check.name << " (" << ms.count() << " ms)"
+                  << (res ? "" : ": " + errMsg) << std::endl;
+        failed += !res;
+        run++;
+    }
+
+    std::cout << run - failed << "/" << run << " checks passed" << std::endl;
+    return (failed == 0 && run > 0 ? 0 : 1);
+}
@@ -6,8 +6,7 @@
 #include <vector>
 #include <signal.h>
 #include <dirent.h>     // readdir
-#include "protoClient.hpp"
-#include "hello.pb.h"
+#include "hello.protorpc.h"
 
 const int PORT = 8080;
 const char* domainSocket = "\0protoserver_domain_socket.sock";
@@ -53,15 +52,15 @@ void RunTest(int numThreads, int numOfCallsPerThread)
 
             req.set_from("From test application: " + std::to_string(i));
 
-//            gen::ProtoClient protoClient("127.0.0.1", PORT);
-            gen::ProtoClient protoClient(domainSocket);
+//            test::GreeterClient protoClient("127.0.0.1", PORT);
+            test::GreeterClient protoClient(domainSocket);
 
             for(int j = 0; j < numOfCallsPerThread; j++)
             {
 //                gen::ProtoClient protoClient("127.0.0.1", PORT);
 //                gen::ProtoClient protoClient(domainSocket);
 
-                if(!protoClient.Call(req, resp, metadata, errMsg, timeout))
+                if(!protoClient.Ping(req, resp, metadata, errMsg, timeout))
                 {
                     std::cout << "Call() returned ERROR: " << errMsg << std::endl;
                 }
@@ -0,0 +1,144 @@
+//
+// compressionBench.cpp
+//
+// Measures the compression codecs on response messages of growing size, and
+// where compressing starts to pay off on a link of the given bandwidth:
+// compress + send the compressed bytes + decompress, against sending the raw bytes.
+//
+// Usage: compressionBench [link Mbit/s ...]  (default: 100 1000 10000)
+//
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include "hello.pb.h"
+#include "compression.hpp"
+
+// Response text: log-like records, repetitive as real payloads are, with varying values
+std::string MakeText(size_t size, std::mt19937& rnd)
+{
+    static const char* levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    static const char* paths[] = {"/api/v1/orders", "/api/v1/users", "/api/v2/inventory", "/health"};
+    std::string text;
+    while(text.size() < size)
+    {
+        text += "2024-05-" + std::to_string(10 + rnd() % 20) + "T12:" + std::to_string(10 + rnd() % 50) +
+                ":" + std::to_string(10 + rnd() % 50) + "." + std::to_string(rnd() % 1000) + "Z " +
+                levels[rnd() % 4] + " request path=" + paths[rnd() % 4] + " status=" +
+                std::to_string(200 + rnd() % 5) + " latency_us=" + std::to_string(rnd() % 100000) +
+                " user=" + std::to_string(rnd() % 10000) + "\n";
+    }
+    text.resize(size);
+    return text;
+}
+
+std::string MakeRandom(size_t size, std::mt19937& rnd)
+{
+    std::string data(size, '\0');
+    for(char& c : data)
+        c = static_cast<char>(rnd());
+    return data;
+}
+
+// Average ns per call of func, run for at least 100 ms
+template<class FUNC>
+double Measure(FUNC func)
+{
+    using namespace std::chrono;
+    long count = 0;
+    auto start = steady_clock::now();
+    auto elapsed = steady_clock::duration::zero();
+    do
+    {
+        func();
+        count++;
+        elapsed = steady_clock::now() - start;
+    } while(elapsed < milliseconds(100));
+    return static_cast<double>(duration_cast<nanoseconds>(elapsed).count()) / count;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<double> links;
+    for(int i = 1; i < argc; i++)
+        links.push_back(atof(argv[i]));
+    if(links.empty())
+        links = {100, 1000, 10000};
+
+    std::mt19937 rnd(42);
+    const gen::Codec codecs[] = {gen::Codec::LZ, gen::Codec::GZIP};
+    std::map<std::pair<int, double>, size_t> crossover;  // (codec, link) -> smallest size that pays off
+
+    for(bool random : {false, true})
+    {
+        std::cout << "\n" << (random ? "Random (incompressible)" : "Log text") << " responses\n"
+                  << std::setw(9) << "size" << std::setw(7) << "codec" << std::setw(8) << "ratio"
+                  << std::setw(12) << "comp us" << std::setw(12) << "decomp us";
+        for(double link : links)
+            std::cout << std::setw(10) << link << "M";
+        std::cout << "  (time vs raw)\n";
+
+        for(size_t size = 64; size <= 4 * 1024 * 1024; size *= 4)
+        {
+            // Note: Random data stands for data compressed already (images, archives)
+            test::PingResponse resp;
+            std::string raw;
+            if(random)
+            {
+                raw = MakeRandom(size, rnd);
+            }
+            else
+            {
+                resp.set_msg(MakeText(size, rnd));
+                raw = resp.SerializeAsString();
+            }
+
+            for(gen::Codec codec : codecs)
+            {
+                std::string compressed, errMsg;
+                std::string out;
+                double compNs = Measure([&]{ gen::Compress(codec, raw.data(), raw.size(), compressed, errMsg); });
+                double decompNs = Measure([&]{ gen::Decompress(codec, compressed.data(), compressed.size(),
+                                                               out, raw.size(), errMsg); });
+                if(out != raw)
+                {
+                    std::cerr << "ERROR: " << gen::CodecToStr(codec) << " round trip failed " << errMsg << std::endl;
+                    return 1;
+                }
+
+                std::cout << std::setw(9) << raw.size() << std::setw(7) << gen::CodecToStr(codec)
+                          << std::setw(8) << std::fixed << std::setprecision(2)
+                          << static_cast<double>(raw.size()) / compressed.size()
+                          << std::setw(12) << compNs / 1000 << std::setw(12) << decompNs / 1000;
+
+                for(double link : links)
+                {
+                    // Transfer time in ns at link Mbit/s
+                    double bytesPerNs = link * 1e6 / 8 / 1e9;
+                    double rawNs = raw.size() / bytesPerNs;
+                    double compressedNs = compNs + decompNs + compressed.size() / bytesPerNs;
+                    std::cout << std::setw(10) << std::setprecision(2) << compressedNs / rawNs << "x";
+
+                    auto key = std::make_pair(static_cast<int>(codec), link);
+                    if(!random && compressedNs < rawNs && crossover.find(key) == crossover.end())
+                        crossover[key] = raw.size();
+                }
+                std::cout << "\n";
+            }
+        }
+    }
+
+    std::cout << "\nCrossover (log text: the smallest size where compressing is faster than sending raw)\n";
+    for(gen::Codec codec : codecs)
+    {
+        for(double link : links)
+        {
+            auto itr = crossover.find(std::make_pair(static_cast<int>(codec), link));
+            std::cout << std::setw(7) << gen::CodecToStr(codec) << " at " << std::setw(6) << link << " Mbit/s: "
+                      << (itr != crossover.end() ? std::to_string(itr->second) + " bytes" : std::string("never")) << "\n";
+        }
+    }
+    return 0;
+}
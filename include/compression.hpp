@@ -0,0 +1,349 @@
+//
+// compression.hpp
+//
+#ifndef __COMPRESSION_HPP__
+#define __COMPRESSION_HPP__
+
+#include <google/protobuf/io/gzip_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+#include <string>
+#include <cstring>  // std::memcpy
+#include <climits>  // INT_MAX
+
+namespace gen {
+
+// Message compression codecs (see ProtoClient::InitCompression())
+enum class Codec : uint32_t
+{
+    NONE = 0,
+    GZIP,           // zlib (deflate) from protobuf's GzipOutputStream: the best ratio
+    LZ              // Byte-oriented LZ77 (LZ4-like block format): several times faster, a lower ratio
+};
+
+inline const char* CodecToStr(Codec codec)
+{
+    return (codec == Codec::NONE ? "NONE" :
+            codec == Codec::GZIP ? "GZIP" :
+            codec == Codec::LZ   ? "LZ" : "UNKNOWN");
+}
+
+constexpr uint32_t CodecMask(Codec codec)
+{
+    return (static_cast<uint32_t>(codec) < 32 ? 1u << static_cast<uint32_t>(codec) : 0);
+}
+
+// All the codecs known
+const uint32_t ALL_CODECS = CodecMask(Codec::GZIP) | CodecMask(Codec::LZ);
+
+// The largest size size bytes of data compressed with codec can decompress to:
+// a match of LZ grows by 255 bytes per byte of its length, deflate by 1032 at most
+inline size_t MaxDecompressedSize(Codec codec, size_t size)
+{
+    return (codec == Codec::LZ ? size * 255 + 32 :
+            codec == Codec::GZIP ? size * 1032 + 64 : 0);
+}
+
+// Decompressed data is written to a buffer of a few times the compressed size
+// first, and grows with the data: a wrong uncompressed length allocates nothing
+const size_t DECOMPRESS_INITIAL_RATIO = 4;
+
+// Messages smaller than this are sent uncompressed (see compressionBench)
+const size_t DEFAULT_COMPRESSION_THRESHOLD = 4 * 1024;
+
+//
+// LZ codec: sequences of a token (literals count, match length - 4), the
+// literals, and the 16-bit offset of the match in the data decoded so far.
+// The last sequence has literals only.
+//
+namespace lz {
+
+const int HASH_BITS = 14;
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const size_t LAST_LITERALS = 5;     // The data always ends with literals
+const size_t MATCH_LIMIT = 12;      // No match starts in the last bytes
+
+inline uint32_t Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline uint64_t Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, sizeof(v)); return v; }
+
+inline uint8_t* WriteLength(uint8_t* op, size_t len)
+{
+    for(; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+inline uint8_t* WriteSequence(uint8_t* op, const uint8_t* literals, size_t literalsCount, size_t offset, size_t matchLen)
+{
+    size_t matchCode = (matchLen ? matchLen - MIN_MATCH : 0);
+    *op++ = static_cast<uint8_t>((std::min<size_t>(literalsCount, 15) << 4) | std::min<size_t>(matchCode, 15));
+    if(literalsCount >= 15)
+        op = WriteLength(op, literalsCount - 15);
+    memcpy(op, literals, literalsCount);
+    op += literalsCount;
+
+    if(matchLen)
+    {
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        if(matchCode >= 15)
+            op = WriteLength(op, matchCode - 15);
+    }
+    return op;
+}
+
+} // namespace lz
+
+inline size_t LzCompressBound(size_t size) { return size + size / 255 + 16; }
+
+inline void LzCompress(const char* data, size_t size, std::string& out)
+{
+    thread_local uint32_t table[1 << lz::HASH_BITS];
+    memset(table, 0, sizeof(table));
+
+    out.resize(LzCompressBound(size));
+    const uint8_t* in = reinterpret_cast<const uint8_t*>(data);
+    uint8_t* op = reinterpret_cast<uint8_t*>(out.data());
+    size_t anchor = 0, pos = 0;
+
+    if(size > lz::MATCH_LIMIT)
+    {
+        size_t limit = size - lz::MATCH_LIMIT;
+        while(pos < limit)
+        {
+            uint32_t seq = lz::Read32(in + pos);
+            uint32_t hash = (seq * 2654435761u) >> (32 - lz::HASH_BITS);
+            size_t ref = table[hash];
+            table[hash] = static_cast<uint32_t>(pos);
+
+            if(ref >= pos || pos - ref > lz::MAX_OFFSET || lz::Read32(in + ref) != seq)
+            {
+                // Skip faster through data that doesn't compress
+                pos += 1 + ((pos - anchor) >> 6);
+                continue;
+            }
+
+            // Extend the match, 8 bytes at a time
+            size_t len = lz::MIN_MATCH;
+            size_t maxLen = size - lz::LAST_LITERALS - pos;
+            while(len + 8 <= maxLen)
+            {
+                uint64_t diff = lz::Read64(in + ref + len) ^ lz::Read64(in + pos + len);
+                if(diff)
+                {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+                    len += __builtin_ctzll(diff) >> 3;
+#else
+                    len += __builtin_clzll(diff) >> 3;
+#endif
+                    maxLen = len;
+                    break;
+                }
+                len += 8;
+            }
+            while(len < maxLen && in[ref + len] == in[pos + len])
+                len++;
+
+            op = lz::WriteSequence(op, in + anchor, pos - anchor, pos - ref, len);
+            pos += len;
+            anchor = pos;
+        }
+    }
+
+    op = lz::WriteSequence(op, in + anchor, size - anchor, 0, 0);
+    out.resize(op - reinterpret_cast<uint8_t*>(out.data()));
+}
+
+// Decompress exactly rawSize bytes to out. Corrupted data is detected, never read or written out of bounds.
+inline bool LzDecompress(const char* data, size_t size, std::string& out, size_t rawSize, std::string& errMsg)
+{
+    const uint8_t* ip = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* ipEnd = ip + size;
+    size_t pos = 0;     // Bytes decoded
+
+    // Make room for len more bytes, up to rawSize
+    out.resize(std::min(rawSize, size * DECOMPRESS_INITIAL_RATIO));
+    auto Reserve = [&](size_t len) -> bool
+    {
+        if(len > rawSize - pos)
+            return false;
+        if(len > out.size() - pos)
+            out.resize(std::min(rawSize, std::max(out.size() * 2, pos + len)));
+        return true;
+    };
+
+    auto ReadLength = [&](size_t& len) -> bool
+    {
+        uint8_t b = 255;
+        while(b == 255)
+        {
+            if(ip == ipEnd)
+                return false;
+            b = *ip++;
+            len += b;
+        }
+        return true;
+    };
+
+    while(ip < ipEnd)
+    {
+        uint8_t token = *ip++;
+        size_t literalsCount = token >> 4;
+        if(literalsCount == 15 && !ReadLength(literalsCount))
+            break;
+        if(literalsCount > static_cast<size_t>(ipEnd - ip) || !Reserve(literalsCount))
+            break;
+
+        // Short literals: copy 16 bytes at once when both buffers have room for it
+        uint8_t* op = reinterpret_cast<uint8_t*>(out.data()) + pos;
+        if(literalsCount <= 16 && ipEnd - ip >= 16 && out.size() - pos >= 16)
+            memcpy(op, ip, 16);
+        else
+            memcpy(op, ip, literalsCount);
+        ip += literalsCount;
+        pos += literalsCount;
+
+        // The last sequence has no match
+        if(ip == ipEnd)
+        {
+            if(pos == rawSize)
+                return true;
+            break;
+        }
+
+        if(ipEnd - ip < 2)
+            break;
+        size_t offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        size_t len = token & 15;
+        if(len == 15 && !ReadLength(len))
+            break;
+        len += lz::MIN_MATCH;
+        if(offset == 0 || offset > pos || !Reserve(len))
+            break;
+
+        // Note: The match may overlap the bytes it produces: copy 8 bytes at
+        // a time when it's at least 8 bytes back (and the output has room)
+        op = reinterpret_cast<uint8_t*>(out.data()) + pos;
+        const uint8_t* match = op - offset;
+        uint8_t* matchEnd = op + len;
+        if(offset >= 8 && out.size() - (pos + len) >= 8)
+        {
+            for(; op < matchEnd; op += 8, match += 8)
+                memcpy(op, match, 8);
+        }
+        else
+        {
+            while(op < matchEnd)
+                *op++ = *match++;
+        }
+        pos += len;
+    }
+
+    out.clear();
+    errMsg = "Corrupted LZ data";
+    return false;
+}
+
+// Fast deflate: most of the ratio of the default level 6, at several times its speed
+const int GZIP_COMPRESSION_LEVEL = 1;
+
+inline bool GzipCompress(const char* data, size_t size, std::string& out, std::string& errMsg)
+{
+    using namespace google::protobuf::io;
+
+    out.clear();
+    StringOutputStream output(&out);
+    GzipOutputStream::Options options;
+    options.format = GzipOutputStream::ZLIB;
+    options.compression_level = GZIP_COMPRESSION_LEVEL;
+    GzipOutputStream gzip(&output, options);
+
+    for(size_t done = 0; done < size; )
+    {
+        void* buf = nullptr;
+        int len = 0;
+        if(!gzip.Next(&buf, &len))
+            break;
+        size_t n = std::min(static_cast<size_t>(len), size - done);
+        memcpy(buf, data + done, n);
+        done += n;
+        if(n < static_cast<size_t>(len))
+            gzip.BackUp(len - n);
+    }
+
+    if(!gzip.Close())
+    {
+        errMsg = std::string("zlib compression failed: ") + (gzip.ZlibErrorMessage() ? gzip.ZlibErrorMessage() : "unknown error");
+        return false;
+    }
+    return true;
+}
+
+inline bool GzipDecompress(const char* data, size_t size, std::string& out, size_t rawSize, std::string& errMsg)
+{
+    using namespace google::protobuf::io;
+
+    if(size > INT_MAX)
+    {
+        errMsg = "Compressed data of " + std::to_string(size) + " bytes is too large";
+        return false;
+    }
+
+    ArrayInputStream input(data, static_cast<int>(size));
+    GzipInputStream gzip(&input, GzipInputStream::ZLIB);
+    const void* buf = nullptr;
+    int len = 0;
+    out.clear();
+    out.reserve(std::min(rawSize, size * DECOMPRESS_INITIAL_RATIO));
+    while(gzip.Next(&buf, &len))
+    {
+        if(static_cast<size_t>(len) > rawSize - out.size())
+        {
+            out.clear();
+            errMsg = "Decompressed data exceeds its size of " + std::to_string(rawSize) + " bytes";
+            return false;
+        }
+        out.append(static_cast<const char*>(buf), len);
+    }
+
+    if(gzip.ZlibErrorCode() < 0 || out.size() != rawSize)
+    {
+        out.clear();
+        errMsg = std::string("zlib decompression failed: ") +
+                 (gzip.ZlibErrorMessage() ? gzip.ZlibErrorMessage() : "truncated data");
+        return false;
+    }
+    return true;
+}
+
+inline bool Compress(Codec codec, const char* data, size_t size, std::string& out, std::string& errMsg)
+{
+    if(codec == Codec::GZIP)
+        return gen::GzipCompress(data, size, out, errMsg);
+    if(codec == Codec::LZ)
+    {
+        gen::LzCompress(data, size, out);
+        return true;
+    }
+
+    errMsg = "Unknown compression codec " + std::to_string(static_cast<uint32_t>(codec));
+    return false;
+}
+
+// Decompress exactly rawSize bytes to out (grown as the data is decompressed)
+inline bool Decompress(Codec codec, const char* data, size_t size, std::string& out, size_t rawSize, std::string& errMsg)
+{
+    if(codec == Codec::GZIP)
+        return gen::GzipDecompress(data, size, out, rawSize, errMsg);
+    if(codec == Codec::LZ)
+        return gen::LzDecompress(data, size, out, rawSize, errMsg);
+
+    errMsg = "Unknown compression codec " + std::to_string(static_cast<uint32_t>(codec));
+    return false;
+}
+
+} // namespace gen
+
+#endif // __COMPRESSION_HPP__
@@ -0,0 +1,241 @@
+//
+// crc32c.hpp
+//
+#ifndef __CRC32C_HPP__
+#define __CRC32C_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>  // std::memcpy
+#include <utility>  // std::swap
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>  // _mm_crc32_u64()
+#define CRC32C_HW 1
+#define CRC32C_HW_TARGET __attribute__((target("sse4.2")))
+#elif defined(__aarch64__)
+#include <arm_acle.h>   // __crc32cd()
+#include <sys/auxv.h>   // getauxval()
+#include <asm/hwcap.h>  // HWCAP_CRC32
+#define CRC32C_HW 1
+#define CRC32C_HW_TARGET __attribute__((target("+crc")))
+#endif
+
+namespace gen {
+
+//
+// CRC32C (Castagnoli), as in iSCSI and ext4. Computed with the SSE4.2 crc32
+// instruction on x86_64 and the ARMv8 CRC32 instructions on aarch64 when the
+// CPU has them, with tables (slicing-by-8) otherwise.
+//
+// The crc32 instruction takes 3 cycles but one can start every cycle, so long
+// data is split into 3 blocks computed in parallel. The block CRCs are then
+// combined: crc(A + B) = crc(A) shifted over the length of B, xor crc(B).
+//
+namespace crc32c {
+
+const uint32_t POLY = 0x82F63B78;   // Reflected
+
+const size_t LONG_BLOCK = 8192;     // Bytes per lane: 3 lanes of 24 KB,
+const size_t SHORT_BLOCK = 256;     // then of 768 bytes
+
+// Multiply the GF(2) 32x32 matrix mat by vec
+inline uint32_t MatrixTimes(const uint32_t* mat, uint32_t vec)
+{
+    uint32_t sum = 0;
+    for(; vec; vec >>= 1, mat++)
+    {
+        if(vec & 1)
+            sum ^= *mat;
+    }
+    return sum;
+}
+
+inline void MatrixSquare(uint32_t* square, const uint32_t* mat)
+{
+    for(int n = 0; n < 32; n++)
+        square[n] = MatrixTimes(mat, mat[n]);
+}
+
+struct Tables
+{
+    uint32_t bytes[8][256];     // Slicing-by-8
+    uint32_t longShift[4][256]; // Shift a CRC over LONG_BLOCK zeros
+    uint32_t shortShift[4][256];
+
+    Tables()
+    {
+        for(uint32_t n = 0; n < 256; n++)
+        {
+            uint32_t crc = n;
+            for(int k = 0; k < 8; k++)
+                crc = (crc & 1 ? (crc >> 1) ^ POLY : crc >> 1);
+            bytes[0][n] = crc;
+        }
+        for(uint32_t n = 0; n < 256; n++)
+        {
+            for(int k = 1; k < 8; k++)
+                bytes[k][n] = (bytes[k - 1][n] >> 8) ^ bytes[0][bytes[k - 1][n] & 0xFF];
+        }
+
+        MakeShift(longShift, LONG_BLOCK);
+        MakeShift(shortShift, SHORT_BLOCK);
+    }
+
+    // The operator that feeds len zero bytes to a CRC, as byte tables
+    void MakeShift(uint32_t shift[4][256], size_t len)
+    {
+        // One zero bit, then squared to 2, 4, ... bits
+        uint32_t odd[32], even[32];
+        odd[0] = POLY;
+        for(int n = 1; n < 32; n++)
+            odd[n] = 1u << (n - 1);
+        MatrixSquare(even, odd);    // 2 bits
+        MatrixSquare(odd, even);    // 4 bits
+
+        // Multiply the operators of the set bits of len (from 8 bits = 1 byte on)
+        uint32_t op[32];
+        bool first = true;
+        uint32_t* sq = odd;
+        uint32_t* next = even;
+        for(; len; len >>= 1)
+        {
+            MatrixSquare(next, sq);
+            std::swap(sq, next);
+            if(len & 1)
+            {
+                if(first)
+                {
+                    memcpy(op, sq, sizeof(op));
+                    first = false;
+                }
+                else
+                {
+                    uint32_t product[32];
+                    for(int n = 0; n < 32; n++)
+                        product[n] = MatrixTimes(sq, op[n]);
+                    memcpy(op, product, sizeof(op));
+                }
+            }
+        }
+
+        for(uint32_t n = 0; n < 256; n++)
+        {
+            for(int k = 0; k < 4; k++)
+                shift[k][n] = MatrixTimes(op, n << (k * 8));
+        }
+    }
+};
+
+inline const Tables& GetTables()
+{
+    static const Tables tables;
+    return tables;
+}
+
+inline uint32_t Shift(const uint32_t shift[4][256], uint32_t crc)
+{
+    return (shift[0][crc & 0xFF] ^ shift[1][(crc >> 8) & 0xFF] ^
+            shift[2][(crc >> 16) & 0xFF] ^ shift[3][crc >> 24]);
+}
+
+inline uint32_t Software(uint32_t crc, const uint8_t* p, size_t len)
+{
+    const auto& t = GetTables().bytes;
+    for(; len && (reinterpret_cast<uintptr_t>(p) & 7); len--)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+    for(; len >= 8; len -= 8, p += 8)
+    {
+        uint64_t word = 0;
+        memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        word = __builtin_bswap64(word);
+#endif
+        word ^= crc;
+        crc = t[7][word & 0xFF] ^ t[6][(word >> 8) & 0xFF] ^ t[5][(word >> 16) & 0xFF] ^
+              t[4][(word >> 24) & 0xFF] ^ t[3][(word >> 32) & 0xFF] ^ t[2][(word >> 40) & 0xFF] ^
+              t[1][(word >> 48) & 0xFF] ^ t[0][word >> 56];
+    }
+
+    while(len--)
+        crc = t[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#ifdef CRC32C_HW
+
+#if defined(__x86_64__)
+CRC32C_HW_TARGET inline uint32_t Hw8(uint32_t crc, uint8_t data) { return _mm_crc32_u8(crc, data); }
+CRC32C_HW_TARGET inline uint32_t Hw64(uint32_t crc, uint64_t data) { return static_cast<uint32_t>(_mm_crc32_u64(crc, data)); }
+inline bool HasHw() { return __builtin_cpu_supports("sse4.2"); }
+#else
+CRC32C_HW_TARGET inline uint32_t Hw8(uint32_t crc, uint8_t data) { return __crc32cb(crc, data); }
+CRC32C_HW_TARGET inline uint32_t Hw64(uint32_t crc, uint64_t data) { return __crc32cd(crc, data); }
+inline bool HasHw() { return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0; }
+#endif
+
+CRC32C_HW_TARGET inline uint64_t Load64(const uint8_t* p)
+{
+    uint64_t word = 0;
+    memcpy(&word, p, sizeof(word));
+    return word;
+}
+
+// 3 lanes of block bytes each, while there are enough of them
+CRC32C_HW_TARGET inline uint32_t HwBlocks(uint32_t crc, const uint8_t*& p, size_t& len, size_t block,
+                                          const uint32_t shift[4][256])
+{
+    while(len >= 3 * block)
+    {
+        uint32_t crc1 = 0, crc2 = 0;
+        const uint8_t* end = p + block;
+        for(; p < end; p += 8)
+        {
+            crc = Hw64(crc, Load64(p));
+            crc1 = Hw64(crc1, Load64(p + block));
+            crc2 = Hw64(crc2, Load64(p + 2 * block));
+        }
+        crc = Shift(shift, crc) ^ crc1;
+        crc = Shift(shift, crc) ^ crc2;
+        p += 2 * block;
+        len -= 3 * block;
+    }
+    return crc;
+}
+
+CRC32C_HW_TARGET inline uint32_t Hardware(uint32_t crc, const uint8_t* p, size_t len)
+{
+    for(; len && (reinterpret_cast<uintptr_t>(p) & 7); len--)
+        crc = Hw8(crc, *p++);
+
+    const Tables& tables = GetTables();
+    crc = HwBlocks(crc, p, len, LONG_BLOCK, tables.longShift);
+    crc = HwBlocks(crc, p, len, SHORT_BLOCK, tables.shortShift);
+
+    for(; len >= 8; len -= 8, p += 8)
+        crc = Hw64(crc, Load64(p));
+    while(len--)
+        crc = Hw8(crc, *p++);
+    return crc;
+}
+
+#endif // CRC32C_HW
+
+} // namespace crc32c
+
+// CRC32C of data, or of more data after the CRC crc of the preceding data
+inline uint32_t Crc32c(const void* data, size_t len, uint32_t crc = 0)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+#ifdef CRC32C_HW
+    static const bool hw = crc32c::HasHw();
+    if(hw)
+        return ~crc32c::Hardware(~crc, p, len);
+#endif
+    return ~crc32c::Software(~crc, p, len);
+}
+
+} // namespace gen
+
+#endif // __CRC32C_HPP__
@@ -8,9 +8,11 @@
 #include <sys/epoll.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/wait.h>     // waitpid()
 #include <errno.h>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -22,90 +24,213 @@
 #include <arpa/inet.h>
 #include "socketCommon.hpp"
 #include "threadPool.hpp"
+#include "ioUring.hpp"
 
 const int DEFAULT_BACKLOG = 512;
 const int DEFAULT_MAX_CONNECTIONS = 4096;
 const int DEFAULT_MAX_EVENTS = 64;
 const int DEFAULT_IDLE_TIMEOUT = 60;    // Sec
+const int WORKER_RESTART_DELAY = 1;     // Sec
+const int DEFAULT_DRAIN_TIMEOUT = 30;   // Sec
+const size_t DEFAULT_OUTPUT_HIGH_WATER_MARK = 4 * 1024 * 1024;   // Bytes
+const int HANDOFF_TIMEOUT = 5000;       // Ms
+const char HANDOFF_TAG[] = "LSTN";      // Handoff message carrying the listening socket
 
 namespace gen {
 
-class EpollServer
+// Event notification backend of the server
+enum class EventBackend
+{
+    EPOLL,
+    IO_URING    // Falls back to EPOLL if io_uring is not available
+};
+
+// Per-connection state. Derived servers extend it with their own protocol state.
+struct EpollClientContext
+{
+    EpollClientContext() = default;
+    virtual ~EpollClientContext() = default;
+
+    int fd{-1};
+    std::atomic<std::chrono::time_point<std::chrono::steady_clock>> lastActivityTime;
+    int connectionId{0};
+
+    // Number of events handed to worker threads and not yet finished.
+    // Incremented by the main loop, decremented by the worker.
+    // Immediate write mode: the events signaled while a worker handles the
+    // connection are counted too, and picked up by that worker.
+    std::atomic<int> pendingEvents{0};
+
+    // Replies queued by OnWrite(). Written without blocking; the rest is
+    // written when the socket is writable again.
+    OutputQueue outQueue;
+    bool writeDue{false};       // OnRead() succeeded, OnWrite() is to be called
+    bool writeArmed{false};     // Persistent registration: EPOLLOUT is registered
+};
+
+//
+// EpollServerT is the CRTP epoll server. DERIVED callbacks are resolved
+// statically (no virtual calls or casts on the per-event path):
+//   bool OnRead(CONTEXT_PTR& client);
+//   bool OnWrite(CONTEXT_PTR& client);
+//   CONTEXT_PTR MakeClientContext();
+// CONTEXT must be derived from EpollClientContext. Contexts are owned by
+// the server and passed to the event handlers through epoll_event.data.ptr,
+// so there is no lookup, lock or reference counting per event.
+//
+// With EventBackend::IO_URING, the epoll_wait()/epoll_ctl() pair is replaced by
+// io_uring: a multishot accept, one-shot polls re-armed by the worker threads
+// without a syscall (they are submitted in batches by the main loop), and a
+// timeout linked to every poll instead of the periodic idle connections scan.
+// The same OnRead()/OnWrite() callbacks are driven by the poll completions.
+//
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR = std::unique_ptr<CONTEXT>>
+class EpollServerT
 {
 public:
-    EpollServer(unsigned int threadsCount) : mThreadsCount(threadsCount) {}
-    virtual ~EpollServer() { Stop(); }
+    EpollServerT(unsigned int threadsCount, EventBackend backend = EventBackend::EPOLL) :
+        mThreadsCount(threadsCount), mBackend(backend) {}
+    virtual ~EpollServerT() { Stop(); }
 
     bool Start(unsigned short port, int backlog = DEFAULT_BACKLOG);
     bool Start(const char* sockName, bool isAbstract, int backlog = DEFAULT_BACKLOG);
     void Stop() { mServerRunning = false; }
+    bool IsRunning() const { return mServerRunning; }
 
     // Configuration
     void SetMaxEpollEventsCount(int maxEvents) { mMaxEvents = maxEvents; }
     void SetMaxConnections(int maxConnections) { mMaxConnections = maxConnections; }
     void SetIdleTimeout(int timeoutSec) { mIdleTimeout = std::chrono::seconds(timeoutSec); }
+    // Backpressure: stop reading from a connection while this many bytes of
+    // its replies are waiting to be written (the client doesn't read them)
+    void SetOutputHighWaterMark(size_t bytes) { mOutputHighWaterMark = bytes; }
+    // TCP: send replies of this many bytes or more with MSG_ZEROCOPY (0: disabled).
+    // The buffers are kept until the kernel reports the send completed, then
+    // recycled (see GetBufferPool()). Pays off above a few tens of KB.
+    void SetZeroCopyThreshold(size_t bytes) { mZeroCopyThreshold = bytes; }
     void SetVerbose(bool verbose) { mVerbose = verbose; }
+    // Immediate write mode: the worker calls OnWrite() right after every successful
+    // OnRead() instead of waiting for EPOLLOUT, and connections stay registered
+    // with epoll (edge-triggered) instead of being re-armed with EPOLLONESHOT on
+    // every read/write transition. A connection is still handled by one worker at
+    // a time. With io_uring, the client poll is re-armed once per call.
+    void SetImmediateWrite(bool immediateWrite) { mImmediateWrite = immediateWrite; }
+    // Unix domain sockets: use SOCK_SEQPACKET instead of SOCK_STREAM (kernel-preserved message boundaries)
+    void SetSeqPacket(bool seqPacket) { mSeqPacket = seqPacket; }
+
+    // Pre-fork mode: the parent process creates the listening socket and forks
+    // workersCount worker processes, each running its own epoll loop and thread pool.
+    // The parent supervises the workers and restarts the ones that exit.
+    // Note: Start() returns only in the parent; the worker processes exit with _exit().
+    void SetWorkerProcesses(unsigned int workersCount) { mWorkersCount = workersCount; }
+
+    // Hot restart: on Start(), the server first asks a running predecessor for its
+    // listening socket over the handoff socket (a Unix domain socket). If there is
+    // no predecessor, the listening socket is created as usual. Then the server
+    // listens on the handoff socket for its own successor. Once the listening socket
+    // is handed off, the server stops accepting connections, serves the existing
+    // ones until they are closed (or the drain timeout expires) and then stops.
+    void SetHandoffSocket(const char* sockName, bool isAbstract) { mHandoffName = sockName; mHandoffAbstract = isAbstract; }
+    void SetDrainTimeout(int timeoutSec) { mDrainTimeout = std::chrono::seconds(timeoutSec); }
 
 protected:
-    struct ClientContext
-    {
-        ClientContext() = default;
-        virtual ~ClientContext() = default;
-
-        int fd{-1};
-        std::chrono::time_point<std::chrono::steady_clock> lastActivityTime;
-        int connectionId{0};
-    };
-
     // For derived class to override
     virtual bool OnInit() { return true; }
-    virtual bool OnRead(std::shared_ptr<ClientContext>& client) = 0;
-    virtual bool OnWrite(std::shared_ptr<ClientContext>& client) = 0;
-    virtual std::shared_ptr<ClientContext> MakeClientContext() = 0;
+    // Pre-fork mode: called once in the parent before forking the workers.
+    // State built here (caches, lookup tables) is shared copy-on-write by all workers.
+    virtual bool OnPreFork() { return true; }
+    // Pre-fork mode: called in a worker process before it starts its event loop
+    virtual void OnWorkerStart(unsigned int /*workerIndex*/) {}
     virtual void OnError(const char* fname, int lineNum, const std::string& err) const;
     virtual void OnInfo(const char* fname, int lineNum, const std::string& info) const;
 
+    // Buffers recycled from zero-copy sends, to build the next replies in
+    BufferPool& GetBufferPool() { return mBufferPool; }
+    size_t GetOutputHighWaterMark() const { return mOutputHighWaterMark; }
+    std::chrono::seconds GetIdleTimeout() const { return mIdleTimeout; }
+
 private:
     bool StartImpl();
+    bool StartUringImpl();
+    void HandleCompletion(uint64_t userData, int res, uint32_t flags);
+    bool StartWorkers();
+    pid_t ForkWorker(unsigned int workerIndex);
+    int RecvListenFd();
+    bool SetupHandoffSocket();
+    bool HandoffListenFd();
+    void StartDraining();
+    bool IsDrained();
     bool CanAcceptNewConnection();
-    void UpdateActivityTime(int clientFd);
     void CheckIdleConnections();
     void HandleAcceptEvent();
-    void HandleReadEvent(int clientFd);
-    void HandleWriteEvent(int clientFd);
+    void AcceptClient(int connFd, const struct sockaddr_in* clientAddr);
+    void HandleClientEvent(CONTEXT_PTR* client, uint32_t event);
+    void HandleReadEvent(CONTEXT_PTR* client);
+    void HandleWriteEvent(CONTEXT_PTR* client);
+    void HandleReadWriteEvent(CONTEXT_PTR* client);
+    void ReleaseClosedClients();
+    bool FlushOutput(CONTEXT_PTR& client);
+    uint32_t ClientEvents(CONTEXT_PTR& client) const;
     void CleanupClient(int clientFd);
     void Cleanup();
 
-    void AddClientContext(int clientFd, const struct sockaddr_in& clientAddr);
-    std::shared_ptr<ClientContext> GetClientContext(int clientFd);
+    CONTEXT_PTR* AddClientContext(int clientFd, const struct sockaddr_in& clientAddr);
 
-    bool EpollAdd(int fd, uint32_t events);
-    bool EpollMod(int fd, uint32_t events);
+    bool EpollAdd(int fd, uint32_t events, void* ptr);
+    bool EpollMod(int fd, uint32_t events, void* ptr);
     bool EpollDel(int fd);
+    bool ArmClient(int fd, uint32_t events, CONTEXT_PTR* client, bool add);
+
+    DERIVED* Derived() { return static_cast<DERIVED*>(this); }
 
     // No default or copy constructors
-    EpollServer() = delete;
-    EpollServer(const EpollServer&) = delete;
+    EpollServerT() = delete;
+    EpollServerT(const EpollServerT&) = delete;
 
 private:
     unsigned int mThreadsCount{0};
+    EventBackend mBackend{EventBackend::EPOLL};
+    IoUring mUring;
+    bool mMultishotAccept{true};    // Multishot accept requires Linux 5.19
+    __kernel_timespec mIdleTimeoutTs{0, 0};
     int mMaxEvents{DEFAULT_MAX_EVENTS};
     std::chrono::seconds mIdleTimeout{DEFAULT_IDLE_TIMEOUT};
+    size_t mOutputHighWaterMark{DEFAULT_OUTPUT_HIGH_WATER_MARK};
+    size_t mZeroCopyThreshold{0};
+    BufferPool mBufferPool;
     size_t mMaxConnections{DEFAULT_MAX_CONNECTIONS};
     std::atomic<bool> mServerRunning{false};
     int mEpollFd{-1};
     int mListenFd{-1};
+    unsigned int mWorkersCount{0};
+    int mStopPipeFd[2]{-1, -1};     // Pre-fork mode: parent closes the write end to stop workers
+    std::string mHandoffName;
+    bool mHandoffAbstract{false};
+    int mHandoffFd{-1};
+    bool mDraining{false};
+    std::chrono::seconds mDrainTimeout{DEFAULT_DRAIN_TIMEOUT};
+    std::chrono::time_point<std::chrono::steady_clock> mDrainDeadline;
     std::atomic<int> mNextConnectionId{1};
-    std::map<int, std::shared_ptr<ClientContext>> mClientContexts;
+    // Note: Elements of unordered_map keep their addresses on rehash,
+    // so &mClientContexts[fd] is registered with epoll as the event data.
+    std::unordered_map<int, CONTEXT_PTR> mClientContexts;
     std::mutex mClientContextsMutex;
+    bool mImmediateWrite{false};
+    bool mPersistentEpoll{false};   // Immediate write mode with epoll
+    // Persistent epoll registration: clients closed by worker threads are released
+    // by the main loop, once no event retrieved from epoll can refer to them
+    std::vector<int> mClosedClients;
     ThreadPool mThreadPool;
 
 protected:
     bool mVerbose{false};
+    bool mDomainSocket{false};      // Listening on a Unix domain socket
+    bool mSeqPacket{false};         // Unix domain socket is SOCK_SEQPACKET
 
 };
 
-inline bool EpollServer::Start(unsigned short port, int backlog)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::Start(unsigned short port, int backlog)
 {
     if(!OnInit())
     {
@@ -113,25 +238,34 @@ inline bool EpollServer::Start(unsigned short port, int backlog)
         return false;
     }
 
-    // Create listening NET socket (nonblocking)
+    // Take over the listening socket from a running predecessor (if any), or
+    // create listening NET socket (nonblocking)
     std::string errMsg;
-    mListenFd = gen::SetupServerSocket(port, false /*blocking*/, backlog, errMsg);
+    if((mListenFd = RecvListenFd()) < 0)
+        mListenFd = gen::SetupServerSocket(port, true /*nonblocking*/, backlog, errMsg);
     if(mListenFd < 0)
     {
         OnError(__FNAME__, __LINE__, errMsg);
         return false;
     }
 
+    if(!SetupHandoffSocket())
+    {
+        Cleanup();
+        return false;
+    }
+
     {
         std::stringstream ss;
         ss << "Starting server on port " << port << ".";
         OnInfo(__FNAME__, __LINE__, ss.str());
     }
 
-    return StartImpl();
+    return (mWorkersCount > 0 ? StartWorkers() : StartImpl());
 }
 
-inline bool EpollServer::Start(const char* sockName, bool isAbstract, int backlog)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::Start(const char* sockName, bool isAbstract, int backlog)
 {
     if(!OnInit())
     {
@@ -139,14 +273,25 @@ inline bool EpollServer::Start(const char* sockName, bool isAbstract, int backlo
         return false;
     }
 
-    // Create listening unix domain socket (nonblocking)
+    // Take over the listening socket from a running predecessor (if any), or
+    // create listening unix domain socket (nonblocking).
+    // Note: The predecessor's socket is not unlinked, so clients never see it missing.
     std::string errMsg;
-    mListenFd = gen::SetupServerDomainSocket(sockName, isAbstract, false /*blocking*/, backlog, errMsg);
+    if((mListenFd = RecvListenFd()) < 0)
+        mListenFd = gen::SetupServerDomainSocket(sockName, isAbstract, backlog, true /*nonblocking*/, errMsg,
+                                                 (mSeqPacket ? SOCK_SEQPACKET : SOCK_STREAM));
     if(mListenFd < 0)
     {
         OnError(__FNAME__, __LINE__, errMsg);
         return false;
     }
+    mDomainSocket = true;
+
+    if(!SetupHandoffSocket())
+    {
+        Cleanup();
+        return false;
+    }
 
     {
         std::stringstream ss;
@@ -154,12 +299,23 @@ inline bool EpollServer::Start(const char* sockName, bool isAbstract, int backlo
         OnInfo(__FNAME__, __LINE__, ss.str());
     }
 
-    return StartImpl();
+    return (mWorkersCount > 0 ? StartWorkers() : StartImpl());
 }
 
-inline bool EpollServer::StartImpl()
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::StartImpl()
 {
+    if(mBackend == EventBackend::IO_URING)
+    {
+        // Note: The completion queue holds a poll (and its linked timeout) per connection
+        std::string errMsg;
+        if(mUring.Init(IO_URING_DEFAULT_ENTRIES, static_cast<unsigned int>(2 * mMaxConnections + 64), errMsg))
+            return StartUringImpl();
+        OnError(__FNAME__, __LINE__, errMsg + ", falling back to epoll.");
+    }
+
     // Create epoll instance
+    mPersistentEpoll = mImmediateWrite;
     mEpollFd = epoll_create1(0);
     if(mEpollFd == -1)
     {
@@ -168,14 +324,32 @@ inline bool EpollServer::StartImpl()
         return false;
     }
 
-    // Add listening socket to epoll
-    if(!EpollAdd(mListenFd, EPOLLIN))
+    // Add listening socket to epoll.
+    // Note: In pre-fork mode all workers wait on the same listening socket;
+    // EPOLLEXCLUSIVE wakes up only one of them per incoming connection.
+    if(!EpollAdd(mListenFd, (mStopPipeFd[0] != -1 ? EPOLLIN | EPOLLEXCLUSIVE : EPOLLIN), &mListenFd))
     {
         OnError(__FNAME__, __LINE__, "Error adding listening fd " + std::to_string(mListenFd) + " to epoll.");
         Cleanup();
         return false;
     }
 
+    // Pre-fork mode: the worker stops when the parent closes the stop pipe (or dies)
+    if(mStopPipeFd[0] != -1 && !EpollAdd(mStopPipeFd[0], EPOLLIN, &mStopPipeFd))
+    {
+        OnError(__FNAME__, __LINE__, "Error adding stop pipe fd " + std::to_string(mStopPipeFd[0]) + " to epoll.");
+        Cleanup();
+        return false;
+    }
+
+    // Hot restart: wait for a successor to ask for the listening socket
+    if(mHandoffFd != -1 && !EpollAdd(mHandoffFd, EPOLLIN, &mHandoffFd))
+    {
+        OnError(__FNAME__, __LINE__, "Error adding handoff fd " + std::to_string(mHandoffFd) + " to epoll.");
+        Cleanup();
+        return false;
+    }
+
     OnInfo(__FNAME__, __LINE__, "Starting thread pool with " + std::to_string(mThreadsCount) + " worker threads.");
 
     // Start worker threads
@@ -191,31 +365,56 @@ inline bool EpollServer::StartImpl()
 
     while(mServerRunning)
     {
+        // Hot restart: stop once the remaining connections are served
+        if(mDraining && IsDrained())
+        {
+            OnInfo(__FNAME__, __LINE__, "Draining finished.");
+            mServerRunning = false;
+            break;
+        }
+
+        // Note: The events of the previous rounds are all dispatched by now
+        if(mPersistentEpoll)
+            ReleaseClosedClients();
+
         int numEvents = epoll_wait(mEpollFd, events, mMaxEvents, epollWaitTimeoutMs);
 
         if(numEvents > 0)
         {
             for(int i = 0; i < numEvents; ++i)
             {
-                int fd = events[i].data.fd;
+                void* ptr = events[i].data.ptr;
                 uint32_t event = events[i].events;
 
-                if(fd == mListenFd)
+                if(ptr == &mListenFd)
                 {
                     HandleAcceptEvent();
                 }
-                else
+                else if(ptr == &mStopPipeFd)
                 {
-                    // Queue a task for a worker thread to handle this event
-                    if(event & (EPOLLIN | EPOLLHUP | EPOLLRDHUP | EPOLLERR))
+                    // The parent writes one byte per worker to request draining,
+                    // or closes the pipe to request stop
+                    char cmd = 0;
+                    if(read(mStopPipeFd[0], &cmd, 1) == 1)
                     {
-                        mThreadPool.Post(&EpollServer::HandleReadEvent, this, fd);
+                        EpollDel(mStopPipeFd[0]);
+                        StartDraining();
                     }
-                    else if(event & EPOLLOUT)
+                    else
                     {
-                        mThreadPool.Post(&EpollServer::HandleWriteEvent, this, fd);
+                        OnInfo(__FNAME__, __LINE__, "Worker stop requested by the parent process.");
+                        mServerRunning = false;
                     }
                 }
+                else if(ptr == &mHandoffFd)
+                {
+                    if(HandoffListenFd())
+                        StartDraining();
+                }
+                else
+                {
+                    HandleClientEvent(static_cast<CONTEXT_PTR*>(ptr), event);
+                }
             }
         }
         else if(numEvents == 0) // Timeout occurred
@@ -240,17 +439,171 @@ inline bool EpollServer::StartImpl()
     return true;
 }
 
-inline void EpollServer::Cleanup()
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::StartUringImpl()
+{
+    // The kernel cancels a client poll when the connection is idle for too long
+    mIdleTimeoutTs.tv_sec = mIdleTimeout.count();
+    mIdleTimeoutTs.tv_nsec = 0;
+
+    // Accept connections, and watch the stop pipe (pre-fork mode) and the handoff socket (hot restart)
+    if(!mUring.Accept(mListenFd, mMultishotAccept, reinterpret_cast<uint64_t>(&mListenFd)) ||
+       (mStopPipeFd[0] != -1 && !mUring.PollAdd(mStopPipeFd[0], EPOLLIN, reinterpret_cast<uint64_t>(&mStopPipeFd))) ||
+       (mHandoffFd != -1 && !mUring.PollAdd(mHandoffFd, EPOLLIN, reinterpret_cast<uint64_t>(&mHandoffFd))))
+    {
+        OnError(__FNAME__, __LINE__, "Error queueing the initial io_uring requests.");
+        Cleanup();
+        return false;
+    }
+
+    OnInfo(__FNAME__, __LINE__, "Starting thread pool with " + std::to_string(mThreadsCount) + " worker threads (io_uring).");
+
+    // Start worker threads
+    mThreadPool.Start(mThreadsCount);
+
+    // Main event loop
+    mServerRunning = true;
+    int waitTimeoutMs = 100;
+    std::string errMsg;
+
+    while(mServerRunning)
+    {
+        // Hot restart: stop once the remaining connections are served
+        if(mDraining && IsDrained())
+        {
+            OnInfo(__FNAME__, __LINE__, "Draining finished.");
+            mServerRunning = false;
+            break;
+        }
+
+        // Submit the queued requests (re-armed polls) and handle the completions
+        if(mUring.Run(waitTimeoutMs, [this](uint64_t userData, int res, uint32_t flags) {
+                HandleCompletion(userData, res, flags); }, errMsg) == -1)
+        {
+            OnError(__FNAME__, __LINE__, errMsg);
+        }
+    }
+
+    // Cancel the accept and wait for it to end: closing the ring cancels it in
+    // the background, and until then it keeps the listening socket (and its
+    // address) in use. The other completions don't matter anymore.
+    if(mListenFd != -1 && mUring.Cancel(reinterpret_cast<uint64_t>(&mListenFd)))
+    {
+        bool accepting = true;
+        for(int i = 0; i < 10 && accepting; i++)
+        {
+            mUring.Run(waitTimeoutMs, [this, &accepting](uint64_t userData, int /*res*/, uint32_t flags) {
+                accepting &= (userData != reinterpret_cast<uint64_t>(&mListenFd) || (flags & IORING_CQE_F_MORE)); }, errMsg);
+        }
+    }
+
+    OnInfo(__FNAME__, __LINE__, "Main event loop finished.");
+    Cleanup();
+    OnInfo(__FNAME__, __LINE__, "Epoll server stopped.");
+    return true;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleCompletion(uint64_t userData, int res, uint32_t flags)
+{
+    void* ptr = reinterpret_cast<void*>(userData);
+
+    if(ptr == &mListenFd)
+    {
+        if(res >= 0)
+            AcceptClient(res, nullptr);
+        else if(res == -EINVAL && mMultishotAccept)
+            mMultishotAccept = false;   // Old kernel: fall back to one accept per request
+        else if(res != -ECANCELED && res != -EAGAIN)
+            OnError(__FNAME__, __LINE__, std::string("Accept failed: ") + strerror(-res));
+
+        // Re-arm, unless the multishot accept is still active or the server doesn't accept anymore
+        if(!(flags & IORING_CQE_F_MORE) && mListenFd != -1 && !mDraining &&
+           !mUring.Accept(mListenFd, mMultishotAccept, userData))
+        {
+            OnError(__FNAME__, __LINE__, "Error queueing accept for listening fd " + std::to_string(mListenFd) + ".");
+        }
+    }
+    else if(ptr == &mStopPipeFd)
+    {
+        // The parent writes one byte per worker to request draining,
+        // or closes the pipe to request stop
+        char cmd = 0;
+        if(read(mStopPipeFd[0], &cmd, 1) == 1)
+        {
+            StartDraining();
+        }
+        else
+        {
+            OnInfo(__FNAME__, __LINE__, "Worker stop requested by the parent process.");
+            mServerRunning = false;
+        }
+    }
+    else if(ptr == &mHandoffFd)
+    {
+        if(HandoffListenFd())
+            StartDraining();
+        else if(mHandoffFd != -1 && !mUring.PollAdd(mHandoffFd, EPOLLIN, userData))
+            OnError(__FNAME__, __LINE__, "Error queueing poll for handoff fd " + std::to_string(mHandoffFd) + ".");
+    }
+    else
+    {
+        // Client poll completed with the events (or an error), or it was cancelled by the idle timeout.
+        // Note: A client with a poll in flight is not handled by any worker thread.
+        CONTEXT_PTR* client = static_cast<CONTEXT_PTR*>(ptr);
+        if(res == -ECANCELED &&
+           std::chrono::steady_clock::now() - (*client)->lastActivityTime.load() < mIdleTimeout)
+        {
+            // Active off the polled socket (e.g. shared memory, subscription): poll again
+            bool rearmed = false;
+            {
+                std::lock_guard<std::mutex> lock(mClientContextsMutex);
+                rearmed = ArmClient((*client)->fd, ClientEvents(*client), client, false);
+            }
+            if(!rearmed)
+            {
+                OnError(__FNAME__, __LINE__, "Error re-arming poll for fd " + std::to_string((*client)->fd) + ".");
+                CleanupClient((*client)->fd);
+            }
+        }
+        else if(res == -ECANCELED)
+        {
+            if(mVerbose)
+            {
+                std::stringstream ss;
+                ss << "Closing idle connection " << (*client)->connectionId << " (fd " << (*client)->fd << ").";
+                OnInfo(__FNAME__, __LINE__, ss.str());
+            }
+
+            CleanupClient((*client)->fd);
+        }
+        else
+        {
+            HandleClientEvent(client, (res < 0 ? EPOLLERR : static_cast<uint32_t>(res)));
+        }
+    }
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::Cleanup()
 {
     // Stop the thread pool and wait all threads to complete
     mThreadPool.Stop();
     mThreadPool.Wait();
 
-    // Note: We don't need to lock mClientContextsMutex since threads are gone
+    // Note: Closing the ring cancels the requests in flight
+    mUring.Close();
+
+    // Note: We don't need to lock mClientContextsMutex since threads are gone.
+    // The descriptors are closed last: the output queues may still use them.
+    std::vector<int> fds;
     for(const auto& pair : mClientContexts)
-        close(pair.first); // pair.first is the key (fd)
+        fds.push_back(pair.first); // pair.first is the key (fd)
 
     mClientContexts.clear();
+    mClosedClients.clear();
+    for(int fd : fds)
+        close(fd);
 
     if(mEpollFd != -1)
     {
@@ -263,12 +616,306 @@ inline void EpollServer::Cleanup()
         close(mListenFd);
         mListenFd = -1;
     }
+
+    for(int& fd : mStopPipeFd)
+    {
+        if(fd != -1)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if(mHandoffFd != -1)
+    {
+        close(mHandoffFd);
+        mHandoffFd = -1;
+    }
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::StartWorkers()
+{
+    // Let the derived class warm up the state to be shared by all workers
+    if(!OnPreFork())
+    {
+        OnError(__FNAME__, __LINE__, "Pre-fork initialization failed: OnPreFork() returned false");
+        Cleanup();
+        return false;
+    }
+
+    // Workers watch the read end of the stop pipe. Closing the write end
+    // (by Stop() or because the parent died) stops all the workers.
+    if(pipe2(mStopPipeFd, O_CLOEXEC) == -1)
+    {
+        OnError(__FNAME__, __LINE__, "pipe2() failed: " + std::string(strerror(errno)));
+        Cleanup();
+        return false;
+    }
+
+    OnInfo(__FNAME__, __LINE__, "Starting " + std::to_string(mWorkersCount) + " worker processes.");
+
+    struct Worker
+    {
+        pid_t pid{-1};
+        std::chrono::time_point<std::chrono::steady_clock> startTime;
+    };
+
+    mServerRunning = true;
+    bool handedOff = false;
+    std::vector<Worker> workers(mWorkersCount);
+
+    // Supervisor loop: start the workers and restart the ones that exit
+    while(mServerRunning)
+    {
+        auto now = std::chrono::steady_clock::now();
+
+        for(unsigned int i = 0; i < workers.size() && mServerRunning; i++)
+        {
+            Worker& worker = workers[i];
+
+            if(worker.pid > 0)
+            {
+                int status = 0;
+                pid_t pid = waitpid(worker.pid, &status, WNOHANG);
+                if(pid == 0 || (pid == -1 && errno == EINTR))
+                    continue; // Still running
+
+                std::stringstream ss;
+                ss << "Worker " << i << " (pid " << worker.pid << ") ";
+                if(pid == -1)
+                    ss << "is lost: waitpid() failed: " << strerror(errno);
+                else if(WIFSIGNALED(status))
+                    ss << "was killed by signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+                else
+                    ss << "exited with status " << WEXITSTATUS(status);
+                OnError(__FNAME__, __LINE__, ss.str() + ", restarting.");
+                worker.pid = -1;
+            }
+
+            // Don't restart workers that keep failing in a tight loop
+            if(now - worker.startTime < std::chrono::seconds(WORKER_RESTART_DELAY))
+                continue;
+
+            worker.startTime = now;
+            worker.pid = ForkWorker(i);
+        }
+
+        // Wait 100 ms, or until a successor asks for the listening socket
+        struct pollfd pfd = {mHandoffFd, POLLIN, 0};
+        if(poll(&pfd, 1, 100) == 1 && HandoffListenFd())
+        {
+            // Tell every worker to drain: the successor accepts the new connections now
+            close(mListenFd);
+            mListenFd = -1;
+            std::string cmd(workers.size(), 'D');
+            if(write(mStopPipeFd[1], cmd.data(), cmd.size()) != static_cast<ssize_t>(cmd.size()))
+                OnError(__FNAME__, __LINE__, "Failed to notify workers to drain: " + std::string(strerror(errno)));
+            handedOff = true;
+            break;
+        }
+    }
+
+    if(handedOff)
+    {
+        OnInfo(__FNAME__, __LINE__, "Waiting for worker processes to drain.");
+    }
+    else
+    {
+        // Stop the workers and wait for them to exit
+        OnInfo(__FNAME__, __LINE__, "Stopping worker processes.");
+        close(mStopPipeFd[1]);
+        mStopPipeFd[1] = -1;
+    }
+
+    for(Worker& worker : workers)
+    {
+        while(worker.pid > 0 && waitpid(worker.pid, nullptr, 0) == -1 && errno == EINTR)
+            ;
+    }
+
+    Cleanup();
+    OnInfo(__FNAME__, __LINE__, "Epoll server stopped.");
+    return true;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline pid_t EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::ForkWorker(unsigned int workerIndex)
+{
+    // Flush the streams so buffered output is not duplicated by the child
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+
+    pid_t pid = fork();
+    if(pid == -1)
+    {
+        OnError(__FNAME__, __LINE__, "fork() failed: " + std::string(strerror(errno)));
+        return -1;
+    }
+    else if(pid > 0)
+    {
+        // Parent
+        if(mVerbose)
+            OnInfo(__FNAME__, __LINE__, "Worker " + std::to_string(workerIndex) + " started, pid " + std::to_string(pid) + ".");
+        return pid;
+    }
+
+    // Worker process: run own epoll loop and thread pool on the inherited listening socket
+    close(mStopPipeFd[1]);
+    mStopPipeFd[1] = -1;
+
+    // The handoff socket is served by the parent
+    if(mHandoffFd != -1)
+    {
+        close(mHandoffFd);
+        mHandoffFd = -1;
+    }
+
+    OnWorkerStart(workerIndex);
+    bool res = StartImpl();
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+    _exit(res ? 0 : 1);
 }
 
-inline bool EpollServer::EpollAdd(int fd, uint32_t events)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline int EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::RecvListenFd()
+{
+    if(mHandoffName.empty())
+        return -1;
+
+    // Connect to the predecessor (if running) and ask for its listening socket
+    std::string errMsg;
+    std::string path = (mHandoffAbstract ? std::string(1, '\0') : std::string()) + mHandoffName;
+    int sock = gen::SetupClientDomainSocket(path.c_str(), errMsg);
+    if(sock == -1)
+    {
+        OnInfo(__FNAME__, __LINE__, "No predecessor on the handoff socket " + mHandoffName + ", creating a new listening socket.");
+        return -1;
+    }
+
+    int fd = -1;
+    size_t fdsCount = 1;
+    char tag[4] = {0};
+    bool res = gen::RecvFds(sock, &fd, fdsCount, tag, sizeof(tag), HANDOFF_TIMEOUT, errMsg);
+    close(sock);
+
+    if(!res)
+    {
+        OnError(__FNAME__, __LINE__, "Listening socket handoff failed: " + errMsg);
+        return -1;
+    }
+
+    if(memcmp(tag, HANDOFF_TAG, sizeof(tag)) != 0)
+    {
+        OnError(__FNAME__, __LINE__, "Listening socket handoff failed: unexpected message");
+        close(fd);
+        return -1;
+    }
+
+    // The descriptor is shared with the predecessor: make sure it is nonblocking
+    int flags = fcntl(fd, F_GETFL, 0);
+    if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+    {
+        OnError(__FNAME__, __LINE__, "fcntl() failed: " + std::string(strerror(errno)));
+        close(fd);
+        return -1;
+    }
+
+    OnInfo(__FNAME__, __LINE__, "Took over the listening socket from the predecessor.");
+    return fd;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::SetupHandoffSocket()
+{
+    if(mHandoffName.empty())
+        return true;
+
+    std::string errMsg;
+    mHandoffFd = gen::SetupServerDomainSocket(mHandoffName.c_str(), mHandoffAbstract, 1, true /*nonblocking*/, errMsg);
+    if(mHandoffFd == -1)
+    {
+        OnError(__FNAME__, __LINE__, "Failed to create the handoff socket: " + errMsg);
+        return false;
+    }
+    return true;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandoffListenFd()
+{
+    int sock = accept(mHandoffFd, nullptr, nullptr);
+    if(sock == -1)
+    {
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+            OnError(__FNAME__, __LINE__, "accept() failed on the handoff socket: " + std::string(strerror(errno)));
+        return false;
+    }
+
+    // Close the handoff socket first, so the successor can bind it for its own successor
+    if(mEpollFd != -1)
+        EpollDel(mHandoffFd);
+    close(mHandoffFd);
+    mHandoffFd = -1;
+
+    std::string errMsg;
+    bool res = gen::SendFds(sock, &mListenFd, 1, HANDOFF_TAG, strlen(HANDOFF_TAG), errMsg);
+    close(sock);
+
+    if(!res)
+    {
+        // Keep serving: we can't take the handoff socket back, but the listening socket is ours
+        OnError(__FNAME__, __LINE__, "Listening socket handoff failed: " + errMsg);
+        return false;
+    }
+
+    OnInfo(__FNAME__, __LINE__, "Listening socket handed off to the successor.");
+    return true;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::StartDraining()
+{
+    // Stop accepting: the listening socket stays open in the successor
+    if(mListenFd != -1)
+    {
+        if(mEpollFd != -1)
+            EpollDel(mListenFd);
+        else if(mUring.IsOpen())
+            mUring.Cancel(reinterpret_cast<uint64_t>(&mListenFd));
+        close(mListenFd);
+        mListenFd = -1;
+    }
+
+    mDraining = true;
+    mDrainDeadline = std::chrono::steady_clock::now() + mDrainTimeout;
+
+    std::lock_guard<std::mutex> lock(mClientContextsMutex);
+    OnInfo(__FNAME__, __LINE__, "Draining " + std::to_string(mClientContexts.size()) + " connections.");
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::IsDrained()
+{
+    if(std::chrono::steady_clock::now() >= mDrainDeadline)
+    {
+        OnInfo(__FNAME__, __LINE__, "Drain timeout expired.");
+        return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mClientContextsMutex);
+    return mClientContexts.empty();
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::EpollAdd(int fd, uint32_t events, void* ptr)
 {
     struct epoll_event event;
-    event.data.fd = fd;
+    event.data.ptr = ptr;
     event.events = events;
 
     if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &event) == -1)
@@ -279,10 +926,11 @@ inline bool EpollServer::EpollAdd(int fd, uint32_t events)
     return true;
 }
 
-inline bool EpollServer::EpollMod(int fd, uint32_t events)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::EpollMod(int fd, uint32_t events, void* ptr)
 {
     struct epoll_event event;
-    event.data.fd = fd;
+    event.data.ptr = ptr;
     event.events = events;
 
     if(epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &event) == -1)
@@ -293,7 +941,8 @@ inline bool EpollServer::EpollMod(int fd, uint32_t events)
     return true;
 }
 
-inline bool EpollServer::EpollDel(int fd)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::EpollDel(int fd)
 {
     if(epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr) == -1)
     {
@@ -303,53 +952,54 @@ inline bool EpollServer::EpollDel(int fd)
     return true;
 }
 
-inline bool EpollServer::CanAcceptNewConnection()
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::ArmClient(int fd, uint32_t events, CONTEXT_PTR* client, bool add)
+{
+    // Note: One-shot, so the client is handled by one worker thread at a time
+    if(mUring.IsOpen())
+        return mUring.PollAdd(fd, events, reinterpret_cast<uint64_t>(client), &mIdleTimeoutTs);
+
+    // Persistent registration: the client is registered once, edge-triggered
+    if(mPersistentEpoll)
+        return EpollAdd(fd, events | EPOLLET, client);
+
+    return (add ? EpollAdd(fd, events | EPOLLONESHOT, client) : EpollMod(fd, events | EPOLLONESHOT, client));
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::CanAcceptNewConnection()
 {
     std::lock_guard<std::mutex> lock(mClientContextsMutex);
     return (mClientContexts.size() < mMaxConnections);
 }
 
-inline void EpollServer::AddClientContext(int clientFd, const struct sockaddr_in &clientAddr)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline CONTEXT_PTR* EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::AddClientContext(int clientFd, const struct sockaddr_in &clientAddr)
 {
-    std::shared_ptr<ClientContext> client = MakeClientContext();
+    CONTEXT_PTR client = Derived()->MakeClientContext();
     client->fd = clientFd;
     client->lastActivityTime = std::chrono::steady_clock::now();
     client->connectionId = mNextConnectionId++;
 
-    {
-        std::lock_guard<std::mutex> lock(mClientContextsMutex);
-        mClientContexts[clientFd] = client;
-    }
-
-    std::string clientIp = inet_ntoa(clientAddr.sin_addr);
-    unsigned short clientPort = ntohs(clientAddr.sin_port);
-
     if(mVerbose)
     {
+        std::string clientIp = inet_ntoa(clientAddr.sin_addr);
+        unsigned short clientPort = ntohs(clientAddr.sin_port);
+
         std::stringstream ss;
         ss << "Connection " << client->connectionId << " from " << clientIp
            << ":" << clientPort << " accepted, clientFd=" << clientFd << ".";
         OnInfo(__FNAME__, __LINE__, ss.str());
     }
-}
 
-inline std::shared_ptr<EpollServer::ClientContext> EpollServer::GetClientContext(int clientFd)
-{
     std::lock_guard<std::mutex> lock(mClientContextsMutex);
-    auto it = mClientContexts.find(clientFd);
-    return (it != mClientContexts.end() ? it->second : nullptr);
+    CONTEXT_PTR& slot = mClientContexts[clientFd];
+    slot = std::move(client);
+    return &slot;
 }
 
-inline void EpollServer::UpdateActivityTime(int clientFd)
-{
-    std::lock_guard<std::mutex> lock(mClientContextsMutex);
-    if(mClientContexts.count(clientFd))
-    {
-        mClientContexts[clientFd]->lastActivityTime = std::chrono::steady_clock::now();
-    }
-}
-
-inline void EpollServer::CheckIdleConnections()
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::CheckIdleConnections()
 {
     auto now = std::chrono::steady_clock::now();
     std::vector<int> clientsToClose;
@@ -358,7 +1008,11 @@ inline void EpollServer::CheckIdleConnections()
         std::lock_guard<std::mutex> lock(mClientContextsMutex);
         for(const auto &pair : mClientContexts)
         {
-            if((now - pair.second->lastActivityTime) > mIdleTimeout)
+            // Note: Skip connections that are being processed by worker threads.
+            // New events are only posted by this (main) thread, so the connection
+            // can't become busy while we are closing it.
+            if(pair.second->pendingEvents == 0 &&
+               (now - pair.second->lastActivityTime.load()) > mIdleTimeout)
             {
                 if(mVerbose)
                 {
@@ -376,22 +1030,50 @@ inline void EpollServer::CheckIdleConnections()
         CleanupClient(fd);
 }
 
-inline void EpollServer::HandleAcceptEvent()
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleAcceptEvent()
 {
     sockaddr_in clientAddr;
     socklen_t clientAddressLen = sizeof(clientAddr);
     int connFd = accept(mListenFd, (sockaddr*)&clientAddr, &clientAddressLen);
     if(connFd == -1)
     {
-        OnError(__FNAME__, __LINE__, std::string("Accept failed: ") + strerror(errno));
+        // Note: The listening socket is nonblocking, and another worker
+        // process may have accepted this connection already
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+            OnError(__FNAME__, __LINE__, std::string("Accept failed: ") + strerror(errno));
         return;
     }
 
-    if(CanAcceptNewConnection())
+    AcceptClient(connFd, &clientAddr);
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::AcceptClient(int connFd, const struct sockaddr_in* clientAddr)
+{
+    // Note: io_uring accepts don't return the client address, get it only to log it
+    sockaddr_in peerAddr;
+    memset(&peerAddr, 0, sizeof(peerAddr));
+    bool canAccept = CanAcceptNewConnection();
+    if(clientAddr == nullptr && (mVerbose || !canAccept))
+    {
+        socklen_t peerAddrLen = sizeof(peerAddr);
+        getpeername(connFd, (sockaddr*)&peerAddr, &peerAddrLen);
+    }
+    if(clientAddr == nullptr)
+        clientAddr = &peerAddr;
+
+    if(canAccept)
     {
-        AddClientContext(connFd, clientAddr);
+        CONTEXT_PTR* client = AddClientContext(connFd, *clientAddr);
 
-        if(!EpollAdd(connFd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT))
+        // Note: Without SO_ZEROCOPY, MSG_ZEROCOPY is silently ignored
+        int on = 1;
+        if(mZeroCopyThreshold != 0 && !mDomainSocket &&
+           setsockopt(connFd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) == 0)
+            (*client)->outQueue.EnableZeroCopy(connFd, mZeroCopyThreshold, &mBufferPool);
+
+        if(!ArmClient(connFd, EPOLLIN | EPOLLRDHUP, client, true))
         {
             OnError(__FNAME__, __LINE__, "Error adding client fd " + std::to_string(connFd) + " to epoll.");
             close(connFd);
@@ -403,33 +1085,89 @@ inline void EpollServer::HandleAcceptEvent()
     {
         std::stringstream ss;
         ss << "Maximum connections reached. Rejecting new connection from "
-           << inet_ntoa(clientAddr.sin_addr) << ":" << ntohs(clientAddr.sin_port);
+           << inet_ntoa(clientAddr->sin_addr) << ":" << ntohs(clientAddr->sin_port);
         OnError(__FNAME__, __LINE__, ss.str());
         close(connFd); // Immediately close the connection
     }
 }
 
-inline void EpollServer::HandleReadEvent(int clientFd)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleClientEvent(CONTEXT_PTR* client, uint32_t event)
 {
-    std::shared_ptr<ClientContext> client = GetClientContext(clientFd);
-    if(!client)
+    // Queue a task for a worker thread to handle this event
+    if(mImmediateWrite)
     {
-        std::stringstream ss;
-        ss << "Client context not found for fd " << clientFd << " in read event.";
-        OnError(__FNAME__, __LINE__, ss.str());
-        return;
+        // Note: If a worker is handling the client already, it picks up this event
+        if((*client)->pendingEvents++ == 0)
+            mThreadPool.Post(&EpollServerT::HandleReadWriteEvent, this, client);
+    }
+    else if(event & (EPOLLIN | EPOLLHUP | EPOLLRDHUP | EPOLLERR))
+    {
+        (*client)->pendingEvents++;
+        mThreadPool.Post(&EpollServerT::HandleReadEvent, this, client);
+    }
+    else if(event & EPOLLOUT)
+    {
+        (*client)->pendingEvents++;
+        mThreadPool.Post(&EpollServerT::HandleWriteEvent, this, client);
+    }
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleReadEvent(CONTEXT_PTR* client)
+{
+    int clientFd = (*client)->fd;
+
+    // Zero-copy completions are signaled with EPOLLERR: collect them, and
+    // read only if there is data too
+    if((*client)->outQueue.InFlight())
+    {
+        if(!FlushOutput(*client))
+        {
+            CleanupClient(clientFd);
+            return;
+        }
+
+        if(!gen::IsReadable(clientFd))
+        {
+            bool rearmed = false;
+            {
+                std::lock_guard<std::mutex> lock(mClientContextsMutex);
+                if((rearmed = ArmClient(clientFd, ClientEvents(*client), client, false)))
+                    (*client)->pendingEvents--;
+            }
+
+            // Note: The client must not be accessed after this point
+            if(!rearmed)
+            {
+                OnError(__FNAME__, __LINE__, "Error re-arming epoll for fd " + std::to_string(clientFd) + ".");
+                CleanupClient(clientFd);
+            }
+            return;
+        }
     }
 
-    if(!OnRead(client))
+    if(!Derived()->OnRead(*client))
     {
         CleanupClient(clientFd);
         return;
     }
 
-    UpdateActivityTime(clientFd);
+    (*client)->lastActivityTime = std::chrono::steady_clock::now();
+    (*client)->writeDue = true;
+
+    // Immediately modify epoll to listen for EPOLLOUT.
+    // Note: Once re-armed, the next event may be handled (and the client closed)
+    // by another thread, so release the client under the contexts lock.
+    bool rearmed = false;
+    {
+        std::lock_guard<std::mutex> lock(mClientContextsMutex);
+        if((rearmed = ArmClient(clientFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, client, false)))
+            (*client)->pendingEvents--;
+    }
 
-    // Immediately modify epoll to listen for EPOLLOUT
-    if(!EpollMod(clientFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLONESHOT))
+    // Note: The client must not be accessed after this point
+    if(!rearmed)
     {
         std::stringstream ss;
         ss << "Error modifying epoll for fd " << clientFd << " to include EPOLLOUT.";
@@ -438,27 +1176,42 @@ inline void EpollServer::HandleReadEvent(int clientFd)
     }
 }
 
-inline void EpollServer::HandleWriteEvent(int clientFd)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleWriteEvent(CONTEXT_PTR* client)
 {
-    std::shared_ptr<ClientContext> client = GetClientContext(clientFd);
-    if(!client)
+    int clientFd = (*client)->fd;
+
+    // Queue the reply (unless the event is for the rest of the previous one) and write it out
+    if((*client)->writeDue)
     {
-        std::stringstream ss;
-        ss << "Client context not found for fd " << clientFd << " in read event.";
-        OnError(__FNAME__, __LINE__, ss.str());
-        return;
+        if(!Derived()->OnWrite(*client))
+        {
+            CleanupClient(clientFd);
+            return;
+        }
+        (*client)->writeDue = false;
     }
 
-    if(!OnWrite(client))
+    if(!FlushOutput(*client))
     {
         CleanupClient(clientFd);
         return;
     }
 
-    UpdateActivityTime(clientFd);
+    (*client)->lastActivityTime = std::chrono::steady_clock::now();
 
-    // Immediately modify epoll to listen for EPOLLIN again
-    if(!EpollMod(clientFd, EPOLLIN | EPOLLRDHUP | EPOLLONESHOT))
+    // Immediately modify epoll to listen for EPOLLIN again (and EPOLLOUT if the reply is not written out).
+    // Note: Once re-armed, the next event may be handled (and the client closed)
+    // by another thread, so release the client under the contexts lock.
+    bool rearmed = false;
+    {
+        std::lock_guard<std::mutex> lock(mClientContextsMutex);
+        if((rearmed = ArmClient(clientFd, ClientEvents(*client), client, false)))
+            (*client)->pendingEvents--;
+    }
+
+    // Note: The client must not be accessed after this point
+    if(!rearmed)
     {
         std::stringstream ss;
         ss << "Error modifying epoll for fd " << clientFd << " back to EPOLLIN.";
@@ -467,8 +1220,141 @@ inline void EpollServer::HandleWriteEvent(int clientFd)
     }
 }
 
-inline void EpollServer::CleanupClient(int clientFd)
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::HandleReadWriteEvent(CONTEXT_PTR* client)
+{
+    int clientFd = (*client)->fd;
+    int events = (*client)->pendingEvents;
+    OutputQueue& outQueue = (*client)->outQueue;
+
+    // Note: An edge-triggered event may be stale (retrieved before the previous
+    // call was handled), or be for writing only, and OnRead() would block on a
+    // socket with no data
+    bool readable = ((!mPersistentEpoll && outQueue.Empty() && !outQueue.InFlight()) || gen::IsReadable(clientFd));
+
+    for(;;)
+    {
+        // Write out the rest of the previous replies first (and collect the zero-copy completions)
+        if((!outQueue.Empty() || outQueue.InFlight()) && !FlushOutput(*client))
+        {
+            CleanupClient(clientFd);
+            return;
+        }
+
+        // Write the reply right away: the socket is almost always writable.
+        // Backpressure: don't read while too much output is waiting.
+        if(readable && outQueue.Size() < mOutputHighWaterMark)
+        {
+            if(!Derived()->OnRead(*client) || !Derived()->OnWrite(*client) || !FlushOutput(*client))
+            {
+                CleanupClient(clientFd);
+                return;
+            }
+
+            (*client)->lastActivityTime = std::chrono::steady_clock::now();
+
+            // Edge-triggered: the next request may be in already (sent without
+            // waiting for the reply), and no other event would come for it
+            if(mPersistentEpoll && (readable = gen::IsReadable(clientFd)))
+                continue;
+        }
+
+        if(!mPersistentEpoll)
+        {
+            // io_uring: release the client and re-arm the one-shot poll.
+            // Note: Released first, since the next event is dispatched as soon as
+            // the poll is re-armed. Nothing else refers to the client meanwhile.
+            uint32_t clientEvents = ClientEvents(*client);
+            (*client)->pendingEvents--;
+            if(!ArmClient(clientFd, clientEvents, client, false))
+            {
+                OnError(__FNAME__, __LINE__, "Error re-arming poll for fd " + std::to_string(clientFd) + ".");
+                CleanupClient(clientFd);
+            }
+            return;
+        }
+
+        // Register EPOLLOUT only while there is output waiting.
+        // Note: EPOLLIN stays registered, its events are ignored while reading is stopped.
+        if(outQueue.Empty() == (*client)->writeArmed)
+        {
+            (*client)->writeArmed = !outQueue.Empty();
+            if(!EpollMod(clientFd, EPOLLIN | EPOLLRDHUP | EPOLLET | ((*client)->writeArmed ? static_cast<uint32_t>(EPOLLOUT) : 0u), client))
+            {
+                OnError(__FNAME__, __LINE__, "Error modifying epoll for fd " + std::to_string(clientFd) + ".");
+                CleanupClient(clientFd);
+                return;
+            }
+        }
+
+        // Release the client, unless more events were signaled meanwhile.
+        // Note: The client must not be accessed once released.
+        if((*client)->pendingEvents.fetch_sub(events) == events)
+            return;
+        events = (*client)->pendingEvents;
+
+        // The data of the new events may have been read already
+        readable = gen::IsReadable(clientFd);
+    }
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline bool EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::FlushOutput(CONTEXT_PTR& client)
 {
+    std::string errMsg;
+    if(client->outQueue.Flush(client->fd, errMsg))
+        return true;
+
+    if(errno == ECONNRESET)
+    {
+        if(mVerbose)
+            OnInfo(__FNAME__, __LINE__, "Connection " + std::to_string(client->connectionId) + " closed by peer.");
+    }
+    else
+    {
+        OnError(__FNAME__, __LINE__, "Failed to send to connection " + std::to_string(client->connectionId) + ": " + errMsg);
+    }
+    return false;
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline uint32_t EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::ClientEvents(CONTEXT_PTR& client) const
+{
+    // Wait for writability while output is waiting (or a reply is to be queued),
+    // and stop reading above the high-water mark
+    const OutputQueue& outQueue = client->outQueue;
+    return ((outQueue.Empty() && !client->writeDue ? 0u : static_cast<uint32_t>(EPOLLOUT)) |
+            (outQueue.Size() < mOutputHighWaterMark ? static_cast<uint32_t>(EPOLLIN | EPOLLRDHUP) : 0u));
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::ReleaseClosedClients()
+{
+    std::vector<int> closedClients;
+    {
+        std::lock_guard<std::mutex> lock(mClientContextsMutex);
+        if(mClosedClients.empty())
+            return;
+        closedClients.swap(mClosedClients);
+        for(int fd : closedClients)
+            mClientContexts.erase(fd);
+    }
+
+    // Note: The descriptors are closed last, so they are not reused by new connections before
+    for(int fd : closedClients)
+        close(fd);
+}
+
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::CleanupClient(int clientFd)
+{
+    // Remove from epoll first, so no more events refer to the client context.
+    // Note: With io_uring, there is no poll in flight for the client at this point.
+    if(mEpollFd != -1 && !EpollDel(clientFd))
+    {
+        OnError(__FNAME__, __LINE__, "Error removing fd " + std::to_string(clientFd) + " from epoll.");
+    }
+
     {
         std::unique_lock<std::mutex> lock(mClientContextsMutex);
         auto it = mClientContexts.find(clientFd);
@@ -482,37 +1368,63 @@ inline void EpollServer::CleanupClient(int clientFd)
         }
         else
         {
-            std::shared_ptr<ClientContext> client = it->second;
-
             if(mVerbose)
             {
                 std::stringstream ss;
-                ss << "Closing connection " << client->connectionId  << " (fd " << clientFd << ").";
+                ss << "Closing connection " << it->second->connectionId  << " (fd " << clientFd << ").";
                 OnInfo(__FNAME__, __LINE__, ss.str());
             }
 
-            mClientContexts.erase(clientFd);
-        }
-    }
+            // Persistent registration: the main loop may still hold an event for the client
+            if(mPersistentEpoll)
+            {
+                mClosedClients.push_back(clientFd);
+                return;
+            }
 
-    if(!EpollDel(clientFd))
-    {
-        OnError(__FNAME__, __LINE__, "Error removing fd " + std::to_string(clientFd) + " from epoll.");
+            mClientContexts.erase(it);
+        }
     }
 
     close(clientFd);
 }
 
-inline void EpollServer::OnError(const char* fname, int lineNum, const std::string& err) const
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::OnError(const char* fname, int lineNum, const std::string& err) const
 {
     std::cerr << "Error: " << fname << ":" << lineNum << " " << err << std::endl;
 }
 
-inline void EpollServer::OnInfo(const char* fname, int lineNum, const std::string& info) const
+template<class DERIVED, class CONTEXT, class CONTEXT_PTR>
+inline void EpollServerT<DERIVED, CONTEXT, CONTEXT_PTR>::OnInfo(const char* fname, int lineNum, const std::string& info) const
 {
     std::cout << "Info: " << fname << ":" << lineNum << " " << info << std::endl;
 }
 
+//
+// EpollServer is the virtual (runtime polymorphic) flavor of EpollServerT.
+// It's a thin adapter for servers that prefer virtual callbacks
+// and shared_ptr contexts.
+//
+class EpollServer : public EpollServerT<EpollServer, EpollClientContext, std::shared_ptr<EpollClientContext>>
+{
+public:
+    EpollServer(unsigned int threadsCount, EventBackend backend = EventBackend::EPOLL) :
+        EpollServerT(threadsCount, backend) {}
+    virtual ~EpollServer() = default;
+
+protected:
+    using ClientContext = EpollClientContext;
+
+    // For derived class to override
+    virtual bool OnRead(std::shared_ptr<ClientContext>& client) = 0;
+    virtual bool OnWrite(std::shared_ptr<ClientContext>& client) = 0;
+    virtual std::shared_ptr<ClientContext> MakeClientContext() = 0;
+
+private:
+    friend class EpollServerT<EpollServer, EpollClientContext, std::shared_ptr<EpollClientContext>>;
+};
+
 } // namespace gen
 
 #endif // __EPOLL_SERVER_HPP__
@@ -0,0 +1,364 @@
+//
+// ioUring.hpp
+//
+// Minimal io_uring wrapper over the raw syscalls (no liburing dependency),
+// used by the io_uring event backend of EpollServerT.
+//
+// The submission queue is multi-producer: any thread may queue requests
+// (under a mutex) without a syscall. The single thread that waits for
+// completions submits all the queued requests in the same io_uring_enter()
+// call. A thread queueing a request while the waiter is blocked in the
+// kernel submits it by itself (the waiter doesn't need to be woken up).
+//
+#ifndef __IO_URING_HPP__
+#define __IO_URING_HPP__
+
+#include <unistd.h>
+#include <sys/mman.h>       // mmap()
+#include <sys/syscall.h>    // __NR_io_uring_setup, __NR_io_uring_enter
+#include <linux/io_uring.h>
+#include <linux/time_types.h>   // __kernel_timespec
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <algorithm>    // std::max()
+
+namespace gen {
+
+const unsigned int IO_URING_DEFAULT_ENTRIES = 256;  // Submission queue size
+
+class IoUring
+{
+public:
+    IoUring() = default;
+    ~IoUring() { Close(); }
+
+    // Note: cqEntries is the completion queue size: it should hold the
+    // completions of all requests in flight (e.g. one poll per connection)
+    bool Init(unsigned int sqEntries, unsigned int cqEntries, std::string& errMsg);
+    void Close();
+    bool IsOpen() const { return (mFd != -1); }
+
+    // Queue requests (thread-safe). Return false if the submission queue is full
+    // and couldn't be flushed. Note: EPOLL* event flags are the same as POLL* ones.
+    bool PollAdd(int fd, uint32_t events, uint64_t userData, const __kernel_timespec* linkTimeout = nullptr);
+    bool PollRemove(uint64_t targetUserData);
+    bool Accept(int fd, bool multishot, uint64_t userData);
+    bool Cancel(uint64_t targetUserData);
+
+    // Submit the queued requests and wait (up to timeoutMs) for at least one
+    // completion, then call func(userData, res, flags) for each completion.
+    // Must be called by one thread only. Returns the number of completions or -1.
+    template<class FUNC>
+    int Run(long timeoutMs, FUNC&& func, std::string& errMsg);
+
+    // Link timeout completions and the completions of PollRemove()/Cancel() requests
+    static const uint64_t IGNORED_USER_DATA = 0;
+
+private:
+    // Note: mSqMutex must be locked
+    bool Reserve(unsigned int count);
+    struct io_uring_sqe* GetSqe(unsigned int index);
+    void Publish(unsigned int count);
+    int Enter(unsigned int toSubmit, unsigned int minComplete, unsigned int flags, void* arg, size_t argSize);
+
+    // No copy constructors
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+private:
+    int mFd{-1};
+    void* mSqRing{MAP_FAILED};
+    void* mCqRing{MAP_FAILED};
+    size_t mSqRingSize{0};
+    size_t mCqRingSize{0};
+    struct io_uring_sqe* mSqes{nullptr};
+    size_t mSqesSize{0};
+
+    // Submission queue: written by the producers (under mSqMutex), consumed by the kernel
+    unsigned int* mSqHead{nullptr};
+    unsigned int* mSqTail{nullptr};
+    unsigned int mSqMask{0};
+    unsigned int mSqEntries{0};
+    unsigned int* mSqArray{nullptr};
+
+    // Completion queue: written by the kernel, consumed by the Run() thread
+    unsigned int* mCqHead{nullptr};
+    unsigned int* mCqTail{nullptr};
+    unsigned int mCqMask{0};
+    struct io_uring_cqe* mCqes{nullptr};
+
+    std::mutex mSqMutex;
+    bool mWaiting{false};           // The Run() thread is (about to be) blocked in the kernel
+};
+
+inline bool IoUring::Init(unsigned int sqEntries, unsigned int cqEntries, std::string& errMsg)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = std::max(cqEntries, 2 * sqEntries);
+
+    mFd = static_cast<int>(syscall(__NR_io_uring_setup, sqEntries, &params));
+    if(mFd == -1)
+    {
+        errMsg = "io_uring_setup() failed: " + std::string(strerror(errno));
+        return false;
+    }
+
+    // Run() waits with a timeout argument (Linux 5.11)
+    if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        errMsg = "io_uring is too old: IORING_FEAT_EXT_ARG and IORING_FEAT_NODROP are required";
+        Close();
+        return false;
+    }
+
+    // Map the rings (one mapping for both with IORING_FEAT_SINGLE_MMAP)
+    mSqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    mCqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+        mSqRingSize = mCqRingSize = std::max(mSqRingSize, mCqRingSize);
+
+    mSqRing = mmap(nullptr, mSqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQ_RING);
+    if(mSqRing != MAP_FAILED)
+    {
+        mCqRing = (params.features & IORING_FEAT_SINGLE_MMAP ? mSqRing :
+                   mmap(nullptr, mCqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_CQ_RING));
+    }
+
+    mSqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = MAP_FAILED;
+    if(mCqRing != MAP_FAILED)
+        sqes = mmap(nullptr, mSqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, IORING_OFF_SQES);
+
+    if(sqes == MAP_FAILED)
+    {
+        errMsg = "mmap() failed for io_uring: " + std::string(strerror(errno));
+        Close();
+        return false;
+    }
+    mSqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(mSqRing);
+    mSqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    mSqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    mSqMask = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    mSqEntries = *reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_entries);
+    mSqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+
+    char* cq = static_cast<char*>(mCqRing);
+    mCqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    mCqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    mCqMask = *reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    mCqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    return true;
+}
+
+inline void IoUring::Close()
+{
+    // Note: Closing the ring cancels all the requests in flight
+    if(mSqes != nullptr)
+    {
+        munmap(mSqes, mSqesSize);
+        mSqes = nullptr;
+    }
+
+    if(mCqRing != MAP_FAILED && mCqRing != mSqRing)
+        munmap(mCqRing, mCqRingSize);
+    mCqRing = MAP_FAILED;
+
+    if(mSqRing != MAP_FAILED)
+    {
+        munmap(mSqRing, mSqRingSize);
+        mSqRing = MAP_FAILED;
+    }
+
+    if(mFd != -1)
+    {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+inline bool IoUring::Reserve(unsigned int count)
+{
+    if(mFd == -1)
+        return false;
+
+    unsigned int tail = *mSqTail;
+    if(tail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) + count <= mSqEntries)
+        return true;
+
+    // Full: flush the queue ourselves
+    return (Enter(tail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE), 0, 0, nullptr, 0) >= 0 &&
+            tail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE) + count <= mSqEntries);
+}
+
+inline struct io_uring_sqe* IoUring::GetSqe(unsigned int index)
+{
+    struct io_uring_sqe* sqe = &mSqes[index & mSqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    mSqArray[index & mSqMask] = index & mSqMask;
+    return sqe;
+}
+
+inline void IoUring::Publish(unsigned int count)
+{
+    // Note: The tail is published right away: the kernel consumes the queued
+    // entries on the next io_uring_enter() by any thread
+    __atomic_store_n(mSqTail, *mSqTail + count, __ATOMIC_RELEASE);
+
+    // The Run() thread is blocked (or about to be, with its submission count already taken):
+    // submit the queued requests now. Otherwise, they are submitted by its next Run().
+    if(mWaiting)
+        Enter(*mSqTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE), 0, 0, nullptr, 0);
+}
+
+inline bool IoUring::PollAdd(int fd, uint32_t events, uint64_t userData, const __kernel_timespec* linkTimeout)
+{
+    std::lock_guard<std::mutex> lock(mSqMutex);
+
+    unsigned int count = (linkTimeout != nullptr ? 2 : 1);
+    if(!Reserve(count))
+        return false;
+
+    unsigned int tail = *mSqTail;
+    struct io_uring_sqe* sqe = GetSqe(tail);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = userData;
+
+    if(linkTimeout != nullptr)
+    {
+        // The poll is cancelled (-ECANCELED) if nothing happens before the timeout.
+        // Note: Both entries are published at once, so a submission never splits the link.
+        sqe->flags = IOSQE_IO_LINK;
+        struct io_uring_sqe* timeoutSqe = GetSqe(tail + 1);
+        timeoutSqe->opcode = IORING_OP_LINK_TIMEOUT;
+        timeoutSqe->fd = -1;
+        timeoutSqe->addr = reinterpret_cast<uint64_t>(linkTimeout);
+        timeoutSqe->len = 1;
+        timeoutSqe->user_data = IGNORED_USER_DATA;
+    }
+
+    Publish(count);
+    return true;
+}
+
+inline bool IoUring::PollRemove(uint64_t targetUserData)
+{
+    std::lock_guard<std::mutex> lock(mSqMutex);
+    if(!Reserve(1))
+        return false;
+
+    struct io_uring_sqe* sqe = GetSqe(*mSqTail);
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = targetUserData;
+    sqe->user_data = IGNORED_USER_DATA;
+    Publish(1);
+    return true;
+}
+
+inline bool IoUring::Accept(int fd, bool multishot, uint64_t userData)
+{
+    std::lock_guard<std::mutex> lock(mSqMutex);
+    if(!Reserve(1))
+        return false;
+
+    // Note: The kernel waits for connections exclusively, so only one of the
+    // rings sharing the listening socket (pre-fork mode) is woken up per connection
+    struct io_uring_sqe* sqe = GetSqe(*mSqTail);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = (multishot ? IORING_ACCEPT_MULTISHOT : 0);
+    sqe->user_data = userData;
+    Publish(1);
+    return true;
+}
+
+inline bool IoUring::Cancel(uint64_t targetUserData)
+{
+    std::lock_guard<std::mutex> lock(mSqMutex);
+    if(!Reserve(1))
+        return false;
+
+    struct io_uring_sqe* sqe = GetSqe(*mSqTail);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = targetUserData;
+    sqe->user_data = IGNORED_USER_DATA;
+    Publish(1);
+    return true;
+}
+
+inline int IoUring::Enter(unsigned int toSubmit, unsigned int minComplete, unsigned int flags, void* arg, size_t argSize)
+{
+    int res = 0;
+    do
+    {
+        res = static_cast<int>(syscall(__NR_io_uring_enter, mFd, toSubmit, minComplete, flags, arg, argSize));
+    } while(res == -1 && errno == EINTR);
+    return res;
+}
+
+template<class FUNC>
+inline int IoUring::Run(long timeoutMs, FUNC&& func, std::string& errMsg)
+{
+    // Submit everything queued so far and block, unless there are completions already
+    unsigned int toSubmit = 0;
+    {
+        std::lock_guard<std::mutex> lock(mSqMutex);
+        toSubmit = *mSqTail - __atomic_load_n(mSqHead, __ATOMIC_ACQUIRE);
+        mWaiting = (*mCqHead == __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE));
+    }
+
+    struct __kernel_timespec ts = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000};
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+    int res = Enter(toSubmit, (mWaiting ? 1 : 0), IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    {
+        std::lock_guard<std::mutex> lock(mSqMutex);
+        mWaiting = false;
+    }
+
+    // Note: EBUSY means completions overflowed: reap them and retry the submission
+    if(res == -1 && errno != ETIME && errno != EBUSY)
+    {
+        errMsg = "io_uring_enter() failed: " + std::string(strerror(errno));
+        return -1;
+    }
+
+    // Reap the completions
+    int count = 0;
+    unsigned int head = *mCqHead;
+    unsigned int tail = __atomic_load_n(mCqTail, __ATOMIC_ACQUIRE);
+    for(; head != tail; head++)
+    {
+        const struct io_uring_cqe& cqe = mCqes[head & mCqMask];
+        uint64_t userData = cqe.user_data;
+        int cqeRes = cqe.res;
+        uint32_t cqeFlags = cqe.flags;
+
+        // Release the entry before the callback: it may queue new requests
+        __atomic_store_n(mCqHead, head + 1, __ATOMIC_RELEASE);
+
+        if(userData != IGNORED_USER_DATA)
+        {
+            func(userData, cqeRes, cqeFlags);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+} // namespace gen
+
+#endif // __IO_URING_HPP__
@@ -0,0 +1,301 @@
+//
+// metadataTable.hpp
+//
+#ifndef __METADATA_TABLE_HPP__
+#define __METADATA_TABLE_HPP__
+
+#include <deque>
+#include <map>
+#include <string>
+#include <cstring>  // std::memcmp
+#include <cstdint>
+
+namespace gen {
+
+//
+// Connection metadata table, modeled on HPACK's dynamic table (RFC 7541): the
+// client and the server keep the same table of the key-value pairs sent on the
+// connection, so a pair sent before is referenced by its index afterwards.
+//
+// A metadata block is a sequence of:
+//   1xxxxxxx                      The entry at index x (7-bit prefix integer, 1: the newest)
+//   01xxxxxx [key] value          A pair added to the table. x is the index of an entry
+//                                 with the same key, or 0 if the key literal follows.
+//   00xxxxxx [key] value          The same, not added to the table
+// Literals are a length (7-bit prefix integer) and the bytes. Integers are HPACK
+// prefix integers: the prefix bits, then 7 bits per byte if they overflow.
+//
+const size_t DEFAULT_METADATA_TABLE_SIZE = 4096;        // Bytes, as HPACK's default
+const size_t DEFAULT_MAX_METADATA_TABLE_SIZE = 64 * 1024;
+const size_t METADATA_ENTRY_OVERHEAD = 32;              // Per entry, as in HPACK
+
+namespace metadata {
+
+const uint8_t INDEXED = 0x80;
+const uint8_t LITERAL_INDEXED = 0x40;
+const uint8_t LITERAL = 0x00;
+
+inline void PutInteger(std::string& out, uint8_t flags, int prefixBits, uint64_t value)
+{
+    uint64_t max = (1u << prefixBits) - 1;
+    if(value < max)
+    {
+        out.push_back(static_cast<char>(flags | value));
+        return;
+    }
+
+    out.push_back(static_cast<char>(flags | max));
+    for(value -= max; value >= 128; value >>= 7)
+        out.push_back(static_cast<char>((value & 127) | 128));
+    out.push_back(static_cast<char>(value));
+}
+
+inline bool GetInteger(const uint8_t*& p, const uint8_t* end, int prefixBits, uint64_t& value)
+{
+    uint64_t max = (1u << prefixBits) - 1;
+    value = *p++ & max;
+    if(value < max)
+        return true;
+
+    for(int shift = 0; shift < 56; shift += 7)
+    {
+        if(p == end)
+            return false;
+        uint8_t b = *p++;
+        value += static_cast<uint64_t>(b & 127) << shift;
+        if(!(b & 128))
+            return true;
+    }
+    return false;
+}
+
+inline void PutString(std::string& out, const std::string& str)
+{
+    PutInteger(out, 0, 7, str.size());
+    out.append(str);
+}
+
+inline bool GetString(const uint8_t*& p, const uint8_t* end, std::string& str)
+{
+    uint64_t len = 0;
+    if(p == end || !GetInteger(p, end, 7, len) || len > static_cast<uint64_t>(end - p))
+        return false;
+    str.assign(reinterpret_cast<const char*>(p), len);
+    p += len;
+    return true;
+}
+
+} // namespace metadata
+
+//
+// The table itself: the same on both sides, as the same blocks go through it
+//
+class MetadataTable
+{
+public:
+    explicit MetadataTable(size_t maxSize) : mMaxSize(maxSize) {}
+
+    struct Entry
+    {
+        std::string key;
+        std::string value;
+        uint64_t seq;       // Insertion number
+    };
+
+    static size_t EntrySize(const std::string& key, const std::string& value)
+    {
+        return key.size() + value.size() + METADATA_ENTRY_OVERHEAD;
+    }
+
+    // Add the pair as the newest entry (index 1), evicting the oldest ones to
+    // make room. A pair larger than the table empties it and is not added.
+    void Add(const std::string& key, const std::string& value)
+    {
+        size_t size = EntrySize(key, value);
+        while(!mEntries.empty() && mSize + size > mMaxSize)
+        {
+            mSize -= EntrySize(mEntries.back().key, mEntries.back().value);
+            mEntries.pop_back();
+        }
+
+        mInserted++;
+        if(size <= mMaxSize)
+        {
+            mEntries.push_front(Entry{key, value, mInserted});
+            mSize += size;
+        }
+    }
+
+    // The entry at index (1: the newest), nullptr if there's none
+    const Entry* Get(uint64_t index) const
+    {
+        return (index >= 1 && index <= mEntries.size() ? &mEntries[index - 1] : nullptr);
+    }
+
+    // The index of the entry inserted as seq, 0 if it's evicted already
+    uint64_t IndexOf(uint64_t seq) const
+    {
+        uint64_t index = mInserted - seq + 1;
+        return (seq <= mInserted && index <= mEntries.size() ? index : 0);
+    }
+
+    size_t Count() const { return mEntries.size(); }
+    size_t MaxSize() const { return mMaxSize; }
+    uint64_t Inserted() const { return mInserted; }
+
+private:
+    std::deque<Entry> mEntries;     // The newest first
+    size_t mSize{0};
+    size_t mMaxSize;
+    uint64_t mInserted{0};
+};
+
+//
+// Client side: encode the metadata of each call. A pair is added to the table
+// the second time in a row it's sent: values that change with every call (such
+// as request ids) don't push the steady ones out of the table.
+//
+class MetadataEncoder
+{
+public:
+    explicit MetadataEncoder(size_t tableSize) : mTable(tableSize) {}
+
+    std::string Encode(const std::map<std::string, std::string>& metadata)
+    {
+        using namespace gen::metadata;
+
+        std::string out;
+        for(const auto& [key, value] : metadata)
+        {
+            // Sent before: its index only
+            auto itr = mEntries.find(std::make_pair(key, value));
+            if(uint64_t index = (itr != mEntries.end() ? mTable.IndexOf(itr->second) : 0))
+            {
+                PutInteger(out, INDEXED, 7, index);
+                continue;
+            }
+
+            // Add the pair to the table if it's the same as the last time, and if it fits
+            auto lastItr = mLastValues.find(key);
+            bool add = (lastItr != mLastValues.end() && lastItr->second == value &&
+                        MetadataTable::EntrySize(key, value) <= mTable.MaxSize());
+
+            auto keyItr = mKeys.find(key);
+            uint64_t keyIndex = (keyItr != mKeys.end() ? mTable.IndexOf(keyItr->second) : 0);
+            PutInteger(out, (add ? LITERAL_INDEXED : LITERAL), 6, keyIndex);
+            if(keyIndex == 0)
+                PutString(out, key);
+            PutString(out, value);
+
+            if(add)
+            {
+                mTable.Add(key, value);
+                mEntries[std::make_pair(key, value)] = mTable.Inserted();
+                mKeys[key] = mTable.Inserted();
+                mLastValues.erase(lastItr);
+            }
+            else
+            {
+                if(mLastValues.size() >= MAX_LAST_VALUES)
+                    mLastValues.clear();
+                mLastValues[key] = value;
+            }
+        }
+
+        // Forget the evicted entries once they are most of the lookups
+        if(mEntries.size() > 2 * mTable.Count() + 64)
+            Prune();
+        return out;
+    }
+
+private:
+    void Prune()
+    {
+        for(auto itr = mEntries.begin(); itr != mEntries.end(); )
+            itr = (mTable.IndexOf(itr->second) ? std::next(itr) : mEntries.erase(itr));
+        for(auto itr = mKeys.begin(); itr != mKeys.end(); )
+            itr = (mTable.IndexOf(itr->second) ? std::next(itr) : mKeys.erase(itr));
+    }
+
+    static const size_t MAX_LAST_VALUES = 256;
+
+    MetadataTable mTable;
+    std::map<std::pair<std::string, std::string>, uint64_t> mEntries;  // Pair -> insertion number
+    std::map<std::string, uint64_t> mKeys;                             // Key -> its latest insertion number
+    std::map<std::string, std::string> mLastValues;                    // Key -> the value sent last, not in the table
+};
+
+//
+// Server side: decode the metadata of each call. A block of indexes only, the
+// same as the last one, is not decoded again: the calls that send the same
+// metadata every time parse nothing once it's in the table.
+//
+class MetadataDecoder
+{
+public:
+    explicit MetadataDecoder(size_t tableSize) : mTable(tableSize) {}
+
+    bool Decode(const char* data, size_t size, std::string& errMsg)
+    {
+        using namespace gen::metadata;
+
+        if(mLastIndexedOnly && size == mLastBlock.size() && memcmp(data, mLastBlock.data(), size) == 0)
+            return true;
+
+        mMetadata.clear();
+        mLastIndexedOnly = true;
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        const uint8_t* end = p + size;
+        while(p < end)
+        {
+            uint8_t type = *p;
+            uint64_t index = 0;
+            if(type & INDEXED)
+            {
+                const MetadataTable::Entry* entry = nullptr;
+                if(!GetInteger(p, end, 7, index) || !(entry = mTable.Get(index)))
+                    return Fail("Invalid metadata table index " + std::to_string(index), errMsg);
+                mMetadata[entry->key] = entry->value;
+                continue;
+            }
+
+            std::string key, value;
+            const MetadataTable::Entry* entry = nullptr;
+            if(!GetInteger(p, end, 6, index) ||
+               (index != 0 && !(entry = mTable.Get(index))) ||
+               (index == 0 && !GetString(p, end, key)) ||
+               !GetString(p, end, value))
+                return Fail("Invalid metadata block", errMsg);
+            if(entry)
+                key = entry->key;
+
+            if(type & LITERAL_INDEXED)
+                mTable.Add(key, value);
+            mMetadata[std::move(key)] = std::move(value);
+            mLastIndexedOnly = false;
+        }
+
+        mLastBlock.assign(data, size);
+        return true;
+    }
+
+    // The metadata decoded last
+    const std::map<std::string, std::string>& Metadata() const { return mMetadata; }
+
+private:
+    bool Fail(const std::string& err, std::string& errMsg)
+    {
+        errMsg = err;
+        mLastIndexedOnly = false;
+        return false;
+    }
+
+    MetadataTable mTable;
+    std::map<std::string, std::string> mMetadata;
+    std::string mLastBlock;
+    bool mLastIndexedOnly{false};
+};
+
+} // namespace gen
+
+#endif // __METADATA_TABLE_HPP__
@@ -9,11 +9,30 @@
 #include <string.h>         // strerror()
 #include <sys/un.h>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <mutex>            // std::call_once()
+#include <pthread.h>        // pthread_atfork()
 #include <google/protobuf/message.h>
 #include "protoCommon.hpp"
+#include "shmCommon.hpp"
 
 namespace gen {
 
+// Fork generation of the process: incremented in the child after every fork(),
+// so the clients made before can tell without a getpid() syscall per call
+inline std::atomic<uint32_t> gForkGeneration{0};
+
+inline void RegisterForkGeneration()
+{
+    static std::once_flag atforkFlag;
+    std::call_once(atforkFlag, []()
+    {
+        pthread_atfork(nullptr, nullptr, []() { gForkGeneration.fetch_add(1, std::memory_order_relaxed); });
+    });
+}
+
 class ProtoClient
 {
 public:
@@ -22,10 +41,54 @@ public:
     ProtoClient(const char* host, unsigned short port) { Init(host, port, mErrMsg); }
     ~ProtoClient();
 
-    bool Init(const char* domainSocketPath, std::string& errMsg);
+    // Note: After fork(), the first call in the child process reconnects
+    // to the server, so parent and child don't share the same connection.
+    // Note: seqPacket selects SOCK_SEQPACKET: each request and response is sent
+    // as one record (the server must be started with SetSeqPacket(true))
+    bool Init(const char* domainSocketPath, std::string& errMsg, bool seqPacket = false);
     bool Init(const char* host, unsigned short port, std::string& errMsg);
     bool IsValid() { return (mSocket > 0); }
 
+    // Unix domain sockets: requests of at least threshold bytes are passed
+    // in a sealed memfd instead of being copied through the socket
+    void SetFdPayloadThreshold(size_t threshold) { mFdPayloadThreshold = threshold; }
+
+    // Switch the (Unix domain socket) connection to the shared memory transport:
+    // requests and responses go through a pair of ring buffers of ringSize bytes
+    // each. The server must enable it with ProtoServer::SetShmTransport().
+    bool InitShm(std::string& errMsg, size_t ringSize = SHM_DEFAULT_RING_SIZE);
+
+    // Switch the connection to compressed messages: requests and responses of at
+    // least threshold bytes are compressed with codec. The server must enable the
+    // codec with ProtoServer::EnableCompression(). Meant for TCP connections:
+    // Unix domain sockets and shared memory are faster uncompressed.
+    bool InitCompression(Codec codec, std::string& errMsg, size_t threshold = DEFAULT_COMPRESSION_THRESHOLD);
+
+    // Compress the requests of a method with codec instead of the connection's
+    // codec (Codec::NONE: never compress them)
+    void SetMethodCompression(uint32_t methodId, Codec codec) { mMethodCodecs[methodId] = codec; }
+
+    // Compressed responses are accepted once the connection is switched to
+    // compression, up to this size decompressed
+    void SetMaxDecompressedSize(size_t bytes) { mMaxDecompressedSize = bytes; }
+
+    // Send the requests with a CRC32C, and have the server send the responses with
+    // one: a corrupted message fails the call and closes the connection. The server
+    // must enable it with ProtoServer::SetChecksums(). Not used over shared memory.
+    bool InitChecksums(std::string& errMsg);
+
+    // Send the metadata of the calls through a table of the key-value pairs sent
+    // on the connection, as HPACK does: a pair sent before goes as its index, and
+    // the server doesn't parse again the same metadata as the previous call's.
+    // The server limits tableSize with ProtoServer::SetMaxMetadataTableSize().
+    // Note: Call before InitShm().
+    bool InitMetadataTable(std::string& errMsg, size_t tableSize = DEFAULT_METADATA_TABLE_SIZE);
+
+    // Metadata sent once for all the calls of the connection (session id, client
+    // version, ...): Context::GetMetadata() finds it unless the call's metadata
+    // has the same key. Note: Call before InitShm().
+    bool SetConnectionMetadata(const std::map<std::string, std::string>& metadata, std::string& errMsg);
+
     // Call with metadata
     bool Call(const google::protobuf::Message& req,
               google::protobuf::Message& resp,
@@ -39,9 +102,226 @@ public:
               std::string& errMsg,
               long timeoutMs = 5000);
 
+    // Call by method id (see gen::MethodId()) with metadata.
+    // Used by the client stubs generated with protoc-gen-protorpc.
+    bool Call(uint32_t methodId,
+              const google::protobuf::Message& req,
+              google::protobuf::Message& resp,
+              const std::map<std::string, std::string>& metadata,
+              std::string& errMsg,
+              long timeoutMs = 5000);
+
+    // Call by method id, receiving the file attached to the response
+    // (see ProtoServer::Context::AttachFile()) into the buffer or the file
+    // of attachment. Note: timeoutMs covers the whole transfer.
+    bool Call(uint32_t methodId,
+              const google::protobuf::Message& req,
+              google::protobuf::Message& resp,
+              const std::map<std::string, std::string>& metadata,
+              ProtoAttachment& attachment,
+              std::string& errMsg,
+              long timeoutMs = 5000);
+
+    // Call with the request serialized already, keeping the response serialized
+    // (e.g. to forward the messages, see ProtoProxy): by method id, or by request
+    // type name if methodId is 0. Memfd payloads are passed on as they are over
+    // Unix domain sockets.
+    bool CallRaw(uint32_t methodId,
+                 const std::string& reqName,
+                 const ProtoPayload& reqData,
+                 ProtoPayload& respData,
+                 const std::map<std::string, std::string>& metadata,
+                 std::string& errMsg,
+                 long timeoutMs = 5000);
+
+    // Call a server-streaming method by method id: each message of the stream
+    // is parsed into resp and onMessage is called, until the stream ends.
+    // If onMessage returns false, the call is cancelled (the connection is
+    // closed, the server stops streaming). Note: timeoutMs applies to each message.
+    bool CallStream(uint32_t methodId,
+                    const google::protobuf::Message& req,
+                    google::protobuf::Message& resp,
+                    const std::function<bool()>& onMessage,
+                    const std::map<std::string, std::string>& metadata,
+                    std::string& errMsg,
+                    long timeoutMs = 5000);
+
+    // Call a client-streaming or bidirectional-streaming method by method id.
+    // nextRequest fills req with the next message, or returns false at the end
+    // of the stream. The messages are sent as the server's flow-control window
+    // allows. Each response message is parsed into resp and onMessage is called
+    // (once, for client-streaming methods); returning false cancels the call.
+    // Note: timeoutMs applies to each message.
+    // Note: Not supported over the shared memory transport.
+    bool CallBidiStream(uint32_t methodId,
+                        google::protobuf::Message& req,
+                        const std::function<bool()>& nextRequest,
+                        google::protobuf::Message& resp,
+                        const std::function<bool()>& onMessage,
+                        const std::map<std::string, std::string>& metadata,
+                        std::string& errMsg,
+                        long timeoutMs = 5000);
+
+    // Subscribe to a topic (see ProtoServer::Publish()): each message published
+    // is parsed into msg and onMessage is called, until onMessage returns false.
+    // The connection is the subscription's: it's closed at the end, and the
+    // client reconnects. Returns false if the server refuses the subscription or
+    // ends it (e.g. evicts a subscriber that reads too slowly).
+    // Note: timeoutMs is the longest wait for a message (0: no limit).
+    // Note: Not supported over the shared memory transport.
+    bool Subscribe(const std::string& topic,
+                   google::protobuf::Message& msg,
+                   const std::function<bool()>& onMessage,
+                   std::string& errMsg,
+                   long timeoutMs = 0);
+
+    // Call a one-way method (see ProtoServer::BindOptions::oneWay) by method id,
+    // or by request type name if methodId is 0: returns once the request is
+    // written. The server sends nothing back, so a failure of the call can't be
+    // told here, not even a refusal because the method is unknown or not one-way:
+    // these are only counted, see SyncOneWay(). Note: timeoutMs covers the write only.
+    // Note: Not supported over the shared memory transport.
+    bool CallOneWay(uint32_t methodId,
+                    const google::protobuf::Message& req,
+                    const std::map<std::string, std::string>& metadata,
+                    std::string& errMsg,
+                    long timeoutMs = 5000);
+
+    // The one-way calls of the connection: sent, and handled without error or
+    // refused/failed by the server as of the last SyncOneWay()
+    struct OneWayStats
+    {
+        uint64_t sent{0};
+        uint64_t handled{0};
+        uint64_t failed{0};
+    };
+    const OneWayStats& GetOneWayStats() const { return mOneWayStats; }
+
+    // Acknowledge the one-way calls sent so far: the server has handled them all
+    // when it replies (the requests of a connection are handled in order).
+    // Updates GetOneWayStats().
+    bool SyncOneWay(std::string& errMsg, long timeoutMs = 5000);
+
+    // Acknowledge in batches: SyncOneWay() after every interval one-way calls (0: never)
+    void SetOneWayAckInterval(size_t interval) { mOneWayAckInterval = interval; }
+
 private:
+    bool Reconnect(std::string& errMsg);
+
+    // Are we in a child process forked after the connection was made?
+    bool IsForked() const { return (mForkGeneration != gForkGeneration.load(std::memory_order_relaxed)); }
+
+    // Connection setup message (COMPRESSION, CHECKSUM, METADATA_TABLE, CONNECTION_METADATA)
+    // with its value, and a METADATA frame if data is set. Returns false if the server
+    // refuses it (the connection is kept) or on transport errors (the connection is closed).
+    bool Setup(PROTO_CODE code, uint32_t value, const char* what, std::string& errMsg,
+               const std::string* data = nullptr);
+
+    // The metadata block of a call: through the metadata table if set up
+    std::string EncodeMetadata(const std::map<std::string, std::string>& metadata);
+
+    // Compress the request data with the method's (or the connection's) codec if
+    // large enough, and add its checksum
+    void EncodeRequest(uint32_t methodId, ProtoPayload& data);
+
+    // Compressed responses: any codec (the server may compress a method's with
+    // another), once the connection is switched to compression
+    ProtoDecompression Decompression() const
+    {
+        ProtoDecompression decompression;
+        decompression.codecs = (mCodec != Codec::NONE ? ALL_CODECS : 0);
+        decompression.maxSize = mMaxDecompressedSize;
+        return decompression;
+    }
+
+    // The request of a call: a message, or the serialized one of CallRaw()
+    struct Request
+    {
+        const google::protobuf::Message* msg{nullptr};
+        const ProtoPayload* raw{nullptr};
+        const std::string* name{nullptr};   // Request type name of raw
+    };
+
+    // Where the response of a call goes: parsed into msg, or kept serialized in raw
+    struct Response
+    {
+        google::protobuf::Message* msg{nullptr};
+        ProtoPayload* raw{nullptr};
+
+        // Throws std::string if the message can't be parsed
+        void Set(ProtoPayload& data);
+        void Set(std::string& data);
+    };
+
+    bool CallImpl(uint32_t methodId,
+                  const Request& req,
+                  Response resp,
+                  const std::map<std::string, std::string>& metadata,
+                  ProtoAttachment* attachment,
+                  const std::function<bool()>* onMessage,
+                  std::string& errMsg,
+                  long timeoutMs);
+
+    bool CallRecord(uint32_t methodId,
+                    const std::string& reqName,
+                    const ProtoPayload& reqData,
+                    Response& resp,
+                    const std::map<std::string, std::string>& metadata,
+                    ProtoAttachment* attachment,
+                    const std::function<bool()>* onMessage,
+                    std::string& errMsg,
+                    long timeoutMs);
+
+    bool CallBidiStreamImpl(uint32_t methodId,
+                            google::protobuf::Message& req,
+                            const std::function<bool()>& nextRequest,
+                            google::protobuf::Message& resp,
+                            const std::function<bool()>& onMessage,
+                            const std::map<std::string, std::string>& metadata,
+                            std::string& errMsg,
+                            long timeoutMs);
+
+    bool ShmCall(uint32_t methodId,
+                 const std::string& reqName,
+                 const std::string& reqData,
+                 Response& resp,
+                 const std::map<std::string, std::string>& metadata,
+                 const std::function<bool()>* onMessage,
+                 std::string& errMsg,
+                 long timeoutMs);
+
     int mSocket{-1};
     std::string mErrMsg;
+
+    // Shared memory transport (if negotiated)
+    std::unique_ptr<ShmChannel> mShm;
+    size_t mShmRingSize{0};
+
+    size_t mFdPayloadThreshold{DEFAULT_FD_PAYLOAD_THRESHOLD};
+
+    // Compression (if negotiated)
+    Codec mCodec{Codec::NONE};
+    size_t mCompressionThreshold{DEFAULT_COMPRESSION_THRESHOLD};
+    std::map<uint32_t, Codec> mMethodCodecs;
+    size_t mMaxDecompressedSize{DEFAULT_MAX_DECOMPRESSED_SIZE};
+
+    bool mChecksums{false};     // CRC32C of the payloads (if negotiated)
+
+    // Metadata table and connection metadata (if set up)
+    std::unique_ptr<MetadataEncoder> mMetadataEncoder;
+    size_t mMetadataTableSize{0};
+    std::map<std::string, std::string> mConnectionMetadata;
+
+    // One-way calls of the connection
+    OneWayStats mOneWayStats;
+    size_t mOneWayAckInterval{0};
+
+    // Connection parameters to reconnect after fork()
+    uint32_t mForkGeneration{gForkGeneration.load(std::memory_order_relaxed)};
+    std::string mDomainSocketPath;  // Starts with '\0' for the abstract namespace
+    bool mSeqPacket{false};
+    std::string mHost;
+    unsigned short mPort{0};
 };
 
 inline ProtoClient::~ProtoClient()
@@ -50,50 +330,808 @@ inline ProtoClient::~ProtoClient()
         close(mSocket);
 }
 
-inline bool ProtoClient::Init(const char* domainSocketPath, std::string& errMsg)
+inline bool ProtoClient::Init(const char* domainSocketPath, std::string& errMsg, bool seqPacket)
 {
-    return ((mSocket = gen::SetupClientDomainSocket(domainSocketPath, errMsg)) > 0);
+    RegisterForkGeneration();
+    mForkGeneration = gForkGeneration.load(std::memory_order_relaxed);
+    mDomainSocketPath = (*domainSocketPath == '\0' ?
+        std::string(domainSocketPath, strlen(domainSocketPath + 1) + 1) : std::string(domainSocketPath));
+    mSeqPacket = seqPacket;
+    mHost.clear();
+    mPort = 0;
+    mCodec = Codec::NONE;
+    mChecksums = false;
+    mMetadataEncoder.reset();
+    mMetadataTableSize = 0;
+    mConnectionMetadata.clear();
+    mOneWayStats = OneWayStats();
+    return ((mSocket = gen::SetupClientDomainSocket(domainSocketPath, errMsg,
+                                                    (seqPacket ? SOCK_SEQPACKET : SOCK_STREAM))) > 0);
 }
 
 inline bool ProtoClient::Init(const char* host, unsigned short port, std::string& errMsg)
 {
+    RegisterForkGeneration();
+    mForkGeneration = gForkGeneration.load(std::memory_order_relaxed);
+    mDomainSocketPath.clear();
+    mHost = host;
+    mPort = port;
+    mCodec = Codec::NONE;
+    mChecksums = false;
+    mMetadataEncoder.reset();
+    mMetadataTableSize = 0;
+    mConnectionMetadata.clear();
+    mOneWayStats = OneWayStats();
     return ((mSocket = gen::SetupClientSocket(host, port, errMsg)) > 0);
 }
 
+inline bool ProtoClient::Reconnect(std::string& errMsg)
+{
+    // Note: close() releases only this process' descriptor.
+    // The parent's connection is not affected.
+    if(mSocket > 0)
+        close(mSocket);
+    mSocket = -1;
+
+    // The shared memory mapping is inherited too: unmap it and negotiate a new one
+    mShm.reset();
+
+    // Note: Init() resets the connection parameters, so pass a copy
+    Codec codec = mCodec;
+    bool checksums = mChecksums;
+    size_t tableSize = mMetadataTableSize;
+    std::map<std::string, std::string> connectionMetadata = std::move(mConnectionMetadata);
+    if(std::string path = mDomainSocketPath; !path.empty())
+        return (Init(path.c_str(), errMsg, mSeqPacket) &&
+                (codec == Codec::NONE || InitCompression(codec, errMsg, mCompressionThreshold)) &&
+                (!checksums || InitChecksums(errMsg)) &&
+                (tableSize == 0 || InitMetadataTable(errMsg, tableSize)) &&
+                (connectionMetadata.empty() || SetConnectionMetadata(connectionMetadata, errMsg)) &&
+                (mShmRingSize == 0 || InitShm(errMsg, mShmRingSize)));
+    else if(std::string host = mHost; !host.empty())
+        return (Init(host.c_str(), mPort, errMsg) &&
+                (codec == Codec::NONE || InitCompression(codec, errMsg, mCompressionThreshold)) &&
+                (!checksums || InitChecksums(errMsg)) &&
+                (tableSize == 0 || InitMetadataTable(errMsg, tableSize)) &&
+                (connectionMetadata.empty() || SetConnectionMetadata(connectionMetadata, errMsg)));
+
+    errMsg = "Client is not initialized";
+    return false;
+}
+
+inline bool ProtoClient::InitShm(std::string& errMsg, size_t ringSize)
+{
+    if(mSocket < 0 || mDomainSocketPath.empty())
+    {
+        errMsg = "Shared memory transport requires a Unix domain socket connection";
+        return false;
+    }
+
+    mShm.reset();
+    auto shm = std::make_unique<ShmChannel>();
+    int shmFd = shm->Create(ringSize, errMsg);
+    if(shmFd == -1)
+        return false;
+
+    // Send SHM_SETUP with the memfd and the ring size.
+    // Expecting ACK or NACK (followed by ERR) back from server.
+    const long timeoutMs = 5000;
+    uint32_t code = 0;
+    std::string err;
+    bool res = false;
+    if(mSeqPacket)
+    {
+        ProtoFrameWriter writer;
+        writer.AddInteger(PROTO_CODE::SHM_SETUP);
+        writer.AddInteger(ringSize);
+        writer.AddFd(shmFd);
+
+        ProtoFrameReader reader;
+        res = (gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg) &&
+               gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg) &&
+               reader.ReadInteger(code, errMsg) &&
+               (code != PROTO_CODE::NACK || reader.ReadData(PROTO_CODE::ERR, err, errMsg)));
+    }
+    else
+    {
+        uint32_t data = htonl(ringSize);
+        res = (gen::ProtoSendCode(mSocket, PROTO_CODE::SHM_SETUP, timeoutMs, errMsg) &&
+               gen::SendFds(mSocket, &shmFd, 1, &data, sizeof(data), errMsg) &&
+               gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg) &&
+               (code != PROTO_CODE::NACK || gen::ProtoRecvData(mSocket, PROTO_CODE::ERR, err, timeoutMs, errMsg)));
+    }
+    close(shmFd);
+
+    if(!res)
+    {
+        errMsg = "Failed to set up shared memory transport: " + errMsg;
+        close(mSocket);
+        mSocket = -1;
+        return false;
+    }
+
+    if(code == PROTO_CODE::NACK)
+    {
+        // Server refused: keep using the socket
+        errMsg = "Shared memory transport is refused: " + err;
+        return false;
+    }
+    else if(!gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg))
+    {
+        close(mSocket);
+        mSocket = -1;
+        return false;
+    }
+
+    mShm = std::move(shm);
+    mShmRingSize = ringSize;
+    return true;
+}
+
+inline bool ProtoClient::Setup(PROTO_CODE setupCode, uint32_t value, const char* what, std::string& errMsg,
+                               const std::string* data)
+{
+    if(mSocket < 0 || mShm)
+    {
+        errMsg = (mShm ? std::string(what) + " is not used over the shared memory transport" : "Client is not connected");
+        return false;
+    }
+
+    // Send the setup code with the value.
+    // Expecting ACK or NACK (followed by ERR) back from server.
+    const long timeoutMs = 5000;
+    uint32_t code = 0;
+    std::string err;
+    bool res = false;
+    if(mSeqPacket)
+    {
+        ProtoFrameWriter writer;
+        writer.AddInteger(setupCode);
+        writer.AddInteger(value);
+        if(data)
+            writer.AddData(PROTO_CODE::METADATA, *data);
+
+        ProtoFrameReader reader;
+        res = (gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg) &&
+               gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg) &&
+               reader.ReadInteger(code, errMsg) &&
+               (code != PROTO_CODE::NACK || reader.ReadData(PROTO_CODE::ERR, err, errMsg)));
+    }
+    else
+    {
+        res = (gen::ProtoSendCode(mSocket, setupCode, timeoutMs, errMsg) &&
+               gen::ProtoSendInteger(mSocket, value, timeoutMs, errMsg) &&
+               (!data || gen::ProtoSendData(mSocket, PROTO_CODE::METADATA, *data, timeoutMs, errMsg)) &&
+               gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg) &&
+               (code != PROTO_CODE::NACK || gen::ProtoRecvData(mSocket, PROTO_CODE::ERR, err, timeoutMs, errMsg)));
+    }
+
+    if(!res)
+    {
+        errMsg = std::string("Failed to set up ") + what + ": " + errMsg;
+        close(mSocket);
+        mSocket = -1;
+        return false;
+    }
+
+    if(code == PROTO_CODE::NACK)
+    {
+        // Server refused: keep using the connection as it is
+        errMsg = std::string(what) + " refused by the server: " + err;
+        return false;
+    }
+    else if(!gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg))
+    {
+        close(mSocket);
+        mSocket = -1;
+        return false;
+    }
+    return true;
+}
+
+inline bool ProtoClient::InitCompression(Codec codec, std::string& errMsg, size_t threshold)
+{
+    mCodec = Codec::NONE;
+    if(!Setup(PROTO_CODE::COMPRESSION, static_cast<uint32_t>(codec), "Compression", errMsg))
+        return false;
+
+    mCodec = codec;
+    mCompressionThreshold = threshold;
+    return true;
+}
+
+inline bool ProtoClient::InitChecksums(std::string& errMsg)
+{
+    mChecksums = false;
+    if(!Setup(PROTO_CODE::CHECKSUM, PROTO_CHECKSUM_CRC32C, "Checksums", errMsg))
+        return false;
+
+    mChecksums = true;
+    return true;
+}
+
+inline bool ProtoClient::InitMetadataTable(std::string& errMsg, size_t tableSize)
+{
+    // Note: The server starts a new table as well
+    mMetadataEncoder.reset();
+    mMetadataTableSize = 0;
+    if(tableSize > UINT32_MAX || tableSize < METADATA_ENTRY_OVERHEAD)
+    {
+        errMsg = "Invalid metadata table size " + std::to_string(tableSize);
+        return false;
+    }
+    if(!Setup(PROTO_CODE::METADATA_TABLE, static_cast<uint32_t>(tableSize), "Metadata table", errMsg))
+        return false;
+
+    mMetadataEncoder = std::make_unique<MetadataEncoder>(tableSize);
+    mMetadataTableSize = tableSize;
+    return true;
+}
+
+inline bool ProtoClient::SetConnectionMetadata(const std::map<std::string, std::string>& metadata, std::string& errMsg)
+{
+    std::string data = gen::SerializeToString(metadata);
+    if(!Setup(PROTO_CODE::CONNECTION_METADATA, static_cast<uint32_t>(metadata.size()), "Connection metadata",
+              errMsg, &data))
+        return false;
+
+    mConnectionMetadata = metadata;
+    return true;
+}
+
+inline std::string ProtoClient::EncodeMetadata(const std::map<std::string, std::string>& metadata)
+{
+    return (mMetadataEncoder ? mMetadataEncoder->Encode(metadata) : gen::SerializeToString(metadata));
+}
+
+// Requests smaller than the threshold, and memfd payloads, are sent uncompressed
+inline void ProtoClient::EncodeRequest(uint32_t methodId, ProtoPayload& data)
+{
+    if(mShm)
+        return;
+
+    if(mCodec != Codec::NONE && !data.IsFd() && data.size() >= mCompressionThreshold)
+    {
+        auto itr = mMethodCodecs.find(methodId);
+        std::string errMsg;
+        if(!data.Compress((itr != mMethodCodecs.end() ? itr->second : mCodec), errMsg))
+            throw std::string("Failed to compress request message: ") + errMsg;
+    }
+
+    data.SetChecksum(mChecksums);
+}
+
 // Call with metadata
 inline bool ProtoClient::Call(const google::protobuf::Message& req,
                               google::protobuf::Message& resp,
                               const std::map<std::string, std::string>& metadata,
-                              std::string& errMsgOut,
+                              std::string& errMsg,
+                              long timeoutMs)
+{
+    return CallImpl(0 /*call by request name*/, Request{&req}, Response{&resp}, metadata, nullptr, nullptr, errMsg, timeoutMs);
+}
+
+// Call by method id with metadata
+inline bool ProtoClient::Call(uint32_t methodId,
+                              const google::protobuf::Message& req,
+                              google::protobuf::Message& resp,
+                              const std::map<std::string, std::string>& metadata,
+                              std::string& errMsg,
+                              long timeoutMs)
+{
+    return CallImpl(methodId, Request{&req}, Response{&resp}, metadata, nullptr, nullptr, errMsg, timeoutMs);
+}
+
+// Call by method id with metadata, receiving the attachment
+inline bool ProtoClient::Call(uint32_t methodId,
+                              const google::protobuf::Message& req,
+                              google::protobuf::Message& resp,
+                              const std::map<std::string, std::string>& metadata,
+                              ProtoAttachment& attachment,
+                              std::string& errMsg,
                               long timeoutMs)
+{
+    return CallImpl(methodId, Request{&req}, Response{&resp}, metadata, &attachment, nullptr, errMsg, timeoutMs);
+}
+
+// Call a server-streaming method by method id with metadata
+inline bool ProtoClient::CallStream(uint32_t methodId,
+                                    const google::protobuf::Message& req,
+                                    google::protobuf::Message& resp,
+                                    const std::function<bool()>& onMessage,
+                                    const std::map<std::string, std::string>& metadata,
+                                    std::string& errMsg,
+                                    long timeoutMs)
+{
+    return CallImpl(methodId, Request{&req}, Response{&resp}, metadata, nullptr, &onMessage, errMsg, timeoutMs);
+}
+
+// Call a client-streaming or bidirectional-streaming method by method id with metadata
+inline bool ProtoClient::CallBidiStream(uint32_t methodId,
+                                        google::protobuf::Message& req,
+                                        const std::function<bool()>& nextRequest,
+                                        google::protobuf::Message& resp,
+                                        const std::function<bool()>& onMessage,
+                                        const std::map<std::string, std::string>& metadata,
+                                        std::string& errMsgOut,
+                                        long timeoutMs)
 {
     if(timeoutMs == 0)
         timeoutMs = 3'600'000; // One hour default timeout
 
     try
     {
+        // Are we in a child process forked after the connection was made?
+        // Don't share the socket with the parent; reconnect instead.
+        if(IsForked() && !Reconnect(mErrMsg))
+            throw std::string("Failed to reconnect after fork: ") + mErrMsg;
+
+        if(mSocket < 0)
+            throw (!mErrMsg.empty() ? mErrMsg : std::string("Invalid socket (-1)"));
+
+        if(mShm)
+        {
+            // Note: Don't throw because it will close the connection; just return false
+            errMsgOut = "Call: Client streaming is not supported over shared memory";
+            return false;
+        }
+
+        return CallBidiStreamImpl(methodId, req, nextRequest, resp, onMessage, metadata, errMsgOut, timeoutMs);
+    }
+    catch(const std::string& e)
+    {
+        errMsgOut = std::string("Call") + ": " + e;
+    }
+    catch(const std::exception& ex)
+    {
+        errMsgOut = std::string("Call") + ": std::exception: " + ex.what();
+    }
+    catch(...)
+    {
+        errMsgOut = std::string("Call") + ": Unexpected exception";
+    }
+
+    close(mSocket);
+    mSocket = -1;
+    mShm.reset();
+    return false;
+}
+
+inline bool ProtoClient::Subscribe(const std::string& topic,
+                                   google::protobuf::Message& msg,
+                                   const std::function<bool()>& onMessage,
+                                   std::string& errMsgOut,
+                                   long timeoutMs)
+{
+    // Note: The subscription ends with the connection. The caller ending it is not an error.
+    bool res = false;
+    try
+    {
+        // Are we in a child process forked after the connection was made?
+        // Don't share the socket with the parent; reconnect instead.
+        if(IsForked() && !Reconnect(mErrMsg))
+            throw std::string("Failed to reconnect after fork: ") + mErrMsg;
+
+        if(mSocket < 0)
+            throw (!mErrMsg.empty() ? mErrMsg : std::string("Invalid socket (-1)"));
+
+        if(mShm)
+        {
+            // Note: Don't throw because it will close the connection; just return false
+            errMsgOut = "Subscribe: Subscriptions are not supported over shared memory";
+            return false;
+        }
+
+        // Send SUBSCRIBE (topic). Expecting ACK or NACK (followed by ERR) back from server.
+        std::string errMsg;
+        uint32_t code = 0;
+        ProtoFrameReader reader;
+        if(mSeqPacket)
+        {
+            ProtoFrameWriter writer;
+            writer.AddData(PROTO_CODE::SUBSCRIBE, topic);
+            if(!gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg) ||
+               !gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg) ||
+               !reader.ReadInteger(code, errMsg))
+                throw std::string("Failed to subscribe: ") + errMsg;
+        }
+        else if(!gen::ProtoSendData(mSocket, PROTO_CODE::SUBSCRIBE, topic, timeoutMs, errMsg) ||
+                !gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg))
+        {
+            throw std::string("Failed to subscribe: ") + errMsg;
+        }
+
+        if(code == PROTO_CODE::NACK)
+        {
+            // Note: Don't throw because it will close the connection; just return false
+            bool received = (mSeqPacket ? reader.ReadData(PROTO_CODE::ERR, errMsgOut, errMsg) :
+                             gen::ProtoRecvData(mSocket, PROTO_CODE::ERR, errMsgOut, timeoutMs, errMsg));
+            if(!received)
+                throw std::string("Failed to receive ERR (response value): ") + errMsg;
+            return false;
+        }
+        else if(!gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg))
+        {
+            throw std::string("Failed to subscribe: ") + errMsg;
+        }
+
+        // The messages: RESP frames (one record each), until the connection ends
+        ProtoPayload data;
+        Response resp{&msg};
+        while(true)
+        {
+            bool received = false;
+            if(mSeqPacket)
+            {
+                received = (gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg) &&
+                            reader.ReadData(PROTO_CODE::RESP, data, errMsg));
+            }
+            else
+            {
+                received = (gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg) &&
+                            gen::ProtoValidateCode(code, PROTO_CODE::RESP, errMsg) &&
+                            gen::ProtoRecvPayload(mSocket, data, timeoutMs, errMsg));
+            }
+            if(!received)
+                throw std::string("Failed to receive RESP (published message): ") + errMsg;
+
+            resp.Set(data);
+            if(!onMessage())
+                break;
+        }
+        res = true;
+    }
+    catch(const std::string& e)
+    {
+        errMsgOut = std::string("Subscribe") + ": " + e;
+    }
+    catch(const std::exception& ex)
+    {
+        errMsgOut = std::string("Subscribe") + ": std::exception: " + ex.what();
+    }
+    catch(...)
+    {
+        errMsgOut = std::string("Subscribe") + ": Unexpected exception";
+    }
+
+    // Note: Closing the connection ends the subscription on the server.
+    // On failure the next call fails with mErrMsg.
+    Reconnect(mErrMsg);
+    return res;
+}
+
+// If methodId is 0, then the request is routed by the request type name
+inline bool ProtoClient::CallOneWay(uint32_t methodId,
+                                    const google::protobuf::Message& req,
+                                    const std::map<std::string, std::string>& metadata,
+                                    std::string& errMsgOut,
+                                    long timeoutMs)
+{
+    if(timeoutMs == 0)
+        timeoutMs = 3'600'000; // One hour default timeout
+
+    try
+    {
+        // Are we in a child process forked after the connection was made?
+        // Don't share the socket with the parent; reconnect instead.
+        if(IsForked() && !Reconnect(mErrMsg))
+            throw std::string("Failed to reconnect after fork: ") + mErrMsg;
+
+        if(mSocket < 0)
+            throw (!mErrMsg.empty() ? mErrMsg : std::string("Invalid socket (-1)"));
+
+        if(mShm)
+        {
+            // Note: Don't throw because it will close the connection; just return false
+            errMsgOut = "CallOneWay: One-way calls are not supported over shared memory";
+            return false;
+        }
+
+        // Serialize request protobuf message straight into the payload buffer.
+        // Large requests over Unix domain sockets go in a sealed memfd.
+        std::string errMsg;
+        ProtoPayload reqData;
+        if(size_t reqSize = req.ByteSizeLong(); reqSize > 0)
+        {
+            if(reqSize > PROTO_MAX_MESSAGE_SIZE)
+                throw std::string("The protobuf request message of ") + std::to_string(reqSize) + " bytes exceeds the 2 GiB limit";
+
+            size_t fdThreshold = (mDomainSocketPath.empty() ? NO_FD_PAYLOAD :
+                                  mSeqPacket ? std::min(mFdPayloadThreshold, SEQPACKET_FD_PAYLOAD_THRESHOLD) :
+                                  mFdPayloadThreshold);
+            char* buf = reqData.Allocate(reqSize, fdThreshold, errMsg);
+            if(!buf || !req.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf)) || !reqData.Seal(errMsg))
+                throw std::string("Failed to write protobuf request message, size=") + std::to_string(reqSize) + " " + errMsg;
+        }
+        EncodeRequest(methodId, reqData);
+
+        // ONEWAY, the method, REQ and METADATA at once: there's no ACK to wait for
+        if(mSeqPacket)
+        {
+            ProtoFrameWriter writer;
+            std::string reqName;
+            writer.AddInteger(PROTO_CODE::ONEWAY);
+            if(methodId != 0)
+            {
+                writer.AddInteger(PROTO_CODE::REQ_ID);
+                writer.AddInteger(methodId);
+            }
+            else
+            {
+                reqName = std::string(req.GetTypeName());
+                writer.AddData(PROTO_CODE::REQ_NAME, reqName);
+            }
+            std::string metadataData = EncodeMetadata(metadata);
+            writer.AddData(PROTO_CODE::REQ, reqData);
+            writer.AddData(PROTO_CODE::METADATA, metadataData);
+            if(!gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg))
+                throw std::string("Failed to send ONEWAY (request): ") + errMsg;
+        }
+        else
+        {
+            OutputQueue output;
+            gen::ProtoQueueCode(output, PROTO_CODE::ONEWAY);
+            if(methodId != 0)
+            {
+                gen::ProtoQueueCode(output, PROTO_CODE::REQ_ID);
+                gen::ProtoQueueInteger(output, methodId);
+            }
+            else
+            {
+                gen::ProtoQueueData(output, PROTO_CODE::REQ_NAME, std::string(req.GetTypeName()));
+            }
+            gen::ProtoQueueData(output, PROTO_CODE::REQ, reqData);
+            gen::ProtoQueueData(output, PROTO_CODE::METADATA, EncodeMetadata(metadata));
+
+            // Write as much as the socket takes, until all is sent
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+            while(true)
+            {
+                if(!output.Flush(mSocket, errMsg))
+                    throw std::string("Failed to send ONEWAY (request): ") + errMsg;
+                if(output.Empty())
+                    break;
+
+                auto remaining = deadline - std::chrono::steady_clock::now();
+                if(remaining <= std::chrono::microseconds(0))
+                    throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
+                if(!gen::WaitSocket(mSocket, POLLOUT,
+                                    std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count(), errMsg))
+                    throw std::string("Failed to send ONEWAY (request): ") + errMsg;
+            }
+        }
+
+        mOneWayStats.sent++;
+        if(mOneWayAckInterval != 0 && mOneWayStats.sent % mOneWayAckInterval == 0)
+            return SyncOneWay(errMsgOut, timeoutMs);
+        return true;
+    }
+    catch(const std::string& e)
+    {
+        errMsgOut = std::string("CallOneWay") + ": " + e;
+    }
+    catch(const std::exception& ex)
+    {
+        errMsgOut = std::string("CallOneWay") + ": std::exception: " + ex.what();
+    }
+    catch(...)
+    {
+        errMsgOut = std::string("CallOneWay") + ": Unexpected exception";
+    }
+
+    close(mSocket);
+    mSocket = -1;
+    mShm.reset();
+    return false;
+}
+
+inline bool ProtoClient::SyncOneWay(std::string& errMsgOut, long timeoutMs)
+{
+    if(timeoutMs == 0)
+        timeoutMs = 3'600'000; // One hour default timeout
+
+    try
+    {
+        if(IsForked() && !Reconnect(mErrMsg))
+            throw std::string("Failed to reconnect after fork: ") + mErrMsg;
+
+        if(mSocket < 0)
+            throw (!mErrMsg.empty() ? mErrMsg : std::string("Invalid socket (-1)"));
+
+        if(mShm)
+        {
+            // Note: Don't throw because it will close the connection; just return false
+            errMsgOut = "SyncOneWay: One-way calls are not supported over shared memory";
+            return false;
+        }
+
+        // Send ONEWAY_STATUS. Expecting ACK back from server, then the counts
+        // of the one-way calls handled and failed (64-bit each).
+        std::string errMsg;
+        uint32_t code = 0;
+        uint32_t counts[4] = {};
+        bool received = false;
+        if(mSeqPacket)
+        {
+            ProtoFrameWriter writer;
+            ProtoFrameReader reader;
+            writer.AddInteger(PROTO_CODE::ONEWAY_STATUS);
+            received = (gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg) &&
+                        gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg) &&
+                        reader.ReadInteger(code, errMsg) &&
+                        gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg));
+            for(size_t i = 0; received && i < 4; i++)
+                received = reader.ReadInteger(counts[i], errMsg);
+        }
+        else
+        {
+            // Note: The server handles the one-way calls sent before first: timeoutMs applies to each frame
+            received = (gen::ProtoSendCode(mSocket, PROTO_CODE::ONEWAY_STATUS, timeoutMs, errMsg) &&
+                        gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg) &&
+                        gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg));
+            for(size_t i = 0; received && i < 4; i++)
+                received = gen::ProtoRecvInteger(mSocket, counts[i], timeoutMs, errMsg);
+        }
+        if(!received)
+            throw std::string("Failed to receive ONEWAY_STATUS: ") + errMsg;
+
+        mOneWayStats.handled = (static_cast<uint64_t>(counts[0]) << 32) | counts[1];
+        mOneWayStats.failed = (static_cast<uint64_t>(counts[2]) << 32) | counts[3];
+        return true;
+    }
+    catch(const std::string& e)
+    {
+        errMsgOut = std::string("SyncOneWay") + ": " + e;
+    }
+    catch(const std::exception& ex)
+    {
+        errMsgOut = std::string("SyncOneWay") + ": std::exception: " + ex.what();
+    }
+    catch(...)
+    {
+        errMsgOut = std::string("SyncOneWay") + ": Unexpected exception";
+    }
+
+    close(mSocket);
+    mSocket = -1;
+    mShm.reset();
+    return false;
+}
+
+inline bool ProtoClient::CallRaw(uint32_t methodId,
+                                 const std::string& reqName,
+                                 const ProtoPayload& reqData,
+                                 ProtoPayload& respData,
+                                 const std::map<std::string, std::string>& metadata,
+                                 std::string& errMsg,
+                                 long timeoutMs)
+{
+    return CallImpl(methodId, Request{nullptr, &reqData, &reqName}, Response{nullptr, &respData},
+                    metadata, nullptr, nullptr, errMsg, timeoutMs);
+}
+
+inline void ProtoClient::Response::Set(ProtoPayload& data)
+{
+    if(raw)
+    {
+        raw->Swap(data);
+        return;
+    }
+
+    // Create protobuf message from the response data (in place if it's a mapped memfd)
+    if(data.size() > INT_MAX || !msg->ParseFromArray(data.data(), static_cast<int>(data.size())))
+        throw std::string("Failed to parse response data into protobuf message ") +
+                 msg->GetTypeName() + " with size: " + std::to_string(data.size());
+}
+
+inline void ProtoClient::Response::Set(std::string& data)
+{
+    if(raw)
+    {
+        raw->Clear();
+        raw->str().swap(data);
+        return;
+    }
+
+    // Create protobuf message from the response data
+    if(!msg->ParseFromString(data))
+        throw std::string("Failed to parse response data into protobuf message ") +
+                 msg->GetTypeName() + " with size: " + std::to_string(data.length());
+}
+
+// If methodId is 0, then the request is routed by the request type name
+inline bool ProtoClient::CallImpl(uint32_t methodId,
+                                  const Request& req,
+                                  Response resp,
+                                  const std::map<std::string, std::string>& metadata,
+                                  ProtoAttachment* attachment,
+                                  const std::function<bool()>* onMessage,
+                                  std::string& errMsgOut,
+                                  long timeoutMs)
+{
+    if(timeoutMs == 0)
+        timeoutMs = 3'600'000; // One hour default timeout
+
+    if(attachment)
+        attachment->size = 0;
+
+    try
+    {
+        // Are we in a child process forked after the connection was made?
+        // Don't share the socket with the parent; reconnect instead.
+        if(IsForked() && !Reconnect(mErrMsg))
+            throw std::string("Failed to reconnect after fork: ") + mErrMsg;
+
         if(mSocket < 0)
             throw (!mErrMsg.empty() ? mErrMsg : std::string("Invalid socket (-1)"));
 
         // Do we have non-empty request message?
         // Note: it's OK to send an empty request.
-        std::string reqName = req.GetTypeName();
-        std::string reqData;
-        if(size_t reqSize = req.ByteSizeLong(); reqSize > 0)
+        std::string errMsg;
+        std::string reqName = (methodId != 0 ? std::string() : req.msg ? req.msg->GetTypeName() : *req.name);
+        ProtoPayload ownReqData;
+        const ProtoPayload* reqPtr = &ownReqData;
+        if(req.raw)
+        {
+            // Serialized already: sent as it is, unless the connection needs it in
+            // memory (compression, checksums) or can't pass a memfd
+            bool canPassFd = (!mDomainSocketPath.empty() && !mShm);
+            if(req.raw->IsFd() ? !canPassFd : (!mShm && (mCodec != Codec::NONE || mChecksums)))
+            {
+                char* buf = ownReqData.Allocate(req.raw->size(), NO_FD_PAYLOAD, errMsg);
+                if(!buf)
+                    throw std::string("Failed to copy request data, size=") + std::to_string(req.raw->size()) + " " + errMsg;
+                memcpy(buf, req.raw->data(), req.raw->size());
+                EncodeRequest(methodId, ownReqData);
+            }
+            else
+            {
+                reqPtr = req.raw;
+            }
+        }
+        else if(size_t reqSize = req.msg->ByteSizeLong(); reqSize > 0)
         {
-            // Serialize request protobuf message to string
-            if(!req.SerializeToString(&reqData))
-                throw std::string("Failed to write protobuf request message, size=") + std::to_string(reqSize);
+            if(reqSize > PROTO_MAX_MESSAGE_SIZE)
+                throw std::string("The protobuf request message of ") + std::to_string(reqSize) + " bytes exceeds the 2 GiB limit";
+
+            // Serialize request protobuf message straight into the payload buffer.
+            // Large requests over Unix domain sockets go in a sealed memfd.
+            size_t fdThreshold = (mDomainSocketPath.empty() || mShm ? NO_FD_PAYLOAD :
+                                  mSeqPacket ? std::min(mFdPayloadThreshold, SEQPACKET_FD_PAYLOAD_THRESHOLD) :
+                                  mFdPayloadThreshold);
+            char* buf = ownReqData.Allocate(reqSize, fdThreshold, errMsg);
+            if(!buf || !req.msg->SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf)) || !ownReqData.Seal(errMsg))
+                throw std::string("Failed to write protobuf request message, size=") + std::to_string(reqSize) + " " + errMsg;
         }
+        if(!req.raw)
+            EncodeRequest(methodId, ownReqData);
+        const ProtoPayload& reqData = *reqPtr;
+
+        // Shared memory transport: no socket I/O at all
+        if(mShm)
+            return ShmCall(methodId, reqName, reqData.str(), resp, metadata, onMessage, errMsgOut, timeoutMs);
+
+        // SOCK_SEQPACKET: the whole request in one record
+        if(mSeqPacket)
+            return CallRecord(methodId, reqName, reqData, resp, metadata, attachment, onMessage, errMsgOut, timeoutMs);
 
         // Call the server
-        std::string errMsg;
         auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
         long remainingTimeoutMs = timeoutMs;
 
-        // Sent the REQ_NAME (request name)
-        if(!gen::ProtoSendData(mSocket, PROTO_CODE::REQ_NAME, reqName, remainingTimeoutMs, errMsg))
-            throw std::string("Failed to send REQ_NAME (request name): ") + errMsg;
+        if(methodId != 0)
+        {
+            // Sent the REQ_ID (method id)
+            if(!gen::ProtoSendCode(mSocket, PROTO_CODE::REQ_ID, remainingTimeoutMs, errMsg) ||
+               !gen::ProtoSendInteger(mSocket, methodId, remainingTimeoutMs, errMsg))
+                throw std::string("Failed to send REQ_ID (method id): ") + errMsg;
+        }
+        else
+        {
+            // Sent the REQ_NAME (request name)
+            if(!gen::ProtoSendData(mSocket, PROTO_CODE::REQ_NAME, reqName, remainingTimeoutMs, errMsg))
+                throw std::string("Failed to send REQ_NAME (request name): ") + errMsg;
+        }
 
         // Adjust timeout
         auto remaining = deadline - std::chrono::steady_clock::now();
@@ -137,7 +1175,7 @@ inline bool ProtoClient::Call(const google::protobuf::Message& req,
         remainingTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
 
         // Send metadata
-        if(!gen::ProtoSendData(mSocket, PROTO_CODE::METADATA, metadata, remainingTimeoutMs, errMsg))
+        if(!gen::ProtoSendData(mSocket, PROTO_CODE::METADATA, EncodeMetadata(metadata), remainingTimeoutMs, errMsg))
             throw std::string("Failed to send METADATA: ") + errMsg;
 
         // Adjust timeout
@@ -146,9 +1184,35 @@ inline bool ProtoClient::Call(const google::protobuf::Message& req,
             throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
         remainingTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
 
+        // Server streaming: RESP frames until ERR ends the stream
+        ProtoPayload respData;
+        if(onMessage)
+        {
+            while(true)
+            {
+                if(!gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg))
+                    throw std::string("Failed to receive RESP/ERR code: ") + errMsg;
+                if(code != PROTO_CODE::RESP)
+                    break;
+
+                if(!gen::ProtoRecvPayload(mSocket, respData, timeoutMs, errMsg, Decompression()))
+                    throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+                resp.Set(respData);
+
+                // Note: Closing the connection stops the server
+                if(!(*onMessage)())
+                    throw std::string("Cancelled by the caller");
+            }
+
+            // Receive ERR (error message)
+            if(!gen::ProtoValidateCode(code, PROTO_CODE::ERR, errMsg) ||
+               !gen::ProtoRecvPayload(mSocket, errMsgOut, timeoutMs, errMsg))
+                throw std::string("Failed to receive ERR (response value): ") + errMsg;
+            return true;
+        }
+
         // Receive RESP (response data)
-        std::string respData;
-        if(!gen::ProtoRecvData(mSocket, PROTO_CODE::RESP, respData, remainingTimeoutMs, errMsg))
+        if(!gen::ProtoRecvData(mSocket, PROTO_CODE::RESP, respData, remainingTimeoutMs, errMsg, Decompression()))
             throw std::string("Failed to receive RESP (respData data): ") + errMsg;
 
         // Adjust timeout
@@ -157,8 +1221,30 @@ inline bool ProtoClient::Call(const google::protobuf::Message& req,
             throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
         remainingTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
 
+        // Receive the ATTACHMENT (if any)
+        if(!gen::ProtoRecvInteger(mSocket, code, remainingTimeoutMs, errMsg))
+            throw std::string("Failed to receive ERR (response value): ") + errMsg;
+
+        if(code == PROTO_CODE::ATTACHMENT)
+        {
+            if(!attachment)
+                throw std::string("Failed to receive ATTACHMENT: the call has no ProtoAttachment to receive it");
+            if(!gen::ProtoRecvAttachment(mSocket, *attachment, remainingTimeoutMs, errMsg))
+                throw std::string("Failed to receive ATTACHMENT: ") + errMsg;
+
+            // Adjust timeout
+            remaining = deadline - std::chrono::steady_clock::now();
+            if(remaining <= std::chrono::microseconds(0))
+                throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
+            remainingTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+
+            if(!gen::ProtoRecvInteger(mSocket, code, remainingTimeoutMs, errMsg))
+                throw std::string("Failed to receive ERR (response value): ") + errMsg;
+        }
+
         // Receive ERR (error message)
-        if(!gen::ProtoRecvData(mSocket, PROTO_CODE::ERR, errMsgOut, remainingTimeoutMs, errMsg))
+        if(!gen::ProtoValidateCode(code, PROTO_CODE::ERR, errMsg) ||
+           !gen::ProtoRecvPayload(mSocket, errMsgOut, remainingTimeoutMs, errMsg))
             throw std::string("Failed to receive ERR (response value): ") + errMsg;
 
         // Adjust timeout
@@ -166,31 +1252,451 @@ inline bool ProtoClient::Call(const google::protobuf::Message& req,
         if(remaining <= std::chrono::microseconds(0))
             throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
 
-        // Create protobuf message from the response data
-        if(!resp.ParseFromString(respData))
-            throw std::string("Failed to parse response data into protobuf message ") +
-                     resp.GetTypeName() + " with size: " + std::to_string(respData.length());
-
+        resp.Set(respData);
         return true;
     }
     catch(const std::string& e)
     {
-        errMsgOut = std::string(__func__) + ": " + e;
+        errMsgOut = std::string("Call") + ": " + e;
     }
     catch(const std::exception& ex)
     {
-        errMsgOut = std::string(__func__) + ": std::exception: " + ex.what();
+        errMsgOut = std::string("Call") + ": std::exception: " + ex.what();
     }
     catch(...)
     {
-        errMsgOut = std::string(__func__) + ": Unexpected exception";
+        errMsgOut = std::string("Call") + ": Unexpected exception";
     }
 
     close(mSocket);
     mSocket = -1;
+    mShm.reset();
     return false;
 }
 
+// SOCK_SEQPACKET: the whole request is sent as one record, without waiting for ACK.
+// Throws std::string on transport errors (the connection is closed then).
+inline bool ProtoClient::CallRecord(uint32_t methodId,
+                                    const std::string& reqName,
+                                    const ProtoPayload& reqData,
+                                    Response& resp,
+                                    const std::map<std::string, std::string>& metadata,
+                                    ProtoAttachment* attachment,
+                                    const std::function<bool()>* onMessage,
+                                    std::string& errMsgOut,
+                                    long timeoutMs)
+{
+    std::string errMsg;
+    std::string metadataData = EncodeMetadata(metadata);
+
+    ProtoFrameWriter writer;
+    if(methodId != 0)
+    {
+        writer.AddInteger(PROTO_CODE::REQ_ID);
+        writer.AddInteger(methodId);
+    }
+    else
+    {
+        writer.AddData(PROTO_CODE::REQ_NAME, reqName);
+    }
+    writer.AddData(PROTO_CODE::REQ, reqData);
+    writer.AddData(PROTO_CODE::METADATA, metadataData);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    if(!gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg))
+        throw std::string("Failed to send REQ (request data): ") + errMsg;
+
+    // Adjust timeout
+    auto remaining = deadline - std::chrono::steady_clock::now();
+    if(remaining <= std::chrono::microseconds(0))
+        throw std::string("Timed out after ") + std::to_string(timeoutMs) + " ms";
+    long remainingTimeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count();
+
+    // Expecting RESP and ERR, or NACK and ERR, in one record
+    ProtoFrameReader reader;
+    uint32_t code = 0;
+    if(!gen::ProtoRecvFrames(mSocket, reader, std::max(remainingTimeoutMs, 1L), errMsg) ||
+       !reader.ReadInteger(code, errMsg))
+        throw std::string("Failed to receive RESP/NACK code: ") + errMsg;
+
+    if(code == PROTO_CODE::NACK)
+    {
+        // Receive ERR (error message)
+        if(!reader.ReadData(PROTO_CODE::ERR, errMsgOut, errMsg))
+            throw std::string("Failed to receive ERR (response value): ") + errMsg;
+        return false;
+    }
+    else if(code != PROTO_CODE::ERR || !onMessage)
+    {
+        if(!gen::ProtoValidateCode(code, PROTO_CODE::RESP, errMsg))
+            throw std::string("Failed to receive RESP/NACK code: ") + errMsg;
+    }
+
+    // Server streaming: one record per message, until an ERR record ends the stream
+    ProtoPayload respData;
+    while(onMessage && code == PROTO_CODE::RESP)
+    {
+        reader.Rewind(sizeof(uint32_t));
+        if(!reader.ReadData(PROTO_CODE::RESP, respData, errMsg, Decompression()))
+            throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+        resp.Set(respData);
+
+        // Note: Closing the connection stops the server
+        if(!(*onMessage)())
+            throw std::string("Cancelled by the caller");
+
+        // The ERR of a unary method's response is in the same record
+        if(reader.IsEnd() && !gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg))
+            throw std::string("Failed to receive RESP/ERR record: ") + errMsg;
+        if(!reader.ReadInteger(code, errMsg))
+            throw std::string("Failed to receive RESP/ERR code: ") + errMsg;
+    }
+
+    if(onMessage)
+    {
+        // Receive ERR (error message)
+        if(!gen::ProtoValidateCode(code, PROTO_CODE::ERR, errMsg) || !reader.ReadPayload(errMsgOut, errMsg))
+            throw std::string("Failed to receive ERR (response value): ") + errMsg;
+        return true;
+    }
+
+    // Re-read RESP (response data) with its code, then ERR (error message)
+    reader.Rewind(sizeof(uint32_t));
+    if(!reader.ReadData(PROTO_CODE::RESP, respData, errMsg, Decompression()))
+        throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+
+    // The ATTACHMENT (if any)
+    if(!reader.ReadInteger(code, errMsg))
+        throw std::string("Failed to receive ERR (response value): ") + errMsg;
+    reader.Rewind(sizeof(uint32_t));
+
+    if(code == PROTO_CODE::ATTACHMENT)
+    {
+        if(!attachment)
+            throw std::string("Failed to receive ATTACHMENT: the call has no ProtoAttachment to receive it");
+
+        ProtoPayload attachmentData;
+        if(!reader.ReadData(PROTO_CODE::ATTACHMENT, attachmentData, errMsg) ||
+           !gen::ProtoStoreAttachment(attachmentData, *attachment, errMsg))
+            throw std::string("Failed to receive ATTACHMENT: ") + errMsg;
+    }
+
+    if(!reader.ReadData(PROTO_CODE::ERR, errMsgOut, errMsg))
+        throw std::string("Failed to receive ERR (response value): ") + errMsg;
+
+    resp.Set(respData);
+    return true;
+}
+
+// The call starts like a unary one, with an empty REQ. Then the request
+// messages are queued and written without blocking, while the server's frames
+// (WINDOW, RESP and ERR) are read as they come, so neither side can block the other.
+// Throws std::string on transport errors (the connection is closed then).
+inline bool ProtoClient::CallBidiStreamImpl(uint32_t methodId,
+                                            google::protobuf::Message& req,
+                                            const std::function<bool()>& nextRequest,
+                                            google::protobuf::Message& resp,
+                                            const std::function<bool()>& onMessage,
+                                            const std::map<std::string, std::string>& metadata,
+                                            std::string& errMsgOut,
+                                            long timeoutMs)
+{
+    std::string errMsg;
+    std::string reqName = (methodId == 0 ? req.GetTypeName() : std::string());
+    std::string metadataData;
+    ProtoPayload reqData, respData;
+    ProtoFrameWriter writer;
+    ProtoFrameReader reader;
+    uint32_t code = 0;
+
+    if(mSeqPacket)
+    {
+        // The REQ_ID (or REQ_NAME), the empty REQ and METADATA in one record
+        if(methodId != 0)
+        {
+            writer.AddInteger(PROTO_CODE::REQ_ID);
+            writer.AddInteger(methodId);
+        }
+        else
+        {
+            writer.AddData(PROTO_CODE::REQ_NAME, reqName);
+        }
+        metadataData = EncodeMetadata(metadata);
+        writer.AddData(PROTO_CODE::REQ, reqData);
+        writer.AddData(PROTO_CODE::METADATA, metadataData);
+        if(!gen::ProtoSendFrames(mSocket, writer, timeoutMs, errMsg))
+            throw std::string("Failed to send REQ (request data): ") + errMsg;
+    }
+    else
+    {
+        if(methodId != 0)
+        {
+            // Sent the REQ_ID (method id)
+            if(!gen::ProtoSendCode(mSocket, PROTO_CODE::REQ_ID, timeoutMs, errMsg) ||
+               !gen::ProtoSendInteger(mSocket, methodId, timeoutMs, errMsg))
+                throw std::string("Failed to send REQ_ID (method id): ") + errMsg;
+        }
+        else
+        {
+            // Sent the REQ_NAME (request name)
+            if(!gen::ProtoSendData(mSocket, PROTO_CODE::REQ_NAME, reqName, timeoutMs, errMsg))
+                throw std::string("Failed to send REQ_NAME (request name): ") + errMsg;
+        }
+
+        // Expecting ACK or NACK back from server
+        if(!gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg))
+            throw std::string("Failed to receive ACK/NACK code: ") + errMsg;
+
+        if(code == PROTO_CODE::NACK)
+        {
+            // Receive ERR (error message)
+            if(!gen::ProtoRecvData(mSocket, PROTO_CODE::ERR, errMsgOut, timeoutMs, errMsg))
+                throw std::string("Failed to receive ERR (response value): ") + errMsg;
+            return false;
+        }
+        else if(!gen::ProtoValidateCode(code, PROTO_CODE::ACK, errMsg))
+        {
+            throw std::string("Failed to receive ACK/NACK code: ") + errMsg;
+        }
+
+        // Send the empty REQ and metadata
+        if(!gen::ProtoSendData(mSocket, PROTO_CODE::REQ, reqData, timeoutMs, errMsg) ||
+           !gen::ProtoSendData(mSocket, PROTO_CODE::METADATA, EncodeMetadata(metadata), timeoutMs, errMsg))
+            throw std::string("Failed to send REQ (request data): ") + errMsg;
+    }
+
+    // Large messages over Unix domain sockets go in a sealed memfd
+    size_t fdThreshold = (mDomainSocketPath.empty() ? NO_FD_PAYLOAD :
+                          mSeqPacket ? std::min(mFdPayloadThreshold, SEQPACKET_FD_PAYLOAD_THRESHOLD) :
+                          mFdPayloadThreshold);
+
+    // Nothing may be sent before the server grants a window
+    OutputQueue output;
+    int64_t window = 0;
+    bool ended = false;
+    while(true)
+    {
+        // Queue the next message while the window allows.
+        // Note: One message at a time, so only the message being sent is held in memory.
+        while(!ended && window > 0 && output.Empty())
+        {
+            if(!nextRequest())
+            {
+                if(mSeqPacket)
+                {
+                    writer.AddInteger(PROTO_CODE::END);
+                    if(!gen::ProtoQueueFrames(output, writer, errMsg))
+                        throw std::string("Failed to send END: ") + errMsg;
+                }
+                else
+                {
+                    gen::ProtoQueueCode(output, PROTO_CODE::END);
+                }
+                ended = true;
+                break;
+            }
+
+            // Serialize request protobuf message straight into the payload buffer
+            size_t reqSize = req.ByteSizeLong();
+            if(reqSize > PROTO_MAX_MESSAGE_SIZE)
+                throw std::string("The protobuf request message of ") + std::to_string(reqSize) + " bytes exceeds the 2 GiB limit";
+            char* buf = reqData.Allocate(reqSize, fdThreshold, errMsg);
+            if(!buf || (reqSize > 0 && !req.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf))) ||
+               !reqData.Seal(errMsg))
+                throw std::string("Failed to write protobuf request message, size=") + std::to_string(reqSize) + " " + errMsg;
+            EncodeRequest(methodId, reqData);
+
+            if(mSeqPacket)
+            {
+                writer.AddData(PROTO_CODE::REQ, reqData);
+                if(!gen::ProtoQueueFrames(output, writer, errMsg))
+                    throw std::string("Failed to send REQ (request data): ") + errMsg;
+                reqData.Clear();
+            }
+            else
+            {
+                gen::ProtoQueueData(output, PROTO_CODE::REQ, reqData);
+            }
+            window -= static_cast<int64_t>(reqSize);
+        }
+
+        // Write as much as the socket takes
+        if(!output.Flush(mSocket, errMsg))
+            throw std::string("Failed to send REQ (request data): ") + errMsg;
+
+        // Wait for the server's next frame or for the socket to take more,
+        // unless the next message can be sent already
+        if(!mSeqPacket || reader.IsEnd())
+        {
+            bool canSend = (!ended && window > 0 && output.Empty());
+            if(!canSend && !gen::WaitSocket(mSocket, POLLIN | (output.Empty() ? 0 : POLLOUT), timeoutMs, errMsg))
+                throw std::string("Failed to receive RESP/ERR code: ") + errMsg;
+            if(!gen::IsReadable(mSocket))
+                continue;
+        }
+
+        // Note: SOCK_SEQPACKET records hold one frame, except NACK and ERR
+        if(mSeqPacket ? !((!reader.IsEnd() || gen::ProtoRecvFrames(mSocket, reader, timeoutMs, errMsg)) &&
+                          reader.ReadInteger(code, errMsg)) :
+                        !gen::ProtoRecvInteger(mSocket, code, timeoutMs, errMsg))
+            throw std::string("Failed to receive RESP/ERR code: ") + errMsg;
+
+        if(code == PROTO_CODE::WINDOW)
+        {
+            uint32_t bytes = 0;
+            if(mSeqPacket ? !reader.ReadInteger(bytes, errMsg) : !gen::ProtoRecvInteger(mSocket, bytes, timeoutMs, errMsg))
+                throw std::string("Failed to receive WINDOW: ") + errMsg;
+            window += bytes;
+        }
+        else if(code == PROTO_CODE::RESP)
+        {
+            if(mSeqPacket)
+                reader.Rewind(sizeof(uint32_t));
+            if(mSeqPacket ? !reader.ReadData(PROTO_CODE::RESP, respData, errMsg, Decompression()) :
+                            !gen::ProtoRecvPayload(mSocket, respData, timeoutMs, errMsg, Decompression()))
+                throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+
+            // Create protobuf message from the response data (in place if it's a mapped memfd)
+            if(respData.size() > INT_MAX || !resp.ParseFromArray(respData.data(), static_cast<int>(respData.size())))
+                throw std::string("Failed to parse response data into protobuf message ") +
+                         resp.GetTypeName() + " with size: " + std::to_string(respData.size());
+
+            // Note: Closing the connection stops the server
+            if(!onMessage())
+                throw std::string("Cancelled by the caller");
+        }
+        else if(code == PROTO_CODE::NACK || code == PROTO_CODE::ERR)
+        {
+            // Receive ERR (error message)
+            if(mSeqPacket ? !((code == PROTO_CODE::ERR || reader.ReadCode(PROTO_CODE::ERR, errMsg)) &&
+                              reader.ReadPayload(errMsgOut, errMsg)) :
+                            !gen::ProtoRecvPayload(mSocket, errMsgOut, timeoutMs, errMsg))
+                throw std::string("Failed to receive ERR (response value): ") + errMsg;
+
+            // Note: Only SOCK_SEQPACKET calls get NACK here; nothing is sent before WINDOW
+            if(code == PROTO_CODE::NACK)
+                return false;
+            break;
+        }
+        else
+        {
+            throw std::string("Failed to receive RESP/ERR code, received ") + std::to_string(code) + " instead";
+        }
+    }
+
+    // The server has ended the call: end the request stream too (the server skips the rest of it)
+    if(!ended)
+    {
+        if(mSeqPacket)
+        {
+            writer.AddInteger(PROTO_CODE::END);
+            if(!gen::ProtoQueueFrames(output, writer, errMsg))
+                throw std::string("Failed to send END: ") + errMsg;
+        }
+        else
+        {
+            gen::ProtoQueueCode(output, PROTO_CODE::END);
+        }
+    }
+
+    while(!output.Empty())
+    {
+        if(!output.Flush(mSocket, errMsg) ||
+           (!output.Empty() && !gen::WaitSocket(mSocket, POLLOUT, timeoutMs, errMsg)))
+            throw std::string("Failed to send END: ") + errMsg;
+    }
+    return true;
+}
+
+// The whole request is written to the ring at once, without waiting for ACK.
+// Throws std::string on transport errors (the connection is closed then).
+inline bool ProtoClient::ShmCall(uint32_t methodId,
+                                 const std::string& reqName,
+                                 const std::string& reqData,
+                                 Response& resp,
+                                 const std::map<std::string, std::string>& metadata,
+                                 const std::function<bool()>* onMessage,
+                                 std::string& errMsgOut,
+                                 long timeoutMs)
+{
+    std::string errMsg;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+
+    std::string metadataData = EncodeMetadata(metadata);
+
+    ProtoFrameWriter writer;
+    if(methodId != 0)
+    {
+        writer.AddInteger(PROTO_CODE::REQ_ID);
+        writer.AddInteger(methodId);
+    }
+    else
+    {
+        writer.AddData(PROTO_CODE::REQ_NAME, reqName);
+    }
+    writer.AddData(PROTO_CODE::REQ, reqData);
+    writer.AddData(PROTO_CODE::METADATA, metadataData);
+
+    if(!gen::ShmSendFrames(mShm->Requests(), writer, deadline, nullptr, errMsg))
+        throw std::string("Failed to send REQ (request data): ") + errMsg;
+
+    // Expecting RESP or NACK back from server
+    ShmRing& responses = mShm->Responses();
+    uint32_t code = 0;
+    if(!gen::ShmRecvInteger(responses, code, deadline, nullptr, errMsg))
+        throw std::string("Failed to receive RESP/NACK code: ") + errMsg;
+
+    if(code == PROTO_CODE::NACK)
+    {
+        // Receive ERR (error message)
+        if(!gen::ShmRecvData(responses, PROTO_CODE::ERR, errMsgOut, deadline, nullptr, errMsg))
+            throw std::string("Failed to receive ERR (response value): ") + errMsg;
+        return false;
+    }
+    else if(code != PROTO_CODE::ERR || !onMessage)
+    {
+        if(!gen::ProtoValidateCode(code, PROTO_CODE::RESP, errMsg))
+            throw std::string("Failed to receive RESP/NACK code: ") + errMsg;
+    }
+
+    // Server streaming: RESP frames until ERR ends the stream
+    std::string respData;
+    if(onMessage)
+    {
+        while(code == PROTO_CODE::RESP)
+        {
+            if(!gen::ShmRecvPayload(responses, respData, deadline, nullptr, errMsg))
+                throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+            resp.Set(respData);
+
+            // Note: Closing the connection stops the server
+            if(!(*onMessage)())
+                throw std::string("Cancelled by the caller");
+
+            // Note: timeoutMs applies to each message
+            deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+            if(!gen::ShmRecvInteger(responses, code, deadline, nullptr, errMsg))
+                throw std::string("Failed to receive RESP/ERR code: ") + errMsg;
+        }
+
+        // Receive ERR (error message)
+        if(!gen::ProtoValidateCode(code, PROTO_CODE::ERR, errMsg) ||
+           !gen::ShmRecvPayload(responses, errMsgOut, deadline, nullptr, errMsg))
+            throw std::string("Failed to receive ERR (response value): ") + errMsg;
+        return true;
+    }
+
+    // Receive RESP (response data) and ERR (error message)
+    if(!gen::ShmRecvPayload(responses, respData, deadline, nullptr, errMsg))
+        throw std::string("Failed to receive RESP (respData data): ") + errMsg;
+
+    if(!gen::ShmRecvData(responses, PROTO_CODE::ERR, errMsgOut, deadline, nullptr, errMsg))
+        throw std::string("Failed to receive ERR (response value): ") + errMsg;
+
+    resp.Set(respData);
+    return true;
+}
+
 // No metadata call
 inline bool ProtoClient::Call(const google::protobuf::Message& req,
                               google::protobuf::Message& resp,
@@ -5,9 +5,18 @@
 #define __PROTO_COMMON_HPP__
 
 #include "socketCommon.hpp"
+#include "compression.hpp"
+#include "crc32c.hpp"
+#include "metadataTable.hpp"
+#include <sys/mman.h>   // memfd_create(), mmap()
+#include <sys/stat.h>   // fstat()
+#include <fcntl.h>      // F_ADD_SEALS
+#include <endian.h>     // htobe64()
 #include <string>
 #include <map>
 #include <cstring>  // std::memcpy
+#include <climits>  // INT_MAX
+#include <cstdio>   // snprintf()
 
 namespace gen {
 
@@ -20,7 +29,19 @@ enum PROTO_CODE : uint32_t
     REQ,
     RESP,
     METADATA,
-    ERR
+    ERR,
+    REQ_ID,
+    SHM_SETUP,
+    ATTACHMENT,
+    WINDOW,         // Request stream flow control: the server grants the client more bytes to send
+    END,            // End of the request stream
+    COMPRESSION,    // Compression setup: the codec the client asks for
+    CHECKSUM,       // Checksum setup: the payloads carry a CRC32C from now on
+    METADATA_TABLE, // Metadata table setup: its size (see metadataTable.hpp)
+    CONNECTION_METADATA, // Metadata of all the calls of the connection: the count, then a METADATA frame
+    SUBSCRIBE,      // Subscription to a topic: its name. The published messages follow as RESP frames.
+    ONEWAY,         // One-way call: the request follows (REQ_ID or REQ_NAME, REQ, METADATA), no reply
+    ONEWAY_STATUS   // The one-way calls of the connection handled and failed: ACK, then both 64-bit
 };
 
 inline const char* ProtoCodeToStr(PROTO_CODE code)
@@ -30,7 +51,28 @@ inline const char* ProtoCodeToStr(PROTO_CODE code)
             code == REQ_NAME  ? "REQ_NAME" :
             code == REQ       ? "REQ" :
             code == RESP      ? "RESP" :
-            code == ERR       ? "ERR" : "UNKNOWN");
+            code == METADATA  ? "METADATA" :
+            code == ERR       ? "ERR" :
+            code == REQ_ID    ? "REQ_ID" :
+            code == SHM_SETUP ? "SHM_SETUP" :
+            code == ATTACHMENT ? "ATTACHMENT" :
+            code == WINDOW    ? "WINDOW" :
+            code == END       ? "END" :
+            code == COMPRESSION ? "COMPRESSION" :
+            code == CHECKSUM  ? "CHECKSUM" :
+            code == METADATA_TABLE ? "METADATA_TABLE" :
+            code == CONNECTION_METADATA ? "CONNECTION_METADATA" :
+            code == SUBSCRIBE ? "SUBSCRIBE" :
+            code == ONEWAY    ? "ONEWAY" :
+            code == ONEWAY_STATUS ? "ONEWAY_STATUS" : "UNKNOWN");
+}
+
+// Compile-time method id (32-bit FNV-1a hash) of a full method name
+// such as "/package.Service/Method". Sent as REQ_ID instead of REQ_NAME
+// by the stubs generated with protoc-gen-protorpc.
+constexpr uint32_t MethodId(const char* name, uint32_t hash = 2166136261u)
+{
+    return (*name == '\0') ? hash : MethodId(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u);
 }
 
 inline bool ProtoSend(int sock, const void* buf, size_t len, long timeout_ms, std::string& errMsg)
@@ -93,6 +135,85 @@ inline bool ProtoRecvCode(int sock, PROTO_CODE code, long timeout_ms, std::strin
     return true;
 }
 
+// Data length marker: the payload is 4 GiB or more, so its 64-bit length follows
+// (network byte order). Shorter payloads keep the 32-bit length.
+const uint32_t PROTO_LONG_PAYLOAD = 0xFFFFFFFE;
+
+// Payloads are received in segments of this size into a buffer reserved at once:
+// each segment is zeroed (resize()) right before the socket fills it, instead of
+// the whole multi-GiB buffer upfront
+const size_t PROTO_SEGMENT_SIZE = 1024 * 1024;
+
+// Protobuf messages are limited to 2 GiB. Larger data goes as raw payloads,
+// attachments or streams.
+const size_t PROTO_MAX_MESSAGE_SIZE = INT_MAX;
+
+// Received payloads with a longer length frame are refused before anything is
+// allocated (see ProtoServer::SetMaxRequestSize())
+const size_t DEFAULT_MAX_REQUEST_SIZE = PROTO_MAX_MESSAGE_SIZE;
+const uint64_t PROTO_NO_MAX_LENGTH = UINT64_MAX;
+
+// Send the data length: 32-bit, or the PROTO_LONG_PAYLOAD marker and the 64-bit length
+inline bool ProtoSendLength(int sock, uint64_t len, long timeout_ms, std::string& errMsg)
+{
+    if(len < PROTO_LONG_PAYLOAD)
+        return gen::ProtoSendInteger(sock, static_cast<uint32_t>(len), timeout_ms, errMsg);
+
+    uint64_t data = htobe64(len);
+    return (gen::ProtoSendInteger(sock, PROTO_LONG_PAYLOAD, timeout_ms, errMsg) &&
+            gen::ProtoSend(sock, &data, sizeof(data), timeout_ms, errMsg));
+}
+
+// Complete the received 32-bit data length: after the PROTO_LONG_PAYLOAD marker
+// comes the 64-bit length. A length over maxLen is refused.
+inline bool ProtoRecvLongLength(int sock, uint32_t len32, uint64_t& len, long timeout_ms, std::string& errMsg,
+                                uint64_t maxLen = PROTO_NO_MAX_LENGTH)
+{
+    len = len32;
+    if(len32 == PROTO_LONG_PAYLOAD)
+    {
+        uint64_t data = 0;
+        if(!gen::ProtoRecv(sock, &data, sizeof(data), timeout_ms, errMsg))
+            return false;
+        len = be64toh(data);
+    }
+
+    if(len > maxLen)
+    {
+        errMsg = "Payload of " + std::to_string(len) + " bytes, the limit is " + std::to_string(maxLen);
+        return false;
+    }
+    return true;
+}
+
+// Receive len bytes into data with recv(char* buf, size_t len) -> bool,
+// segment by segment (see PROTO_SEGMENT_SIZE)
+template<class RECV>
+inline bool ProtoRecvSegments(std::string& data, uint64_t len, RECV recv, std::string& errMsg)
+{
+    data.clear();
+    try
+    {
+        data.reserve(len);
+    }
+    catch(const std::exception& ex)
+    {
+        errMsg = "Failed to allocate " + std::to_string(len) + " bytes for the payload: " + ex.what();
+        return false;
+    }
+
+    while(data.size() < len)
+    {
+        size_t offset = data.size();
+        size_t segment = std::min<uint64_t>(len - offset, PROTO_SEGMENT_SIZE);
+        data.resize(offset + segment);
+        if(!recv(data.data() + offset, segment))
+            return false;
+    }
+
+    return true;
+}
+
 inline bool ProtoSendData(int sock, PROTO_CODE code, const std::string& data, long timeout_ms, std::string& errMsg)
 {
     // Sent the data proto code
@@ -100,7 +221,7 @@ inline bool ProtoSendData(int sock, PROTO_CODE code, const std::string& data, lo
         return false;
 
     // Send the data size
-    if(!gen::ProtoSendInteger(sock, data.length(), timeout_ms, errMsg))
+    if(!gen::ProtoSendLength(sock, data.length(), timeout_ms, errMsg))
         return false;
 
     // Send the data itself (if no empty)
@@ -113,29 +234,647 @@ inline bool ProtoSendData(int sock, PROTO_CODE code, const std::string& data, lo
     return true;
 }
 
+// Receive the data itself, once its length is known.
+// If crc is given, the CRC32C of the data is computed as each segment arrives.
+inline bool ProtoRecvPayloadData(int sock, std::string& data, uint64_t len, long timeout_ms, std::string& errMsg,
+                                 uint32_t* crc = nullptr)
+{
+    return gen::ProtoRecvSegments(data, len, [&](char* buf, size_t segment)
+    {
+        if(!gen::ProtoRecv(sock, buf, segment, timeout_ms, errMsg))
+            return false;
+        if(crc)
+            *crc = gen::Crc32c(buf, segment, *crc);
+        return true;
+    }, errMsg);
+}
+
+// Compare the CRC32C received after the data with the one computed
+inline bool ProtoValidateChecksum(uint32_t received, uint32_t computed, std::string& errMsg)
+{
+    if(received == computed)
+        return true;
+
+    char buf[96];
+    snprintf(buf, sizeof(buf), "CRC32C mismatch: received 0x%08x, computed 0x%08x. The data is corrupted", received, computed);
+    errMsg = buf;
+    return false;
+}
+
+inline bool ProtoRecvChecksum(int sock, uint32_t computed, long timeout_ms, std::string& errMsg)
+{
+    uint32_t received = 0;
+    return (gen::ProtoRecvInteger(sock, received, timeout_ms, errMsg) &&
+            gen::ProtoValidateChecksum(received, computed, errMsg));
+}
+
+// Receive the data length and the data itself (the data code is already received)
+inline bool ProtoRecvPayload(int sock, std::string& data, long timeout_ms, std::string& errMsg,
+                             uint64_t maxLen = PROTO_NO_MAX_LENGTH)
+{
+    // Receive the data length
+    uint32_t len32 = 0;
+    uint64_t len = 0;
+    if(!gen::ProtoRecvInteger(sock, len32, timeout_ms, errMsg) ||
+       !gen::ProtoRecvLongLength(sock, len32, len, timeout_ms, errMsg, maxLen))
+        return false;
+
+    // Receive the data (if available)
+    return gen::ProtoRecvPayloadData(sock, data, len, timeout_ms, errMsg);
+}
+
 inline bool ProtoRecvData(int sock, PROTO_CODE code, std::string& data, long timeout_ms, std::string& errMsg)
 {
     // Receive the data code
     if(!gen::ProtoRecvCode(sock, code, timeout_ms, errMsg))
         return false;
 
-    // Receive the data length
-    uint32_t len = 0;
-    if(!gen::ProtoRecvInteger(sock, len, timeout_ms, errMsg))
+    // Receive the data length and the data
+    return gen::ProtoRecvPayload(sock, data, timeout_ms, errMsg);
+}
+
+// Data length marker: the data is in a sealed memfd passed with SCM_RIGHTS
+// (Unix domain sockets only), together with its real 64-bit length
+const uint32_t PROTO_FD_PAYLOAD = 0xFFFFFFFF;
+const size_t DEFAULT_FD_PAYLOAD_THRESHOLD = 1024 * 1024;    // Bytes
+const size_t NO_FD_PAYLOAD = SIZE_MAX;                      // Threshold to never use memfd
+const size_t SEQPACKET_FD_PAYLOAD_THRESHOLD = 64 * 1024;    // SOCK_SEQPACKET records must fit in the socket buffer
+
+// Data length marker: the data is compressed. The codec (32-bit) and the
+// uncompressed length (64-bit) follow, then the compressed data with its length.
+const uint32_t PROTO_COMPRESSED_PAYLOAD = 0xFFFFFFFD;
+
+// Compressed payloads larger than this decompressed are refused (see ProtoDecompression)
+const size_t DEFAULT_MAX_DECOMPRESSED_SIZE = 64 * 1024 * 1024;
+
+// What a receiver takes of compressed payloads: the codecs of the compression
+// negotiated on the connection (CodecMask()), and the largest decompressed size.
+// By default compressed payloads are refused.
+struct ProtoDecompression
+{
+    uint32_t codecs{0};
+    size_t maxSize{DEFAULT_MAX_DECOMPRESSED_SIZE};
+};
+
+// Data length marker: the payload has a checksum. Its frames follow as they are
+// (the length, or the PROTO_COMPRESSED_PAYLOAD marker...) and the data, then the
+// CRC32C of the data as sent (32-bit). A corrupted length is detected too: the
+// CRC is read from the wrong place then.
+const uint32_t PROTO_CHECKSUM_PAYLOAD = 0xFFFFFFFC;
+const uint32_t PROTO_CHECKSUM_CRC32C = 1;  // CHECKSUM setup: the checksum type
+
+// Client-streaming calls: request bytes the client may send ahead of the handler
+const size_t DEFAULT_STREAM_WINDOW = 1024 * 1024;
+
+//
+// File attachment: a file range a handler sends after its response message
+// (see ProtoServer::Context::AttachFile()). On stream sockets it follows the
+// RESP frame as ATTACHMENT, a 64-bit length and the raw bytes, sent with
+// sendfile(); on SOCK_SEQPACKET sockets it goes in the record as ATTACHMENT
+// data (in a memfd if large).
+//
+struct ProtoFileRange
+{
+    int fd{-1};         // Owned
+    off_t offset{0};
+    size_t length{0};
+};
+
+// Client side: where to receive the attachment of a response. Either a
+// caller-provided buffer, or a file (written at its current offset).
+struct ProtoAttachment
+{
+    ProtoAttachment(char* _buffer, size_t _capacity) : buffer(_buffer), capacity(_capacity) {}
+    explicit ProtoAttachment(int _fd) : fd(_fd) {}
+
+    char* buffer{nullptr};
+    size_t capacity{0};
+    int fd{-1};
+    size_t size{0};     // Out: the attachment size (0 if the response has none)
+};
+
+//
+// Request or response data: in memory, or (for large messages over Unix domain
+// sockets) in a memfd. The sender serializes straight into the memfd and seals it;
+// the receiver maps it read-only and parses in place, so the data isn't copied
+// through the socket buffers.
+//
+class ProtoPayload
+{
+public:
+    ProtoPayload() = default;
+    ~ProtoPayload() { Clear(); }
+    ProtoPayload(const ProtoPayload&) = delete;
+    ProtoPayload& operator=(const ProtoPayload&) = delete;
+
+    const char* data() const { return (mMem ? static_cast<const char*>(mMem) : mShared ? mShared->data() : mStr.data()); }
+    size_t size() const { return (mMem || mFd != -1 ? mMemSize : mShared ? mShared->size() : mStr.size()); }
+    std::string& str() { return mStr; }
+    const std::string& str() const { return mStr; }
+
+    // Sender: a sealed memfd to pass with SCM_RIGHTS (receiver: the memfd it's mapped from)
+    bool IsFd() const { return (mFd != -1); }
+    int GetFd() const { return mFd; }
+
+    // Sender: writable buffer of size bytes, in a memfd if size >= fdThreshold
+    char* Allocate(size_t size, size_t fdThreshold, std::string& errMsg);
+
+    // Sender: done writing. The memfd is sealed, so the receiver can
+    // parse it in place without the data changing under it.
+    bool Seal(std::string& errMsg);
+
+    // Receiver: map the memfd read-only (takes ownership of fd). The memfd is
+    // kept, so the payload can be passed on as it is (see ProtoProxy).
+    bool Map(int fd, size_t size, std::string& errMsg);
+
+    // Sender: read length bytes of the file at offset, into a memfd if length >= fdThreshold.
+    // The memfd is filled in the kernel (sendfile()) and sealed.
+    bool ReadFile(int fd, off_t offset, size_t length, size_t fdThreshold, std::string& errMsg);
+
+    // Sender: give up the sealed memfd (e.g. to an OutputQueue)
+    int ReleaseFd()
+    {
+        if(mMem)
+            munmap(mMem, mMemSize);
+        int fd = mFd;
+        mMem = nullptr;
+        mFd = -1;
+        mMemSize = 0;
+        return fd;
+    }
+
+    // Server: send a buffer shared with others (e.g. a cached response), queued by reference
+    void Share(std::shared_ptr<const std::string> data)
+    {
+        Clear();
+        mShared = std::move(data);
+    }
+    const std::shared_ptr<const std::string>& GetShared() const { return mShared; }
+
+    void Swap(ProtoPayload& other)
+    {
+        mStr.swap(other.mStr);
+        mShared.swap(other.mShared);
+        std::swap(mFd, other.mFd);
+        std::swap(mMem, other.mMem);
+        std::swap(mMemSize, other.mMemSize);
+        std::swap(mCodec, other.mCodec);
+        std::swap(mRawSize, other.mRawSize);
+        std::swap(mChecksum, other.mChecksum);
+    }
+
+    // Sender: compress the data (in memory) with codec, unless it doesn't get smaller.
+    // The compressed data is sent with the PROTO_COMPRESSED_PAYLOAD marker.
+    bool Compress(Codec codec, std::string& errMsg);
+    Codec GetCodec() const { return mCodec; }
+    size_t GetRawSize() const { return mRawSize; }
+
+    // Receiver: the decompressed data, if the codec and the size are accepted
+    bool Decompress(Codec codec, const char* data, size_t size, size_t rawSize,
+                    const ProtoDecompression& decompression, std::string& errMsg);
+
+    // Sender: send the data (in memory) with its CRC32C, with the PROTO_CHECKSUM_PAYLOAD marker
+    void SetChecksum(bool checksum) { mChecksum = (checksum && mFd == -1); }
+    bool HasChecksum() const { return mChecksum; }
+
+    void Clear();
+
+private:
+    std::string mStr;
+    std::shared_ptr<const std::string> mShared;     // Instead of mStr
+    int mFd{-1};
+    void* mMem{nullptr};
+    size_t mMemSize{0};
+    Codec mCodec{Codec::NONE};  // mStr is compressed with mCodec
+    size_t mRawSize{0};
+    bool mChecksum{false};
+};
+
+inline void ProtoPayload::Clear()
+{
+    if(mMem)
+        munmap(mMem, mMemSize);
+    if(mFd != -1)
+        close(mFd);
+    mMem = nullptr;
+    mFd = -1;
+    mMemSize = 0;
+    mStr.clear();
+    mShared.reset();
+    mCodec = Codec::NONE;
+    mRawSize = 0;
+    mChecksum = false;
+}
+
+inline bool ProtoPayload::Compress(Codec codec, std::string& errMsg)
+{
+    if(codec == Codec::NONE || mFd != -1 || mCodec != Codec::NONE)
+        return true;
+
+    std::string data;
+    if(!gen::Compress(codec, this->data(), size(), data, errMsg))
         return false;
 
-    // Receive the data (if available)
-    data.clear();
-    if(len > 0)
+    if(data.size() < size())
+    {
+        mRawSize = size();
+        mCodec = codec;
+        mStr.swap(data);
+        mShared.reset();
+    }
+    return true;
+}
+
+inline bool ProtoPayload::Decompress(Codec codec, const char* data, size_t size, size_t rawSize,
+                                     const ProtoDecompression& decompression, std::string& errMsg)
+{
+    Clear();
+
+    // Only the compression negotiated on the connection is expected
+    if(!(decompression.codecs & gen::CodecMask(codec)))
+    {
+        errMsg = std::string("Unexpected payload compressed with ") + gen::CodecToStr(codec) +
+                 ": not negotiated on the connection";
+        return false;
+    }
+
+    // Note: Compressed payloads are protobuf messages. The length comes from the peer:
+    // it can't be more than the data decompresses to at most.
+    if(rawSize > PROTO_MAX_MESSAGE_SIZE || rawSize > decompression.maxSize ||
+       rawSize > gen::MaxDecompressedSize(codec, size))
+    {
+        errMsg = "Invalid compressed payload of " + std::to_string(size) + " bytes, " +
+                 std::to_string(rawSize) + " bytes decompressed";
+        return false;
+    }
+
+    return gen::Decompress(codec, data, size, mStr, rawSize, errMsg);
+}
+
+inline char* ProtoPayload::Allocate(size_t size, size_t fdThreshold, std::string& errMsg)
+{
+    Clear();
+
+    if(size == 0 || size < fdThreshold)
+    {
+        mStr.resize(size);
+        return mStr.data();
+    }
+
+    mFd = memfd_create("protorpc-payload", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(mFd == -1)
+    {
+        errMsg = "memfd_create() failed: " + std::string(strerror(errno));
+        return nullptr;
+    }
+
+    mMemSize = size;
+    if(ftruncate(mFd, size) == -1 ||
+       (mMem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mFd, 0)) == MAP_FAILED)
+    {
+        errMsg = "Failed to allocate memfd payload of " + std::to_string(size) + " bytes: " + strerror(errno);
+        mMem = nullptr;
+        Clear();
+        return nullptr;
+    }
+
+    return static_cast<char*>(mMem);
+}
+
+inline bool ProtoPayload::ReadFile(int fd, off_t offset, size_t length, size_t fdThreshold, std::string& errMsg)
+{
+    Clear();
+
+    if(length < fdThreshold)
+    {
+        mStr.resize(length);
+        for(size_t done = 0; done < length; )
+        {
+            ssize_t res = pread(fd, mStr.data() + done, length - done, offset + done);
+            if(res <= 0)
+            {
+                if(res == -1 && errno == EINTR)
+                    continue;
+                errMsg = "Failed to read " + std::to_string(length) + " bytes of the file: " +
+                         (res == 0 ? "unexpected end of file" : strerror(errno));
+                Clear();
+                return false;
+            }
+            done += res;
+        }
+        return true;
+    }
+
+    mFd = memfd_create("protorpc-attachment", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(mFd == -1)
+    {
+        errMsg = "memfd_create() failed: " + std::string(strerror(errno));
+        return false;
+    }
+
+    mMemSize = length;
+    for(size_t done = 0; done < length; )
+    {
+        ssize_t res = sendfile(mFd, fd, &offset, length - done);
+        if(res <= 0)
+        {
+            if(res == -1 && errno == EINTR)
+                continue;
+            errMsg = "Failed to copy " + std::to_string(length) + " bytes of the file: " +
+                     (res == 0 ? "unexpected end of file" : strerror(errno));
+            Clear();
+            return false;
+        }
+        done += res;
+    }
+
+    return Seal(errMsg);
+}
+
+inline bool ProtoPayload::Seal(std::string& errMsg)
+{
+    if(mFd == -1)
+        return true;
+
+    // Note: F_SEAL_WRITE requires no writable mappings
+    if(mMem)
+        munmap(mMem, mMemSize);
+    mMem = nullptr;
+
+    if(fcntl(mFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1)
+    {
+        errMsg = "Failed to seal memfd payload: " + std::string(strerror(errno));
+        Clear();
+        return false;
+    }
+
+    return true;
+}
+
+inline bool ProtoPayload::Map(int fd, size_t size, std::string& errMsg)
+{
+    Clear();
+
+    // Only accept sealed memfds: the sender can't modify or truncate them anymore
+    struct stat st;
+    int seals = fcntl(fd, F_GET_SEALS);
+    if(size == 0 || seals == -1 || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK)) != (F_SEAL_WRITE | F_SEAL_SHRINK) ||
+       fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) < size)
+    {
+        errMsg = "Invalid memfd payload of " + std::to_string(size) + " bytes";
+        close(fd);
+        return false;
+    }
+
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if(mem == MAP_FAILED)
+    {
+        errMsg = "mmap() failed: " + std::string(strerror(errno));
+        close(fd);
+        return false;
+    }
+
+    mFd = fd;
+    mMem = mem;
+    mMemSize = size;
+    return true;
+}
+
+inline bool ProtoSendData(int sock, PROTO_CODE code, const ProtoPayload& payload, long timeout_ms, std::string& errMsg)
+{
+    if(payload.IsFd())
+    {
+        // Send the code, the memfd marker and then the memfd with the real length
+        int fd = payload.GetFd();
+        uint64_t len = htobe64(payload.size());
+        return (gen::ProtoSendCode(sock, code, timeout_ms, errMsg) &&
+                gen::ProtoSendInteger(sock, PROTO_FD_PAYLOAD, timeout_ms, errMsg) &&
+                gen::SendFds(sock, &fd, 1, &len, sizeof(len), errMsg));
+    }
+
+    Codec codec = payload.GetCodec();
+    bool checksum = payload.HasChecksum();
+    if(codec == Codec::NONE && !checksum && !payload.GetShared())
+        return gen::ProtoSendData(sock, code, payload.str(), timeout_ms, errMsg);
+
+    // The code, the checksum marker, the compressed marker with the codec and the
+    // uncompressed length, the length and the data, then the CRC32C
+    uint64_t rawSize = htobe64(payload.GetRawSize());
+    return (gen::ProtoSendCode(sock, code, timeout_ms, errMsg) &&
+            (!checksum || gen::ProtoSendInteger(sock, PROTO_CHECKSUM_PAYLOAD, timeout_ms, errMsg)) &&
+            (codec == Codec::NONE ||
+             (gen::ProtoSendInteger(sock, PROTO_COMPRESSED_PAYLOAD, timeout_ms, errMsg) &&
+              gen::ProtoSendInteger(sock, static_cast<uint32_t>(codec), timeout_ms, errMsg) &&
+              gen::ProtoSend(sock, &rawSize, sizeof(rawSize), timeout_ms, errMsg))) &&
+            gen::ProtoSendLength(sock, payload.size(), timeout_ms, errMsg) &&
+            (payload.size() == 0 || gen::ProtoSend(sock, payload.data(), payload.size(), timeout_ms, errMsg)) &&
+            (!checksum || gen::ProtoSendInteger(sock, gen::Crc32c(payload.data(), payload.size()), timeout_ms, errMsg)));
+}
+
+// Receive the data length and the data (after its code)
+inline bool ProtoRecvPayload(int sock, ProtoPayload& payload, long timeout_ms, std::string& errMsg,
+                             const ProtoDecompression& decompression = ProtoDecompression(),
+                             uint64_t maxLen = PROTO_NO_MAX_LENGTH)
+{
+    payload.Clear();
+
+    uint32_t len32 = 0;
+    if(!gen::ProtoRecvInteger(sock, len32, timeout_ms, errMsg))
+        return false;
+
+    // Checksum: the usual frames follow, then the CRC32C of the data
+    bool checksum = (len32 == PROTO_CHECKSUM_PAYLOAD);
+    uint32_t crc = 0;
+    uint32_t* dataCrc = (checksum ? &crc : nullptr);
+    if(checksum && !gen::ProtoRecvInteger(sock, len32, timeout_ms, errMsg))
+        return false;
+
+    if(len32 == PROTO_FD_PAYLOAD && checksum)
+    {
+        errMsg = "Unexpected checksum of a memfd payload";
+        return false;
+    }
+    else if(len32 == PROTO_FD_PAYLOAD)
+    {
+        // Receive the memfd and map it
+        int fd = -1;
+        size_t fdsCount = 1;
+        uint64_t len64 = 0;
+        return (gen::RecvFds(sock, &fd, fdsCount, &len64, sizeof(len64), timeout_ms, errMsg) &&
+                payload.Map(fd, be64toh(len64), errMsg));
+    }
+
+    if(len32 == PROTO_COMPRESSED_PAYLOAD)
+    {
+        // Receive the codec, the uncompressed length and the compressed data, and decompress it
+        uint32_t codec = 0;
+        uint64_t rawSize = 0, len = 0;
+        std::string data;
+        if(!gen::ProtoRecvInteger(sock, codec, timeout_ms, errMsg) ||
+           !gen::ProtoRecv(sock, &rawSize, sizeof(rawSize), timeout_ms, errMsg) ||
+           !gen::ProtoRecvInteger(sock, len32, timeout_ms, errMsg) ||
+           !gen::ProtoRecvLongLength(sock, len32, len, timeout_ms, errMsg, maxLen) ||
+           !gen::ProtoRecvPayloadData(sock, data, len, timeout_ms, errMsg, dataCrc) ||
+           (checksum && !gen::ProtoRecvChecksum(sock, crc, timeout_ms, errMsg)))
+            return false;
+        return payload.Decompress(static_cast<Codec>(codec), data.data(), data.size(), be64toh(rawSize),
+                                  decompression, errMsg);
+    }
+
+    // Receive the data
+    uint64_t len = 0;
+    return (gen::ProtoRecvLongLength(sock, len32, len, timeout_ms, errMsg, maxLen) &&
+            gen::ProtoRecvPayloadData(sock, payload.str(), len, timeout_ms, errMsg, dataCrc) &&
+            (!checksum || gen::ProtoRecvChecksum(sock, crc, timeout_ms, errMsg)));
+}
+
+inline bool ProtoRecvData(int sock, PROTO_CODE code, ProtoPayload& payload, long timeout_ms, std::string& errMsg,
+                          const ProtoDecompression& decompression = ProtoDecompression())
+{
+    payload.Clear();
+    return (gen::ProtoRecvCode(sock, code, timeout_ms, errMsg) &&
+            gen::ProtoRecvPayload(sock, payload, timeout_ms, errMsg, decompression));
+}
+
+//
+// Queue frames to a connection's OutputQueue: the nonblocking counterparts of
+// ProtoSendCode()/ProtoSendData() used by the server (see EpollServerT)
+//
+inline void ProtoQueueInteger(OutputQueue& queue, uint32_t value)
+{
+    uint32_t data = htonl(value);
+    queue.Add(&data, sizeof(data));
+}
+
+inline void ProtoQueueCode(OutputQueue& queue, PROTO_CODE code)
+{
+    gen::ProtoQueueInteger(queue, code);
+}
+
+inline void ProtoQueueLength(OutputQueue& queue, uint64_t len)
+{
+    if(len < PROTO_LONG_PAYLOAD)
+        return gen::ProtoQueueInteger(queue, static_cast<uint32_t>(len));
+
+    gen::ProtoQueueInteger(queue, PROTO_LONG_PAYLOAD);
+    uint64_t data = htobe64(len);
+    queue.Add(&data, sizeof(data));
+}
+
+// Note: The data is moved to the queue
+inline void ProtoQueueData(OutputQueue& queue, PROTO_CODE code, std::string&& data)
+{
+    gen::ProtoQueueCode(queue, code);
+    gen::ProtoQueueLength(queue, data.length());
+    if(data.length() > 0)
+        queue.Add(std::move(data));
+}
+
+// Note: The payload data (or memfd) is moved to the queue
+inline void ProtoQueueData(OutputQueue& queue, PROTO_CODE code, ProtoPayload& payload)
+{
+    if(payload.IsFd())
+    {
+        // The code and the memfd marker, then the memfd with the real length
+        gen::ProtoQueueCode(queue, code);
+        gen::ProtoQueueInteger(queue, PROTO_FD_PAYLOAD);
+        uint64_t len = htobe64(payload.size());
+        int fd = payload.ReleaseFd();
+        queue.AddWithFds(&len, sizeof(len), &fd, 1);
+        return;
+    }
+
+    Codec codec = payload.GetCodec();
+    bool checksum = payload.HasChecksum();
+    if(codec == Codec::NONE && !checksum && !payload.GetShared())
+        return gen::ProtoQueueData(queue, code, std::move(payload.str()));
+
+    // The code, the checksum marker, the compressed marker with the codec and the
+    // uncompressed length, the length and the data (by reference if it's shared),
+    // then the CRC32C
+    gen::ProtoQueueCode(queue, code);
+    if(checksum)
+        gen::ProtoQueueInteger(queue, PROTO_CHECKSUM_PAYLOAD);
+    if(codec != Codec::NONE)
+    {
+        gen::ProtoQueueInteger(queue, PROTO_COMPRESSED_PAYLOAD);
+        gen::ProtoQueueInteger(queue, static_cast<uint32_t>(codec));
+        uint64_t rawSize = htobe64(payload.GetRawSize());
+        queue.Add(&rawSize, sizeof(rawSize));
+    }
+    gen::ProtoQueueLength(queue, payload.size());
+    uint32_t crc = (checksum ? gen::Crc32c(payload.data(), payload.size()) : 0);
+    if(payload.size() > 0 && payload.GetShared())
+        queue.Add(payload.GetShared());
+    else if(payload.size() > 0)
+        queue.Add(std::move(payload.str()));
+    if(checksum)
+        gen::ProtoQueueInteger(queue, crc);
+}
+
+// Queue the file range of an attachment: ATTACHMENT, the 64-bit length and the data
+// Note: The descriptor is moved to the queue
+inline void ProtoQueueAttachment(OutputQueue& queue, ProtoFileRange& attachment)
+{
+    gen::ProtoQueueCode(queue, PROTO_CODE::ATTACHMENT);
+    uint64_t len = htobe64(attachment.length);
+    queue.Add(&len, sizeof(len));
+    queue.AddFile(attachment.fd, attachment.offset, attachment.length);
+    attachment.fd = -1;
+}
+
+// Receive the attachment data (after its ATTACHMENT code) into the buffer or the file
+inline bool ProtoRecvAttachment(int sock, ProtoAttachment& attachment, long timeout_ms, std::string& errMsg)
+{
+    uint64_t len = 0;
+    if(!gen::ProtoRecv(sock, &len, sizeof(len), timeout_ms, errMsg))
+        return false;
+    len = be64toh(len);
+
+    if(attachment.fd == -1 && len > attachment.capacity)
     {
-        // Receive the data itself
-        data.reserve(len);   // Reserve the desired capacity
-        data.resize(len);    // Set the correct size of the string
+        errMsg = "The attachment of " + std::to_string(len) + " bytes doesn't fit in the buffer of " +
+                 std::to_string(attachment.capacity) + " bytes";
+        return false;
+    }
 
-        if(!gen::ProtoRecv(sock, data.data(), len, timeout_ms, errMsg))
+    attachment.size = len;
+    if(len == 0)
+        return true;
+    return (attachment.fd != -1 ? gen::RecvToFile(sock, attachment.fd, len, timeout_ms, errMsg) :
+                                  gen::ProtoRecv(sock, attachment.buffer, len, timeout_ms, errMsg));
+}
+
+// Deliver the attachment data received in a SOCK_SEQPACKET record
+inline bool ProtoStoreAttachment(const ProtoPayload& data, ProtoAttachment& attachment, std::string& errMsg)
+{
+    if(attachment.fd == -1)
+    {
+        if(data.size() > attachment.capacity)
+        {
+            errMsg = "The attachment of " + std::to_string(data.size()) + " bytes doesn't fit in the buffer of " +
+                     std::to_string(attachment.capacity) + " bytes";
             return false;
+        }
+        memcpy(attachment.buffer, data.data(), data.size());
+    }
+    else
+    {
+        for(size_t done = 0; done < data.size(); )
+        {
+            ssize_t res = write(attachment.fd, data.data() + done, data.size() - done);
+            if(res == -1)
+            {
+                if(errno == EINTR)
+                    continue;
+                errMsg = "Failed to write the attachment: " + std::string(strerror(errno));
+                return false;
+            }
+            done += res;
+        }
     }
 
+    attachment.size = data.size();
     return true;
 }
 
@@ -270,6 +1009,462 @@ inline bool ProtoRecvData(int sock, PROTO_CODE code, std::map<std::string, std::
     return gen::ParseFromData(buffer.data(), buffer.size(), data, errMsg);
 }
 
+//
+// Protocol frames gathered into one write: a whole request or response is sent
+// as one record (SOCK_SEQPACKET) or written to a shared memory ring at once.
+// Note: The data is referenced, not copied, so it must outlive the writer.
+//
+class ProtoFrameWriter
+{
+public:
+    void AddInteger(uint32_t value)
+    {
+        mIntegers[mIntegerCount] = htonl(value);
+        Add(&mIntegers[mIntegerCount++], sizeof(uint32_t));
+    }
+
+    // 32-bit length, or the PROTO_LONG_PAYLOAD marker and the 64-bit length
+    void AddLength(uint64_t len)
+    {
+        if(len < PROTO_LONG_PAYLOAD)
+            return AddInteger(static_cast<uint32_t>(len));
+
+        AddInteger(PROTO_LONG_PAYLOAD);
+        AddInteger(static_cast<uint32_t>(len >> 32));
+        AddInteger(static_cast<uint32_t>(len));
+    }
+
+    void AddData(PROTO_CODE code, const std::string& data)
+    {
+        AddInteger(code);
+        AddLength(data.length());
+        if(!data.empty())
+            Add(data.data(), data.length());
+    }
+
+    // Large payload in a memfd: the PROTO_FD_PAYLOAD marker and the 64-bit
+    // length are followed by the descriptor passed with the record
+    void AddData(PROTO_CODE code, const ProtoPayload& payload)
+    {
+        if(payload.IsFd())
+        {
+            AddInteger(code);
+            AddInteger(PROTO_FD_PAYLOAD);
+            AddInteger(static_cast<uint32_t>(payload.size() >> 32));
+            AddInteger(static_cast<uint32_t>(payload.size()));
+            AddFd(payload.GetFd());
+            return;
+        }
+
+        // The PROTO_CHECKSUM_PAYLOAD marker, the PROTO_COMPRESSED_PAYLOAD marker with the
+        // codec and the uncompressed length, the length and the data, then the CRC32C
+        Codec codec = payload.GetCodec();
+        bool checksum = payload.HasChecksum();
+        AddInteger(code);
+        if(checksum)
+            AddInteger(PROTO_CHECKSUM_PAYLOAD);
+        if(codec != Codec::NONE)
+        {
+            AddInteger(PROTO_COMPRESSED_PAYLOAD);
+            AddInteger(static_cast<uint32_t>(codec));
+            AddInteger(static_cast<uint32_t>(payload.GetRawSize() >> 32));
+            AddInteger(static_cast<uint32_t>(payload.GetRawSize()));
+        }
+        AddLength(payload.size());
+        if(payload.size() > 0)
+            Add(payload.data(), payload.size());
+        if(checksum)
+            AddInteger(gen::Crc32c(payload.data(), payload.size()));
+    }
+
+    void AddFd(int fd) { mFds[mFdsCount++] = fd; }
+
+    const iovec* Iov() const { return mIov; }
+    int IovCount() const { return mIovCount; }
+    const int* Fds() const { return mFds; }
+    size_t FdsCount() const { return mFdsCount; }
+
+    void Clear() { mIovCount = mIntegerCount = 0; mFdsCount = 0; }
+
+private:
+    void Add(const void* data, size_t len)
+    {
+        mIov[mIovCount].iov_base = const_cast<void*>(data);
+        mIov[mIovCount++].iov_len = len;
+    }
+
+    static const int MAX_FRAMES = 8;
+    uint32_t mIntegers[MAX_FRAMES * 8];
+    iovec mIov[MAX_FRAMES * 8];
+    int mFds[MAX_FRAMES];
+    int mIntegerCount{0};
+    int mIovCount{0};
+    size_t mFdsCount{0};
+};
+
+//
+// Parse the frames of a received record
+//
+class ProtoFrameReader
+{
+public:
+    ProtoFrameReader() = default;
+    ~ProtoFrameReader() { Clear(); }
+    ProtoFrameReader(const ProtoFrameReader&) = delete;
+    ProtoFrameReader& operator=(const ProtoFrameReader&) = delete;
+
+    bool ReadInteger(uint32_t& value, std::string& errMsg)
+    {
+        if(mBuf.size() - mOffset < sizeof(uint32_t))
+        {
+            errMsg = "Unexpected end of record";
+            return false;
+        }
+
+        uint32_t data = 0;
+        memcpy(&data, mBuf.data() + mOffset, sizeof(data));
+        mOffset += sizeof(data);
+        value = ntohl(data);
+        return true;
+    }
+
+    bool ReadCode(PROTO_CODE code, std::string& errMsg)
+    {
+        uint32_t value = 0;
+        return (ReadInteger(value, errMsg) && gen::ProtoValidateCode(value, code, errMsg));
+    }
+
+    bool ReadLength(uint64_t& len, std::string& errMsg)
+    {
+        uint32_t len32 = 0, high = 0, low = 0;
+        if(!ReadInteger(len32, errMsg))
+            return false;
+
+        len = len32;
+        if(len32 != PROTO_LONG_PAYLOAD)
+            return true;
+
+        if(!ReadInteger(high, errMsg) || !ReadInteger(low, errMsg))
+            return false;
+        len = (static_cast<uint64_t>(high) << 32) | low;
+        return true;
+    }
+
+    // Read the data length and the data itself (the data code is already read)
+    bool ReadPayload(std::string& data, std::string& errMsg)
+    {
+        uint64_t len = 0;
+        if(!ReadLength(len, errMsg))
+            return false;
+
+        if(mBuf.size() - mOffset < len)
+        {
+            errMsg = "Unexpected end of record";
+            return false;
+        }
+
+        data.assign(mBuf.data() + mOffset, len);
+        mOffset += len;
+        return true;
+    }
+
+    bool ReadData(PROTO_CODE code, std::string& data, std::string& errMsg)
+    {
+        return (ReadCode(code, errMsg) && ReadPayload(data, errMsg));
+    }
+
+    bool ReadData(PROTO_CODE code, ProtoPayload& payload, std::string& errMsg,
+                  const ProtoDecompression& decompression = ProtoDecompression())
+    {
+        payload.Clear();
+        return (ReadCode(code, errMsg) && ReadPayload(payload, errMsg, decompression));
+    }
+
+    // Read the payload (after its code): see ProtoRecvPayload()
+    bool ReadPayload(ProtoPayload& payload, std::string& errMsg,
+                     const ProtoDecompression& decompression = ProtoDecompression())
+    {
+        payload.Clear();
+
+        uint32_t len = 0;
+        if(!ReadInteger(len, errMsg))
+            return false;
+
+        // Checksum: the usual frames follow, then the CRC32C of the data
+        bool checksum = (len == PROTO_CHECKSUM_PAYLOAD);
+        if(checksum && !ReadInteger(len, errMsg))
+            return false;
+
+        if(len == PROTO_FD_PAYLOAD && checksum)
+        {
+            errMsg = "Unexpected checksum of a memfd payload";
+            return false;
+        }
+        else if(len == PROTO_FD_PAYLOAD)
+        {
+            uint32_t high = 0, low = 0;
+            int fd = -1;
+            if(!ReadInteger(high, errMsg) || !ReadInteger(low, errMsg) || (fd = TakeFd(errMsg)) == -1)
+                return false;
+            return payload.Map(fd, (static_cast<uint64_t>(high) << 32) | low, errMsg);
+        }
+        else if(len == PROTO_COMPRESSED_PAYLOAD)
+        {
+            // Decompress straight from the record
+            uint32_t codec = 0, high = 0, low = 0;
+            uint64_t size = 0;
+            if(!ReadInteger(codec, errMsg) || !ReadInteger(high, errMsg) || !ReadInteger(low, errMsg) ||
+               !ReadLength(size, errMsg))
+                return false;
+            if(mBuf.size() - mOffset < size)
+            {
+                errMsg = "Unexpected end of record";
+                return false;
+            }
+            const char* data = mBuf.data() + mOffset;
+            mOffset += size;
+            return ((!checksum || ReadChecksum(data, size, errMsg)) &&
+                    payload.Decompress(static_cast<Codec>(codec), data, size,
+                                       (static_cast<uint64_t>(high) << 32) | low, decompression, errMsg));
+        }
+
+        Rewind(sizeof(uint32_t));   // Re-read the length
+        return (ReadPayload(payload.str(), errMsg) &&
+                (!checksum || ReadChecksum(payload.data(), payload.size(), errMsg)));
+    }
+
+    // Read the CRC32C that follows data, and check it
+    bool ReadChecksum(const char* data, size_t size, std::string& errMsg)
+    {
+        uint32_t crc = 0;
+        return (ReadInteger(crc, errMsg) && gen::ProtoValidateChecksum(crc, gen::Crc32c(data, size), errMsg));
+    }
+
+    // Step back to re-read the last bytes
+    void Rewind(size_t len) { mOffset -= std::min(len, mOffset); }
+
+    // Next descriptor received with the record (the caller owns it)
+    int TakeFd(std::string& errMsg)
+    {
+        if(mNextFd >= mFdsCount)
+        {
+            errMsg = "Missing file descriptor in record";
+            return -1;
+        }
+        int fd = mFds[mNextFd];
+        mFds[mNextFd++] = -1;
+        return fd;
+    }
+
+    bool IsEnd() const { return (mOffset == mBuf.size()); }
+
+    // Receive a new record (see ProtoRecvFrames())
+    bool Recv(int sock, long timeout_ms, std::string& errMsg)
+    {
+        Clear();
+        mFdsCount = MAX_SEND_FDS;
+        if(!gen::RecvRecord(sock, mBuf, mFds, mFdsCount, timeout_ms, errMsg))
+        {
+            mFdsCount = 0;
+            return false;
+        }
+        return true;
+    }
+
+    void Clear()
+    {
+        for(size_t i = mNextFd; i < mFdsCount; i++)
+            close(mFds[i]);
+        mFdsCount = mNextFd = mOffset = 0;
+        mBuf.clear();
+    }
+
+private:
+    std::string mBuf;
+    size_t mOffset{0};
+    int mFds[MAX_SEND_FDS];
+    size_t mFdsCount{0};
+    size_t mNextFd{0};
+};
+
+// SOCK_SEQPACKET: send the frames as one record
+inline bool ProtoSendFrames(int sock, ProtoFrameWriter& writer, long timeout_ms, std::string& errMsg)
+{
+    bool res = gen::SendRecord(sock, writer.Iov(), writer.IovCount(), writer.Fds(), writer.FdsCount(),
+                               timeout_ms, errMsg);
+    writer.Clear();
+    return res;
+}
+
+// SOCK_SEQPACKET: queue the frames as one record. The data is copied and
+// the descriptors are duplicated, so the writer's sources can be released.
+inline bool ProtoQueueFrames(OutputQueue& queue, ProtoFrameWriter& writer, std::string& errMsg)
+{
+    std::string record;
+    for(int i = 0; i < writer.IovCount(); i++)
+        record.append(static_cast<const char*>(writer.Iov()[i].iov_base), writer.Iov()[i].iov_len);
+
+    int fds[MAX_SEND_FDS];
+    size_t fdsCount = std::min(writer.FdsCount(), MAX_SEND_FDS);
+    for(size_t i = 0; i < fdsCount; i++)
+    {
+        if((fds[i] = fcntl(writer.Fds()[i], F_DUPFD_CLOEXEC, 0)) == -1)
+        {
+            errMsg = "fcntl(F_DUPFD_CLOEXEC) failed: " + std::string(strerror(errno));
+            while(i > 0)
+                close(fds[--i]);
+            writer.Clear();
+            return false;
+        }
+    }
+
+    queue.AddRecord(std::move(record), fds, fdsCount);
+    writer.Clear();
+    return true;
+}
+
+// SOCK_SEQPACKET: receive one record to parse the frames from
+inline bool ProtoRecvFrames(int sock, ProtoFrameReader& reader, long timeout_ms, std::string& errMsg)
+{
+    return reader.Recv(sock, timeout_ms, errMsg);
+}
+
+//
+// The framing of a connection, so the frames are handled the same way over both:
+// read from the socket as they come (stream sockets), or parsed from one record
+// received whole (SOCK_SEQPACKET)
+//
+class ProtoFrameInput
+{
+public:
+    ProtoFrameInput(int sock, bool record, long timeout_ms, const ProtoDecompression& decompression = ProtoDecompression(),
+                    uint64_t maxLen = PROTO_NO_MAX_LENGTH) :
+        mSock(sock), mRecord(record), mTimeout(timeout_ms), mDecompression(decompression), mMaxLen(maxLen) {}
+
+    bool IsRecord() const { return mRecord; }
+
+    // SOCK_SEQPACKET: receive the record of the next frames
+    bool Recv(std::string& errMsg)
+    {
+        return (!mRecord || gen::ProtoRecvFrames(mSock, mReader, mTimeout, errMsg));
+    }
+
+    bool ReadInteger(uint32_t& value, std::string& errMsg)
+    {
+        return (mRecord ? mReader.ReadInteger(value, errMsg) : gen::ProtoRecvInteger(mSock, value, mTimeout, errMsg));
+    }
+
+    // The data length and the data itself (the data code is already read)
+    bool ReadPayload(std::string& data, std::string& errMsg)
+    {
+        return (mRecord ? mReader.ReadPayload(data, errMsg) : gen::ProtoRecvPayload(mSock, data, mTimeout, errMsg, mMaxLen));
+    }
+
+    bool ReadPayload(ProtoPayload& payload, std::string& errMsg)
+    {
+        return (mRecord ? mReader.ReadPayload(payload, errMsg, mDecompression) :
+                          gen::ProtoRecvPayload(mSock, payload, mTimeout, errMsg, mDecompression, mMaxLen));
+    }
+
+    bool ReadData(PROTO_CODE code, std::string& data, std::string& errMsg)
+    {
+        return (mRecord ? mReader.ReadData(code, data, errMsg) :
+                          gen::ProtoRecvCode(mSock, code, mTimeout, errMsg) && ReadPayload(data, errMsg));
+    }
+
+    bool ReadData(PROTO_CODE code, ProtoPayload& payload, std::string& errMsg)
+    {
+        payload.Clear();
+        return (mRecord ? mReader.ReadData(code, payload, errMsg, mDecompression) :
+                          gen::ProtoRecvCode(mSock, code, mTimeout, errMsg) && ReadPayload(payload, errMsg));
+    }
+
+    // An integer with a descriptor (the caller owns it): sent together on stream
+    // sockets, the descriptor passed with the record otherwise
+    bool ReadIntegerFd(uint32_t& value, int& fd, std::string& errMsg)
+    {
+        if(mRecord)
+            return (mReader.ReadInteger(value, errMsg) && (fd = mReader.TakeFd(errMsg)) != -1);
+
+        size_t fdsCount = 1;
+        if(!gen::RecvFds(mSock, &fd, fdsCount, &value, sizeof(value), mTimeout, errMsg))
+            return false;
+        value = ntohl(value);
+        return true;
+    }
+
+private:
+    int mSock;
+    bool mRecord;
+    long mTimeout;
+    ProtoDecompression mDecompression;  // Compressed payloads accepted
+    uint64_t mMaxLen;                   // Longest payload accepted (stream sockets)
+    ProtoFrameReader mReader;
+};
+
+//
+// The counterpart of ProtoFrameInput: the frames are queued as they are added
+// (stream sockets), or gathered and queued as one record by Queue() (SOCK_SEQPACKET)
+//
+class ProtoFrameOutput
+{
+public:
+    ProtoFrameOutput(OutputQueue& queue, bool record) : mQueue(queue), mRecord(record) {}
+
+    void AddInteger(uint32_t value)
+    {
+        if(mRecord)
+            mWriter.AddInteger(value);
+        else
+            gen::ProtoQueueInteger(mQueue, value);
+    }
+
+    // Note: The data is moved to the queue, or referenced until Queue()
+    void AddData(PROTO_CODE code, std::string& data)
+    {
+        if(mRecord)
+            mWriter.AddData(code, data);
+        else
+            gen::ProtoQueueData(mQueue, code, std::move(data));
+    }
+
+    void AddData(PROTO_CODE code, ProtoPayload& payload)
+    {
+        if(mRecord)
+            mWriter.AddData(code, payload);
+        else
+            gen::ProtoQueueData(mQueue, code, payload);
+    }
+
+    // The attachment is sent from its file, or read into the record (in a memfd
+    // if at least fdThreshold bytes)
+    bool AddAttachment(ProtoFileRange& attachment, size_t fdThreshold, std::string& errMsg)
+    {
+        if(!mRecord)
+        {
+            gen::ProtoQueueAttachment(mQueue, attachment);
+            return true;
+        }
+
+        if(!mAttachment.ReadFile(attachment.fd, attachment.offset, attachment.length, fdThreshold, errMsg))
+            return false;
+        mWriter.AddData(PROTO_CODE::ATTACHMENT, mAttachment);
+        return true;
+    }
+
+    // SOCK_SEQPACKET: queue the record (see ProtoQueueFrames())
+    bool Queue(std::string& errMsg)
+    {
+        return (!mRecord || gen::ProtoQueueFrames(mQueue, mWriter, errMsg));
+    }
+
+private:
+    OutputQueue& mQueue;
+    bool mRecord;
+    ProtoFrameWriter mWriter;
+    ProtoPayload mAttachment;
+};
+
 } // namespace gen
 
 #endif // __PROTO_COMMON_HPP__
@@ -0,0 +1,190 @@
+//
+// protoProxy.hpp
+//
+#ifndef __PROTO_PROXY_HPP__
+#define __PROTO_PROXY_HPP__
+
+#include "protoServer.hpp"
+#include "protoClient.hpp"
+#include <mutex>
+
+namespace gen {
+
+//
+// Forward the calls to upstream ProtoServers without parsing the messages: the
+// request and response bytes are passed on as they are, routed on the method
+// (id or request type name) and the metadata only. Large messages between Unix
+// domain sockets stay in their memfd, which is passed on as a descriptor: the
+// data isn't copied by the proxy.
+//
+// The upstream connections are pooled: each call takes an idle connection (or
+// opens one) and gives it back when the response is in.
+//
+// Note: Unary calls only. The methods bound with Bind() are served by the proxy
+// itself; the others go upstream.
+//
+class ProtoProxy : public ProtoServer
+{
+public:
+    ProtoProxy(int threadPoolSize, EventBackend backend = EventBackend::EPOLL) :
+        ProtoServer(threadPoolSize, backend), mForwardHandler(this) {}
+
+    // Add an upstream server, on TCP or on a Unix domain socket (abstract if the
+    // path starts with '\0'). Returns its index (see Route()).
+    size_t AddUpstream(const std::string& host, unsigned short port);
+    size_t AddUpstreamSocket(const std::string& domainSocketPath, bool seqPacket = false);
+
+    // The idle connections kept per upstream (more are opened under load)
+    void SetUpstreamPoolSize(size_t size) { mPoolSize = size; }
+    void SetUpstreamTimeout(long timeoutMs) { mTimeoutMs = timeoutMs; }
+
+protected:
+    virtual bool OnInit() override { return true; }
+
+    // The upstream to forward the call to, from its method and metadata
+    // (see Context::GetMethodId(), GetRequestName(), GetMetadata()).
+    // -1: refuse the call (set the error with ctx.SetError()).
+    virtual int Route(const Context& /*ctx*/) { return 0; }
+
+    // A new upstream connection: set it up (e.g. InitMetadataTable(), InitCompression())
+    virtual bool OnUpstreamConnect(ProtoClient& /*client*/, std::string& /*errMsg*/) { return true; }
+
+    virtual Handler* GetDefaultHandler() override { return &mForwardHandler; }
+
+    bool Forward(const Context& ctx, const ProtoPayload& reqData, ProtoPayload& respData, size_t fdThreshold);
+
+private:
+    struct ForwardHandler : public Handler
+    {
+        explicit ForwardHandler(ProtoProxy* _proxy) : proxy(_proxy) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override
+        {
+            return proxy->Forward(ctx, reqData, respData, fdThreshold);
+        }
+        ProtoProxy* proxy = nullptr;
+    };
+
+    struct Upstream
+    {
+        std::string domainSocketPath;   // Or host and port
+        bool seqPacket{false};
+        std::string host;
+        unsigned short port{0};
+
+        std::mutex mutex;
+        std::vector<std::unique_ptr<ProtoClient>> idle;
+    };
+
+    std::unique_ptr<ProtoClient> Acquire(Upstream& upstream, std::string& errMsg);
+    void Release(Upstream& upstream, std::unique_ptr<ProtoClient> client);
+
+    ForwardHandler mForwardHandler;
+    std::vector<std::unique_ptr<Upstream>> mUpstreams;     // Added before Start()
+    size_t mPoolSize{16};
+    long mTimeoutMs{5000};
+};
+
+inline size_t ProtoProxy::AddUpstream(const std::string& host, unsigned short port)
+{
+    auto upstream = std::make_unique<Upstream>();
+    upstream->host = host;
+    upstream->port = port;
+    mUpstreams.push_back(std::move(upstream));
+    return mUpstreams.size() - 1;
+}
+
+inline size_t ProtoProxy::AddUpstreamSocket(const std::string& domainSocketPath, bool seqPacket)
+{
+    auto upstream = std::make_unique<Upstream>();
+    upstream->domainSocketPath = domainSocketPath;
+    upstream->seqPacket = seqPacket;
+    mUpstreams.push_back(std::move(upstream));
+    return mUpstreams.size() - 1;
+}
+
+inline std::unique_ptr<ProtoClient> ProtoProxy::Acquire(Upstream& upstream, std::string& errMsg)
+{
+    {
+        std::lock_guard<std::mutex> lock(upstream.mutex);
+        if(!upstream.idle.empty())
+        {
+            std::unique_ptr<ProtoClient> client = std::move(upstream.idle.back());
+            upstream.idle.pop_back();
+            return client;
+        }
+    }
+
+    auto client = std::make_unique<ProtoClient>();
+    bool res = (upstream.domainSocketPath.empty() ?
+                client->Init(upstream.host.c_str(), upstream.port, errMsg) :
+                client->Init(upstream.domainSocketPath.c_str(), errMsg, upstream.seqPacket));
+    if(!res || !OnUpstreamConnect(*client, errMsg))
+        return nullptr;
+    return client;
+}
+
+inline void ProtoProxy::Release(Upstream& upstream, std::unique_ptr<ProtoClient> client)
+{
+    // Connections that failed are dropped
+    if(!client->IsValid())
+        return;
+
+    std::lock_guard<std::mutex> lock(upstream.mutex);
+    if(upstream.idle.size() < mPoolSize)
+        upstream.idle.push_back(std::move(client));
+}
+
+inline bool ProtoProxy::Forward(const Context& ctx, const ProtoPayload& reqData, ProtoPayload& respData, size_t fdThreshold)
+{
+    respData.Clear();
+    int index = Route(ctx);
+    if(index < 0 || static_cast<size_t>(index) >= mUpstreams.size())
+    {
+        if(ctx.GetError().empty())
+            ctx.SetError("No upstream for the request");
+        return false;
+    }
+
+    Upstream& upstream = *mUpstreams[index];
+    std::string errMsg;
+    std::unique_ptr<ProtoClient> client = Acquire(upstream, errMsg);
+    if(!client)
+    {
+        OnError(__FNAME__, __LINE__, "Failed to connect to upstream " + std::to_string(index) + ": " + errMsg);
+        ctx.SetError("Upstream unavailable");
+        return false;
+    }
+
+    // The connection's metadata goes with each call: the upstream connection is shared
+    const std::map<std::string, std::string>* metadata = &ctx.GetAllMetadata();
+    std::map<std::string, std::string> merged;
+    if(const auto* connectionMetadata = ctx.GetConnectionMetadata(); connectionMetadata && !connectionMetadata->empty())
+    {
+        merged = *connectionMetadata;
+        for(const auto& [key, value] : ctx.GetAllMetadata())
+            merged[key] = value;
+        metadata = &merged;
+    }
+
+    bool res = client->CallRaw(ctx.GetMethodId(), ctx.GetRequestName(), reqData, respData, *metadata, errMsg, mTimeoutMs);
+    Release(upstream, std::move(client));
+    if(!res)
+    {
+        ctx.SetError(errMsg);
+        return false;
+    }
+
+    // A memfd can't go to a TCP or shared memory client
+    if(respData.IsFd() && fdThreshold == NO_FD_PAYLOAD)
+    {
+        ProtoPayload copy;
+        copy.str().assign(respData.data(), respData.size());
+        respData.Swap(copy);
+    }
+    return true;
+}
+
+} // namespace gen
+
+#endif // __PROTO_PROXY_HPP__
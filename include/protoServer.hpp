@@ -6,19 +6,168 @@
 
 #include "epollServer.hpp"
 #include "protoCommon.hpp"
+#include "shmCommon.hpp"
+#include "responseCache.hpp"
+#include "singleFlight.hpp"
+#include "pubSub.hpp"
 #include <google/protobuf/message.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <thread>
+#include <optional>
+#include <set>
+#include <string_view>
 
 namespace gen {
 
+struct ProtoClientContext;
+
+// Find the top-level field number of a serialized message without parsing it:
+// its last value if it's a varint (integers, bool, enum) or length-delimited
+// (string, bytes, sub-message) field. False if it's not there or malformed.
+inline bool ProtoPeekField(std::string_view data, int number, uint64_t* varint, std::string_view* bytes)
+{
+    using google::protobuf::internal::WireFormatLite;
+    if(data.size() > INT_MAX)
+        return false;
+
+    google::protobuf::io::CodedInputStream input(reinterpret_cast<const uint8_t*>(data.data()),
+                                                 static_cast<int>(data.size()));
+    bool found = false;
+    while(uint32_t tag = input.ReadTag())
+    {
+        if(WireFormatLite::GetTagFieldNumber(tag) == number)
+        {
+            auto type = WireFormatLite::GetTagWireType(tag);
+            if(varint && type == WireFormatLite::WIRETYPE_VARINT)
+            {
+                if(!input.ReadVarint64(varint))
+                    return false;
+                found = true;
+                continue;
+            }
+
+            if(bytes && type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED)
+            {
+                uint32_t len = 0;
+                size_t offset = 0;
+                if(!input.ReadVarint32(&len) || (offset = input.CurrentPosition()) + len > data.size() ||
+                   !input.Skip(static_cast<int>(len)))
+                    return false;
+                *bytes = data.substr(offset, len);
+                found = true;
+                continue;
+            }
+        }
+
+        if(!WireFormatLite::SkipField(&input, tag))
+            return false;
+    }
+    return (found && static_cast<size_t>(input.CurrentPosition()) == data.size());
+}
+
+// Options of a unary method (see ProtoServer::Bind())
+struct ProtoBindOptions
+{
+    // Cache the responses for cacheTtl: the method's response depends only on its
+    // request bytes and the values of cacheMetadataKeys. A cached response is sent
+    // without parsing the request or calling the handler. Only the responses
+    // without error and attachment are cached.
+    bool cache{false};
+    std::chrono::milliseconds cacheTtl{std::chrono::seconds(60)};
+    std::vector<std::string> cacheMetadataKeys;
+
+    // Coalesce the identical calls (same method, request bytes and cacheMetadataKeys
+    // values) in flight: one runs the handler, the others wait for it and get the
+    // same response and error. Calls whose response has an attachment aren't shared.
+    // A call waits for coalesceTimeout at most, then runs the handler itself.
+    bool coalesce{false};
+    std::chrono::milliseconds coalesceTimeout{std::chrono::seconds(1)};
+
+    // One-way method: called with ProtoClient::CallOneWay(), which returns once the
+    // request is written. Nothing is sent back: the handler's response and error
+    // are dropped, and the outcome is only counted (see ProtoClient::SyncOneWay()).
+    // Every call runs the handler: not allowed with cache or coalesce.
+    bool oneWay{false};
+};
+
 //
 // Send and receive Protobuf messages
 //
-class ProtoServer : public gen::EpollServer
+class ProtoServer : public gen::EpollServerT<ProtoServer, ProtoClientContext>
 {
 public:
-    ProtoServer(int threadPoolSize) : gen::EpollServer(threadPoolSize) {}
+    ProtoServer(int threadPoolSize, EventBackend backend = EventBackend::EPOLL) :
+        gen::EpollServerT<ProtoServer, ProtoClientContext>(threadPoolSize, backend) {}
     virtual ~ProtoServer() = default;
 
+    // Allow Unix domain socket clients to switch to the shared memory transport
+    // (see ProtoClient::InitShm()). Each such connection is then served by its
+    // own thread, which waits for the requests on the shared memory ring.
+    void SetShmTransport(bool enable) { mShmEnabled = enable; }
+
+    // Unix domain sockets: responses of at least threshold bytes are passed
+    // in a sealed memfd instead of being copied through the socket
+    void SetFdPayloadThreshold(size_t threshold) { mFdPayloadThreshold = threshold; }
+
+    // Client-streaming calls: the request bytes a client may send ahead of the
+    // handler. The server grants more as the handler reads the messages.
+    void SetStreamWindow(size_t bytes) { mStreamWindow = std::max<size_t>(std::min<size_t>(bytes, UINT32_MAX), 1); }
+
+    // Allow clients to switch their connection to compressed messages with codec
+    // (see ProtoClient::InitCompression()). Responses of at least the threshold
+    // bytes are then compressed; smaller ones aren't worth the CPU time.
+    void EnableCompression(Codec codec) { mCodecs |= CodecMask(codec); }
+    void SetCompressionThreshold(size_t threshold) { mCompressionThreshold = threshold; }
+
+    // Compressed requests are accepted from the clients that switched to compression,
+    // with the codecs enabled, up to this size decompressed
+    void SetMaxDecompressedSize(size_t bytes) { mMaxDecompressedSize = bytes; }
+
+    // Received frames announcing a longer payload close the connection before
+    // anything is allocated (stream sockets; records are bounded by their size).
+    // Raise it for raw handlers receiving requests over 2 GiB.
+    void SetMaxRequestSize(size_t bytes) { mMaxRequestSize = bytes; }
+
+    // Compress the responses of a method with codec instead of the connection's
+    // codec (Codec::NONE: never compress them, e.g. already compressed data).
+    // Methods are identified by request type name (see Bind()) or by method id.
+    // Call before Start(): the workers read it without a lock. Fails once running.
+    bool SetMethodCompression(const std::string& reqName, Codec codec);
+    bool SetMethodCompression(uint32_t methodId, Codec codec);
+
+    // Allow clients to ask for checksums (see ProtoClient::InitChecksums()): the
+    // requests and responses of their connection then carry a CRC32C, and a
+    // corrupted message closes the connection
+    void SetChecksums(bool enable) { mChecksumsEnabled = enable; }
+
+    // The largest metadata table a client may set up (see ProtoClient::InitMetadataTable()),
+    // in bytes per connection. 0: clients send the metadata of every call in full.
+    void SetMaxMetadataTableSize(size_t bytes) { mMaxMetadataTableSize = bytes; }
+
+    // The byte budget of the response cache (see BindOptions::cache), shared by the methods.
+    // Responses over a 16th of it are not cached (see ResponseCache::MaxEntrySize()).
+    void SetResponseCacheSize(size_t bytes) { mResponseCache.SetMaxSize(bytes); }
+
+    // Per-method options, given to Bind() (or SetMethodOptions() for generated services)
+    using BindOptions = ProtoBindOptions;
+
+    // Set the options of a unary method, by request type name or by method id.
+    // Fails if the options are inconsistent (oneWay with cache or coalesce).
+    // Call before Start(): the workers read them without a lock. Fails once running.
+    bool SetMethodOptions(const std::string& reqName, const BindOptions& options);
+    bool SetMethodOptions(uint32_t methodId, const BindOptions& options);
+
+    // Publish msg to the subscribers of topic (see ProtoClient::Subscribe()). It's
+    // serialized once, and queued by reference to each subscriber's connection
+    // (large messages over Unix domain sockets: one sealed memfd passed to all).
+    // Never waits for a subscriber: one with more than the subscriber queue limit
+    // waiting is evicted. Returns the subscribers it was queued to.
+    size_t Publish(const std::string& topic, const google::protobuf::Message& msg);
+    size_t GetSubscriberCount(const std::string& topic) { return mPubSub.GetSubscriberCount(topic); }
+
+    // The bytes a subscriber may have waiting before it's evicted (more than the largest message)
+    void SetSubscriberQueueLimit(size_t bytes) { mPubSub.SetQueueLimit(bytes); }
+
 protected:
     // Override gen::EpollServer::OnInit() to be pure virtual (= 0) to force
     // derived classes to provide a concrete implementation.
@@ -26,53 +175,246 @@ protected:
 
     struct Context
     {
-        Context(const std::map<std::string, std::string>& _metadata) : metadata(_metadata) {}
-        ~Context() = default;
+        Context(const std::map<std::string, std::string>& _metadata,
+                const std::map<std::string, std::string>* _connectionMetadata = nullptr,
+                uint32_t _methodId = 0, const std::string* _reqName = nullptr) :
+            metadata(_metadata), connectionMetadata(_connectionMetadata), methodId(_methodId), reqName(_reqName) {}
+        ~Context()
+        {
+            if(attachment.fd != -1)
+                close(attachment.fd);
+        }
         void SetError(const std::string& err) const { errMsg = err; }
         const std::string& GetError() const { return errMsg; }
 
+        // Send length bytes of the file at offset after the response message,
+        // with sendfile() (the client receives them with a ProtoAttachment).
+        // The descriptor is duplicated: the caller keeps its own.
+        // Note: Not supported over the shared memory transport.
+        bool AttachFile(int fd, off_t offset, size_t length) const
+        {
+            struct stat st;
+            if(fstat(fd, &st) == -1 || (S_ISREG(st.st_mode) && static_cast<size_t>(st.st_size) < offset + length))
+                return false;
+
+            int dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+            if(dupFd == -1)
+                return false;
+
+            if(attachment.fd != -1)
+                close(attachment.fd);
+            attachment.fd = dupFd;
+            attachment.offset = offset;
+            attachment.length = length;
+            return true;
+        }
+        bool HasAttachment() const { return (attachment.fd != -1); }
+        ProtoFileRange TakeAttachment() const
+        {
+            ProtoFileRange res = attachment;
+            attachment.fd = -1;
+            return res;
+        }
+
+        // The call's metadata, or else the connection's (see ProtoClient::SetConnectionMetadata())
         std::string GetMetadata(const char* key) const
         {
             if(auto itr = metadata.find(key); itr != metadata.end())
                 return std::string(itr->second.data(), itr->second.size());
-            else
-                return "";
+            else if(connectionMetadata)
+            {
+                if(auto itr = connectionMetadata->find(key); itr != connectionMetadata->end())
+                    return itr->second;
+            }
+            return "";
+        }
+        bool HasMetadata(const char* key) const
+        {
+            return (metadata.count(key) || (connectionMetadata && connectionMetadata->count(key)));
+        }
+
+        // All the metadata of the call, and of the connection
+        const std::map<std::string, std::string>& GetAllMetadata() const { return metadata; }
+        const std::map<std::string, std::string>* GetConnectionMetadata() const { return connectionMetadata; }
+
+        // The method called: by method id (REQ_ID), or by request type name if the id is 0
+        uint32_t GetMethodId() const { return methodId; }
+        const std::string& GetRequestName() const
+        {
+            static const std::string empty;
+            return (reqName ? *reqName : empty);
         }
 
     private:
         const std::map<std::string, std::string>& metadata;
+        const std::map<std::string, std::string>* connectionMetadata;
+        uint32_t methodId;
+        const std::string* reqName;
         mutable std::string errMsg;
+        mutable ProtoFileRange attachment;
+    };
+
+    // Where the messages of a server-streaming call go: the connection's
+    // output queue, or the shared memory ring
+    struct StreamSink
+    {
+        virtual ~StreamSink() = default;
+        // Send one RESP frame. Returns false once the stream is broken.
+        virtual bool Send(ProtoPayload& data) = 0;
+
+        size_t fdThreshold{NO_FD_PAYLOAD};  // Messages of at least this size go in a memfd
+        bool broken{false};                 // The connection failed: the stream can't go on
+        bool disconnected{false};           // ... because the client has closed it
+        std::string errMsg;
+    };
+
+    // Server streaming: the handler writes the messages one by one, each is
+    // sent as soon as it's written. ERR ends the stream when the handler returns.
+    template<class RESP>
+    class StreamWriter
+    {
+    public:
+        explicit StreamWriter(StreamSink& sink) : mSink(sink) {}
+        StreamWriter(const StreamWriter&) = delete;
+        StreamWriter& operator=(const StreamWriter&) = delete;
+
+        // Note: Blocks while the client is not reading (the output queue is
+        // above the high-water mark). Returns false if the message is not sent:
+        // once the stream is broken, the handler should stop producing.
+        bool Write(const RESP& msg);
+        bool IsBroken() const { return mSink.broken; }
+
+    private:
+        StreamSink& mSink;
+    };
+
+    // Where the messages of a client-streaming call come from: the socket
+    // (within the flow-control window granted to the client)
+    struct StreamSource
+    {
+        virtual ~StreamSource() = default;
+        // Receive the next REQ payload. Returns false at the end of the stream, or once it's broken.
+        virtual bool Recv(ProtoPayload& data) = 0;
+
+        bool ended{false};                  // END received
+        bool invalid{false};                // A message failed to parse
+        bool broken{false};                 // The connection failed: the stream can't go on
+        bool disconnected{false};           // ... because the client has closed it
+        std::string errMsg;
+    };
+
+    // Client streaming: the handler reads the request messages one by one,
+    // as the client sends them
+    template<class REQ>
+    class StreamReader
+    {
+    public:
+        explicit StreamReader(StreamSource& source) : mSource(source) {}
+        StreamReader(const StreamReader&) = delete;
+        StreamReader& operator=(const StreamReader&) = delete;
+
+        // Returns false at the end of the stream, or if it's broken or the
+        // message can't be parsed (the call then fails)
+        bool Read(REQ& msg);
+        bool IsBroken() const { return mSource.broken; }
+
+    private:
+        StreamSource& mSource;
+    };
+
+    // Request of a handler bound with Lazy<REQ>: parsed on first access only.
+    // Raw() gives the serialized bytes (to forward or cache them as they are),
+    // and Peek() reads a top-level field without parsing the whole message.
+    template<class REQ>
+    class Lazy
+    {
+    public:
+        explicit Lazy(std::string_view raw) : mRaw(raw) {}
+        Lazy(const Lazy&) = delete;
+        Lazy& operator=(const Lazy&) = delete;
+
+        std::string_view Raw() const { return mRaw; }
+
+        // Note: If the request can't be parsed, the message is empty and the call fails
+        const REQ& Get() const;
+        const REQ& operator*() const { return Get(); }
+        const REQ* operator->() const { return &Get(); }
+        bool IsParsed() const { return mReq.has_value(); }
+        bool IsInvalid() const { return mInvalid; }
+
+        // The field number's value, see gen::ProtoPeekField()
+        bool Peek(int number, uint64_t& value) const { return gen::ProtoPeekField(mRaw, number, &value, nullptr); }
+        bool Peek(int number, std::string_view& value) const { return gen::ProtoPeekField(mRaw, number, nullptr, &value); }
+
+    private:
+        std::string_view mRaw;
+        mutable std::optional<REQ> mReq;
+        mutable bool mInvalid{false};
     };
 
     // Note: Only derived classes can bind their handler (class member functions)
     template<class SERVER, class REQ, class RESP>
-    bool Bind(void (SERVER::*fptr)(const Context& ctx, const REQ&, RESP&))
+    bool Bind(void (SERVER::*fptr)(const Context& ctx, const REQ&, RESP&), const BindOptions& options = BindOptions())
     {
-        // Check if we already have handler for this request type
-        std::string reqName = REQ().GetTypeName();
-        if(auto itr = mHandlerMap.find(reqName); itr != mHandlerMap.end())
-        {
-            OnError(__FNAME__, __LINE__, "Failed to bind request " + reqName + ": it's already bound");
-            return false;
-        }
-        auto handler = new (std::nothrow) HandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr);
-        mHandlerMap[reqName].reset(handler);
-        return true;
+        return BindHandler(REQ().GetTypeName(), new (std::nothrow) HandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr), options);
     }
 
-private:
-    // EpollServer overrides
-    virtual std::shared_ptr<ClientContext> MakeClientContext() override final;
-    virtual bool OnRead(std::shared_ptr<ClientContext>& client) override final;
-    virtual bool OnWrite(std::shared_ptr<ClientContext>& client) override final;
+    // Server-streaming handler
+    template<class SERVER, class REQ, class RESP>
+    bool Bind(void (SERVER::*fptr)(const Context& ctx, const REQ&, StreamWriter<RESP>&))
+    {
+        return BindHandler(REQ().GetTypeName(), new (std::nothrow) StreamHandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr));
+    }
+
+    // Client-streaming handler
+    template<class SERVER, class REQ, class RESP>
+    bool Bind(void (SERVER::*fptr)(const Context& ctx, StreamReader<REQ>&, RESP&))
+    {
+        return BindHandler(REQ().GetTypeName(), new (std::nothrow) ClientStreamHandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr));
+    }
+
+    // Bidirectional-streaming handler
+    template<class SERVER, class REQ, class RESP>
+    bool Bind(void (SERVER::*fptr)(const Context& ctx, StreamReader<REQ>&, StreamWriter<RESP>&))
+    {
+        return BindHandler(REQ().GetTypeName(), new (std::nothrow) BidiStreamHandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr));
+    }
+
+    // Lazy handler: the request is parsed if and when the handler accesses it
+    template<class SERVER, class REQ, class RESP>
+    bool Bind(void (SERVER::*fptr)(const Context& ctx, const Lazy<REQ>&, RESP&), const BindOptions& options = BindOptions())
+    {
+        return BindHandler(REQ().GetTypeName(), new (std::nothrow) LazyHandlerImpl<SERVER, REQ, RESP>((SERVER*)this, fptr), options);
+    }
+
+    // Raw handler: gets the serialized request and writes the serialized response,
+    // nothing is parsed or serialized (e.g. a tier that routes or caches messages).
+    // Bound by request type name, as the handler has no message types.
+    template<class SERVER>
+    bool Bind(const std::string& reqName, void (SERVER::*fptr)(const Context& ctx, std::string_view req, std::string& resp),
+              const BindOptions& options = BindOptions())
+    {
+        return BindHandler(reqName, new (std::nothrow) RawHandlerImpl<SERVER>((SERVER*)this, fptr), options);
+    }
 
     // Base class for service-specific HandlerImpl class
     struct Handler
     {
         Handler() = default;
         virtual ~Handler() = default;
-        virtual bool Call(const Context& ctx,
-                          const std::string& reqData, std::string& respData) = 0;
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) = 0;
+
+        // Server streaming: the response messages go to the sink
+        virtual bool IsStreaming() const { return false; }
+        virtual bool CallStream(const Context& /*ctx*/, const ProtoPayload& /*reqData*/, StreamSink& /*sink*/) { return false; }
+
+        // Client (and bidirectional) streaming: the request messages come from the source
+        virtual bool IsClientStreaming() const { return false; }
+        virtual bool CallClientStream(const Context& /*ctx*/, StreamSource& /*source*/, StreamSink& /*sink*/) { return false; }
+
+        std::optional<Codec> codec;     // Responses codec (see SetMethodCompression())
+        BindOptions options;
     };
 
     template<class SERVER, class REQ, class RESP>
@@ -80,180 +422,867 @@ private:
     {
         typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, const REQ&, RESP&);
         HandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
-        virtual bool Call(const Context& ctx,
-                          const std::string& reqData, std::string& respData) override;
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
         SERVER* srv = nullptr;
         HANDLER_FPTR fptr = nullptr;
     };
 
-    Handler* GetHandler(const std::string& reqName, std::string& errMsg);
+    template<class SERVER, class REQ, class RESP>
+    struct StreamHandlerImpl : public Handler
+    {
+        typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, const REQ&, StreamWriter<RESP>&);
+        StreamHandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
+        virtual bool IsStreaming() const override { return true; }
+        virtual bool CallStream(const Context& ctx, const ProtoPayload& reqData, StreamSink& sink) override;
+        SERVER* srv = nullptr;
+        HANDLER_FPTR fptr = nullptr;
+    };
 
-    struct ClientContextImpl : public ClientContext
+    template<class SERVER, class REQ, class RESP>
+    struct ClientStreamHandlerImpl : public Handler
     {
-        // Message Processing State
-        enum class MessageState
-        {
-            READING_REQ_NAME = 100,
-            READING_REQ,
-            SENDING_ACK,
-            SENDING_NACK,
-            SENDING_RESP
-        };
+        typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, StreamReader<REQ>&, RESP&);
+        ClientStreamHandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
+        virtual bool IsClientStreaming() const override { return true; }
+        virtual bool CallClientStream(const Context& ctx, StreamSource& source, StreamSink& sink) override;
+        SERVER* srv = nullptr;
+        HANDLER_FPTR fptr = nullptr;
+    };
 
-        MessageState messageState{MessageState::READING_REQ_NAME};
-        Handler* handler{nullptr};
-        std::string respData;
-        std::string errMsg;
+    template<class SERVER, class REQ, class RESP>
+    struct BidiStreamHandlerImpl : public Handler
+    {
+        typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, StreamReader<REQ>&, StreamWriter<RESP>&);
+        BidiStreamHandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
+        virtual bool IsStreaming() const override { return true; }
+        virtual bool IsClientStreaming() const override { return true; }
+        virtual bool CallClientStream(const Context& ctx, StreamSource& source, StreamSink& sink) override;
+        SERVER* srv = nullptr;
+        HANDLER_FPTR fptr = nullptr;
+    };
 
-        // Helper function to reset message unit
-        void Reset()
-        {
-            messageState = MessageState::READING_REQ_NAME;
-            respData.clear();
-            errMsg.clear();
-            handler = nullptr;
-        }
+    template<class SERVER, class REQ, class RESP>
+    struct LazyHandlerImpl : public Handler
+    {
+        typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, const Lazy<REQ>&, RESP&);
+        LazyHandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
+        SERVER* srv = nullptr;
+        HANDLER_FPTR fptr = nullptr;
+    };
+
+    // Note: Generated services can dispatch a method id to it from GetMethodHandler()
+    template<class SERVER>
+    struct RawHandlerImpl : public Handler
+    {
+        typedef void (SERVER::*HANDLER_FPTR)(const Context& ctx, std::string_view req, std::string& resp);
+        RawHandlerImpl(SERVER* _srv, HANDLER_FPTR _fptr) : srv(_srv), fptr(_fptr) {}
+        virtual bool Call(const Context& ctx, const ProtoPayload& reqData,
+                          ProtoPayload& respData, size_t fdThreshold) override;
+        SERVER* srv = nullptr;
+        HANDLER_FPTR fptr = nullptr;
     };
 
+    // Serialize the response message of a unary handler straight into the payload buffer
+    static bool SerializeResponse(const Context& ctx, const google::protobuf::Message& resp,
+                                  ProtoPayload& respData, size_t fdThreshold);
+
+    // Method id (REQ_ID) dispatch. Overridden by the service bases generated
+    // with protoc-gen-protorpc, which resolve the id with a switch statement.
+    virtual Handler* GetMethodHandler(uint32_t /*methodId*/) { return nullptr; }
+
+    // The generated service bases register their method ids with the full method
+    // names: two methods of the server with the same id (of services in different
+    // .proto files) can't be told apart, so the calls with that id are refused.
+    // Returns false on a collision.
+    bool RegisterMethodIds(std::initializer_list<std::pair<uint32_t, const char*>> methods);
+
+    // Handler of the methods (by id or by request type name) that have none
+    // (e.g. ProtoProxy forwards them). nullptr: such calls are refused.
+    virtual Handler* GetDefaultHandler() { return nullptr; }
+
+    // A client subscribes to topic: false refuses it (set errMsg)
+    virtual bool OnSubscribe(const std::string& /*topic*/,
+                             const std::map<std::string, std::string>& /*connectionMetadata*/,
+                             std::string& /*errMsg*/) { return true; }
+
+private:
+    // EpollServerT callbacks (resolved statically)
+    friend class gen::EpollServerT<ProtoServer, ProtoClientContext>;
+    friend struct ProtoClientContext;
+
+    // The handler to call for a request: bound to it, or the default handler
+    Handler* GetCallHandler(uint32_t methodId, std::string& errMsg);
+    Handler* GetCallHandler(const std::string& reqName, std::string& errMsg);
+    using ClientContextImpl = ProtoClientContext;
+    std::unique_ptr<ClientContextImpl> MakeClientContext();
+    bool OnRead(std::unique_ptr<ClientContextImpl>& client);
+    bool OnWrite(std::unique_ptr<ClientContextImpl>& client);
+
+    // The frames received, whatever the framing (see ProtoFrameInput)
+    bool OnFrame(std::unique_ptr<ClientContextImpl>& client, ProtoFrameInput& input, uint32_t code);
+    bool OnRequest(std::unique_ptr<ClientContextImpl>& client, ProtoFrameInput& input,
+                   bool oneWay, std::string& handlerErr);
+
+    // Large payloads go in a memfd over Unix domain sockets (smaller ones in records)
+    size_t FdPayloadThreshold(bool record) const
+    {
+        return (record ? std::min(mFdPayloadThreshold, SEQPACKET_FD_PAYLOAD_THRESHOLD) :
+                mDomainSocket ? mFdPayloadThreshold : NO_FD_PAYLOAD);
+    }
+
+    bool BindHandler(const std::string& reqName, Handler* handler, const BindOptions& options = BindOptions());
+    static bool CheckOptions(const BindOptions& options, std::string& errMsg);
+    Handler* GetHandler(const std::string& reqName, std::string& errMsg);
+
+    // Server-streaming sinks, and the client-streaming source
+    struct QueueSink;
+    struct ShmSink;
+    struct QueueSource;
+
+    bool OnReadStream(std::unique_ptr<ClientContextImpl>& client, const Context& ctx,
+                      const ProtoPayload& reqData, bool record);
+
+    void ShmSession(ProtoClientContext* client);
+
+    // Call a unary handler, or send its cached response, or wait for the same call
+    // in flight and share its response (see BindOptions::cache and coalesce)
+    void CallHandler(Handler* handler, const Context& ctx, const ProtoPayload& reqData,
+                     ProtoPayload& respData, size_t fdThreshold);
+    ResponseCache::Buffer CallShared(Handler* handler, const Context& ctx, const ProtoPayload& reqData,
+                                     ProtoPayload& respData, size_t fdThreshold);
+    void ShareResponse(const Context& ctx, ResponseCache::Buffer resp, ProtoPayload& respData, size_t fdThreshold);
+
+    // Compression and checksums: negotiated by the client, applied to the responses
+    void SetupCompression(ProtoClientContext* client, uint32_t codec);
+    ProtoDecompression Decompression(const ProtoClientContext* client) const;
+    void SetupChecksums(ProtoClientContext* client, uint32_t type);
+    void EncodeResponse(ProtoClientContext* client, ProtoPayload& data);
+
+    // Metadata table and connection metadata: set up by the client
+    void SetupMetadataTable(ProtoClientContext* client, uint32_t size);
+    bool SetupConnectionMetadata(ProtoClientContext* client, uint32_t count, const std::string& data, std::string& errMsg);
+    const std::map<std::string, std::string>* ParseMetadata(ProtoClientContext* client, const std::string& data,
+                                                            std::string& errMsg);
+
+    // One-way call: the handler's response and error are dropped, its outcome counted
+    void CallOneWay(ProtoClientContext* client, const ProtoPayload& reqData,
+                    const std::map<std::string, std::string>& metadata, const std::string& handlerErr);
+
+    // Publish-subscribe: the connection is the subscriber's from the ACK on
+    void SetupSubscription(ProtoClientContext* client, std::string topic);
+    bool Subscribe(ProtoClientContext* client, bool record, std::string& errMsg);
+
 private:
     std::map<const std::string, std::unique_ptr<Handler>> mHandlerMap;
+    std::map<uint32_t, std::string> mMethodNames;      // Registered method ids (see RegisterMethodIds())
+    std::set<uint32_t> mMethodIdCollisions;
+    bool mShmEnabled{false};
+    size_t mFdPayloadThreshold{DEFAULT_FD_PAYLOAD_THRESHOLD};
+    size_t mStreamWindow{DEFAULT_STREAM_WINDOW};
+    uint32_t mCodecs{0};    // Enabled codecs (CodecMask())
+    size_t mCompressionThreshold{DEFAULT_COMPRESSION_THRESHOLD};
+    size_t mMaxDecompressedSize{DEFAULT_MAX_DECOMPRESSED_SIZE};
+    size_t mMaxRequestSize{DEFAULT_MAX_REQUEST_SIZE};
+    bool mChecksumsEnabled{false};
+    size_t mMaxMetadataTableSize{DEFAULT_MAX_METADATA_TABLE_SIZE};
+    ResponseCache mResponseCache;
+    SingleFlight mSingleFlight;
+    PubSub mPubSub{[this](const std::string& msg) { OnError(__FNAME__, __LINE__, msg); }};
 };
 
-inline std::shared_ptr<EpollServer::ClientContext> ProtoServer::MakeClientContext()
+struct ProtoClientContext : public EpollClientContext
 {
-    return std::make_shared<ClientContextImpl>();
+    // Message Processing State
+    enum class MessageState
+    {
+        READING_REQ_NAME = 100,
+        READING_REQ,
+        SENDING_ACK,
+        SENDING_NACK,
+        SENDING_RESP,
+        SENDING_STREAM_END, // ERR after the streamed RESP frames
+        STREAM_ENDED,       // ERR sent already (the handler returned before the end of the request stream)
+        SENDING_SHM_ACK,
+        SHM_SESSION,        // Requests come over shared memory; the socket is watched for disconnect only
+        SENDING_SETUP_ACK,  // COMPRESSION, CHECKSUM, METADATA_TABLE or CONNECTION_METADATA accepted
+        SENDING_SUBSCRIBE_ACK,
+        SUBSCRIBED,         // Published messages go out; the socket is watched for disconnect only
+        ONEWAY_RECEIVED,    // One-way call handled: nothing to send
+        SENDING_ONEWAY_STATUS
+    };
+
+    MessageState messageState{MessageState::READING_REQ_NAME};
+    ProtoServer::Handler* handler{nullptr};
+    uint32_t methodId{0};           // The method called (see Context::GetMethodId())
+    std::string reqName;
+    ProtoPayload respData;
+    ProtoFileRange attachment;      // Sent after respData (if fd != -1)
+    std::string errMsg;
+
+    // Compression codec and checksums of the responses (negotiated by the client)
+    Codec codec{Codec::NONE};
+    bool checksums{false};
+
+    // Metadata of the requests: decoded with the table (if set up by the client),
+    // or parsed into metadata, and the connection metadata
+    std::unique_ptr<MetadataDecoder> metadataDecoder;
+    std::map<std::string, std::string> metadata;
+    std::map<std::string, std::string> connectionMetadata;
+
+    // Shared memory transport
+    std::unique_ptr<ShmChannel> shm;
+    std::thread shmThread;
+    std::atomic<bool> shmStop{false};
+
+    // One-way calls of the connection: handled without error, and refused or failed
+    uint64_t oneWayHandled{0};
+    uint64_t oneWayFailed{0};
+
+    // Publish-subscribe: the topic, and the subscription once confirmed
+    std::string topic;
+    std::shared_ptr<PubSub::Subscriber> subscriber;
+
+    ~ProtoClientContext()
+    {
+        if(subscriber)
+            subscriber->pubSub->Unsubscribe(subscriber);
+
+        if(attachment.fd != -1)
+            close(attachment.fd);
+
+        // Stop the shared memory session before the rings are unmapped
+        if(shmThread.joinable())
+        {
+            shmStop = true;
+            shm->WakeAll();
+            shmThread.join();
+        }
+    }
+
+    // Helper function to reset message unit
+    void Reset()
+    {
+        messageState = MessageState::READING_REQ_NAME;
+        respData.Clear();
+        if(attachment.fd != -1)
+            close(attachment.fd);
+        attachment.fd = -1;
+        errMsg.clear();
+        handler = nullptr;
+        methodId = 0;
+        reqName.clear();
+    }
+};
+
+inline std::unique_ptr<ProtoServer::ClientContextImpl> ProtoServer::MakeClientContext()
+{
+    return std::make_unique<ClientContextImpl>();
 }
 
-inline bool ProtoServer::OnRead(std::shared_ptr<EpollServer::ClientContext>& client_)
+// Server streaming over a socket: each message is queued to the connection's
+// output queue and written out right away. The handler waits for the client
+// to read while the output is above the high-water mark.
+struct ProtoServer::QueueSink : public ProtoServer::StreamSink
 {
-    ClientContextImpl* client = dynamic_cast<ClientContextImpl*>(client_.get());
-    int clientFd = client->fd;
-    std::string errMsg;
+    QueueSink(ProtoServer* _srv, ProtoClientContext* _client, bool _record) :
+        srv(_srv), client(_client), record(_record) {}
 
-    if(client->messageState == ClientContextImpl::MessageState::READING_REQ_NAME)
+    virtual bool Send(ProtoPayload& data) override
     {
-        std::string reqName;
-        if(!gen::ProtoRecvData(clientFd, PROTO_CODE::REQ_NAME, reqName, 0, errMsg))
+        if(broken)
+            return false;
+
+        srv->EncodeResponse(client, data);
+        // SOCK_SEQPACKET: one record per message
+        OutputQueue& outQueue = client->outQueue;
+        ProtoFrameOutput output(outQueue, record);
+        output.AddData(PROTO_CODE::RESP, data);
+        if(!output.Queue(errMsg))
         {
-            if(errno == ENOTCONN)
+            broken = true;
+            return false;
+        }
+
+        long timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(srv->GetIdleTimeout()).count();
+        while(true)
+        {
+            if(!outQueue.Flush(client->fd, errMsg))
             {
-                // Note: This is the case when EpollServer calls OnRead() after seeing
-                // an EPOLLIN event when the client closes the socket gracefully using close().
-                // See EpollServer comments for more details. This is not an error.
-                if(mVerbose)
-                    OnInfo(__FNAME__, __LINE__, "Socket is not connected");
+                broken = true;
+                disconnected = (errno == ECONNRESET);
+                return false;
             }
-            else
+            if(outQueue.Size() < srv->GetOutputHighWaterMark())
+                break;
+
+            // Note: A client that stops reading for the idle timeout breaks the stream
+            if(!gen::WaitSocket(client->fd, POLLOUT, timeoutMs, errMsg))
             {
-                OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ_NAME code: ") + errMsg);
+                broken = true;
+                return false;
             }
-            return false;
         }
 
-        // Do we have a handler to call for this request?
-        client->handler = GetHandler(reqName, errMsg);
-        if(client->handler)
-        {
-            client->messageState = ClientContextImpl::MessageState::SENDING_ACK;
-        }
-        else
-        {
-            client->errMsg = std::move(errMsg);
-            client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
-        }
+        client->lastActivityTime = std::chrono::steady_clock::now();
         return true;
     }
-    else if(client->messageState == ClientContextImpl::MessageState::READING_REQ)
+
+    ProtoServer* srv;
+    ProtoClientContext* client;
+    bool record;
+};
+
+// Server streaming over shared memory: each message is written to the responses ring
+struct ProtoServer::ShmSink : public ProtoServer::StreamSink
+{
+    ShmSink(ProtoClientContext* _client) : client(_client) {}
+
+    virtual bool Send(ProtoPayload& data) override
     {
-        // Receive REQ (request data)
-        std::string reqData;
-        if(!gen::ProtoRecvData(clientFd, PROTO_CODE::REQ, reqData, 0, errMsg))
-        {
-            OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ (request data): ") + errMsg);
+        if(broken)
             return false;
-        }
 
-        // Receive metadata
-        std::map<std::string, std::string> metadata;
-        if(!gen::ProtoRecvData(clientFd, PROTO_CODE::METADATA, metadata, 0, errMsg))
+        ProtoFrameWriter writer;
+        writer.AddData(PROTO_CODE::RESP, data.str());
+        if(!gen::ShmSendFrames(client->shm->Responses(), writer, ShmDeadline::max(), &client->shmStop, errMsg))
         {
-            OnError(__FNAME__, __LINE__, std::string("Failed to receive METADATA: ") + errMsg);
+            broken = true;
+            disconnected = client->shmStop;
             return false;
         }
 
-        // Process the request
-        Context ctx(metadata);
-        client->handler->Call(ctx, reqData, client->respData);
-        client->errMsg = std::move(ctx.GetError());
-
-        client->messageState = ClientContextImpl::MessageState::SENDING_RESP;
+        client->lastActivityTime = std::chrono::steady_clock::now();
         return true;
     }
-    else
-    {
-        OnError(__FNAME__, __LINE__, "Unexpected READING state");
-        return false;
-    }
-}
 
-inline bool ProtoServer::OnWrite(std::shared_ptr<EpollServer::ClientContext>& client_)
+    ProtoClientContext* client;
+};
+
+// Client streaming over a socket: each message is received when the handler
+// reads it. The client may only send as many bytes as granted with WINDOW frames,
+// and the server grants more as the messages are read.
+struct ProtoServer::QueueSource : public ProtoServer::StreamSource
 {
-    ClientContextImpl* client = dynamic_cast<ClientContextImpl*>(client_.get());
-    int clientFd = client->fd;
-    std::string errMsg;
+    QueueSource(ProtoServer* _srv, ProtoClientContext* _client, bool _record, size_t _window) :
+        srv(_srv), client(_client), record(_record), window(_window), grant(_window) {}
 
-    if(client->messageState == ClientContextImpl::MessageState::SENDING_ACK)
+    virtual bool Recv(ProtoPayload& data) override
     {
-        // Send ACK back to client to indicate we are ready to read more data
-        if(!gen::ProtoSendCode(clientFd, PROTO_CODE::ACK, 0, errMsg))
-        {
-            OnError(__FNAME__, __LINE__, std::string("Failed to send ACK code: ") + errMsg);
+        if(ended || broken)
             return false;
+
+        OutputQueue& outQueue = client->outQueue;
+        long timeoutMs = std::chrono::duration_cast<std::chrono::milliseconds>(srv->GetIdleTimeout()).count();
+
+        // Grant the bytes read so far once they are half of the window (the whole window at first)
+        if(window > 0 && grant > 0 && grant >= window / 2)
+        {
+            ProtoFrameOutput output(outQueue, record);
+            output.AddInteger(PROTO_CODE::WINDOW);
+            output.AddInteger(static_cast<uint32_t>(grant));
+            if(!output.Queue(errMsg))
+            {
+                broken = true;
+                return false;
+            }
+            grant = 0;
         }
-        client->messageState = ClientContextImpl::MessageState::READING_REQ;
-        return true;
-    }
-    else if(client->messageState == ClientContextImpl::MessageState::SENDING_NACK)
-    {
-        // Send NACK back to client to indicate we have no handler for the request
-        if(!gen::ProtoSendCode(clientFd, PROTO_CODE::NACK, 0, errMsg))
+
+        // Write out all the output first.
+        // Note: The client may be waiting for it before sending the rest of the message.
+        while(!outQueue.Empty())
         {
-            OnError(__FNAME__, __LINE__, std::string("Failed to send NACK code: ") + errMsg);
-            return false;
+            if(!outQueue.Flush(client->fd, errMsg))
+            {
+                broken = true;
+                disconnected = (errno == ECONNRESET);
+                return false;
+            }
+            if(!outQueue.Empty() && !gen::WaitSocket(client->fd, POLLOUT, timeoutMs, errMsg))
+            {
+                broken = true;
+                return false;
+            }
         }
 
-        // Sent ERR (error message, could be empty)
-        if(!gen::ProtoSendData(clientFd, PROTO_CODE::ERR, client->errMsg, 0, errMsg))
+        // Receive the next message, or END
+        uint32_t code = 0;
+        ProtoFrameInput input(client->fd, record, timeoutMs, srv->Decompression(client), srv->mMaxRequestSize);
+        if(!input.Recv(errMsg) || !input.ReadInteger(code, errMsg) ||
+           (code == PROTO_CODE::REQ && !input.ReadPayload(data, errMsg)))
         {
-            OnError(__FNAME__, __LINE__, std::string("Failed to send ERR (error message): ") + errMsg);
+            broken = true;
+            disconnected = (errno == ENOTCONN || errno == ECONNRESET);
             return false;
         }
-        client->Reset();    // Reset for a next message
-        return true;
-    }
-    else if(client->messageState == ClientContextImpl::MessageState::SENDING_RESP)
-    {
-        // Send the response data
-        if(!gen::ProtoSendData(clientFd, PROTO_CODE::RESP, client->respData, 0, errMsg))
+        else if(code == PROTO_CODE::END)
         {
-            OnError(__FNAME__, __LINE__, std::string("Failed to send RESP (response data): ") + errMsg);
+            ended = true;
             return false;
         }
-
-        // Sent ERR (error message, could be empty)
-        if(!gen::ProtoSendData(clientFd, PROTO_CODE::ERR, client->errMsg, 0, errMsg))
+        else if(!gen::ProtoValidateCode(code, PROTO_CODE::REQ, errMsg))
         {
-            OnError(__FNAME__, __LINE__, std::string("Failed to send ERR (return value): ") + errMsg);
+            broken = true;
             return false;
         }
-        client->Reset();    // Reset for a next message
+
+        grant += data.size();
+        client->lastActivityTime = std::chrono::steady_clock::now();
         return true;
     }
-    else
+
+    // Skip the rest of the request stream. No more window is granted, so the
+    // client can't send more than what it has been granted already.
+    bool Drain()
     {
-        OnError(__FNAME__, __LINE__, "Unexpected SENDING state");
+        ProtoPayload data;
+        window = 0;
+        while(Recv(data))
+            ;
+        return !broken;
+    }
+
+    ProtoServer* srv;
+    ProtoClientContext* client;
+    bool record;
+    size_t window;      // Bytes
+    size_t grant;       // Bytes read since the last WINDOW
+};
+
+// Note: The framing is the only difference between stream sockets and
+// SOCK_SEQPACKET (see ProtoFrameInput): the frames of a request come as they
+// are sent, or all in one record, so there is no ACK round trip
+inline bool ProtoServer::OnRead(std::unique_ptr<ClientContextImpl>& client)
+{
+    std::string errMsg;
+
+    // Note: ERR of a request stream ended by the handler is sent already (and a
+    // one-way call gets no reply), so the client may send the next request before
+    // OnWrite() resets the state
+    if(client->messageState == ClientContextImpl::MessageState::STREAM_ENDED ||
+       client->messageState == ClientContextImpl::MessageState::ONEWAY_RECEIVED)
+        client->Reset();
+
+    ProtoFrameInput input(client->fd, mSeqPacket && mDomainSocket, 0, Decompression(client.get()), mMaxRequestSize);
+    if(client->messageState == ClientContextImpl::MessageState::READING_REQ_NAME)
+    {
+        // Receive the request code: REQ_NAME (request type name), REQ_ID (method id), or a setup code
+        uint32_t code = 0;
+        if(!input.Recv(errMsg) || !input.ReadInteger(code, errMsg))
+        {
+            if(errno == ENOTCONN)
+            {
+                // Note: This is the case when EpollServer calls OnRead() after seeing
+                // an EPOLLIN event when the client closes the socket gracefully using close().
+                // See EpollServer comments for more details. This is not an error.
+                if(mVerbose)
+                    OnInfo(__FNAME__, __LINE__, "Socket is not connected");
+            }
+            else
+            {
+                OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ_NAME code: ") + errMsg);
+            }
+            return false;
+        }
+        return OnFrame(client, input, code);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::READING_REQ)
+    {
+        // Stream sockets: the request follows the ACK
+        return OnRequest(client, input, false, errMsg);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SHM_SESSION)
+    {
+        // Nothing is expected on the socket: the client has disconnected
+        if(mVerbose)
+            OnInfo(__FNAME__, __LINE__, "Shared memory client disconnected");
+        return false;
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SUBSCRIBED)
+    {
+        // Nothing is expected on the socket: the subscriber has disconnected
+        if(mVerbose)
+            OnInfo(__FNAME__, __LINE__, "Subscriber disconnected");
+        return false;
+    }
+    else
+    {
+        OnError(__FNAME__, __LINE__, "Unexpected READING state");
+        return false;
+    }
+}
+
+// Handle the frame of the code received: a call, or a setup of the connection
+inline bool ProtoServer::OnFrame(std::unique_ptr<ClientContextImpl>& client, ProtoFrameInput& input, uint32_t code)
+{
+    std::string errMsg;
+
+    // One-way call: REQ_ID or REQ_NAME, and the request follows without ACK
+    bool oneWay = (code == PROTO_CODE::ONEWAY);
+    if(oneWay && (!input.ReadInteger(code, errMsg) ||
+                  (code != PROTO_CODE::REQ_ID && !gen::ProtoValidateCode(code, PROTO_CODE::REQ_NAME, errMsg))))
+    {
+        OnError(__FNAME__, __LINE__, std::string("Failed to receive ONEWAY (request code): ") + errMsg);
+        return false;
+    }
+
+    if(code == PROTO_CODE::REQ_ID)
+    {
+        uint32_t methodId = 0;
+        if(!input.ReadInteger(methodId, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ_ID (method id): ") + errMsg);
+            return false;
+        }
+
+        // Do we have a handler to call for this method?
+        client->methodId = methodId;
+        client->reqName.clear();
+        client->handler = GetCallHandler(methodId, errMsg);
+    }
+    else if(code == PROTO_CODE::REQ_NAME)
+    {
+        client->methodId = 0;
+        if(!input.ReadPayload(client->reqName, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ_NAME (request name): ") + errMsg);
+            return false;
+        }
+
+        // Do we have a handler to call for this request?
+        client->handler = GetCallHandler(client->reqName, errMsg);
+    }
+    else if(code == PROTO_CODE::SHM_SETUP)
+    {
+        // Receive the ring size and the shared memory (memfd) created by the client
+        uint32_t ringSize = 0;
+        int shmFd = -1;
+        if(!input.ReadIntegerFd(ringSize, shmFd, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive SHM_SETUP (shared memory): ") + errMsg);
+            return false;
+        }
+
+        auto shm = std::make_unique<ShmChannel>();
+        if(!mShmEnabled)
+        {
+            close(shmFd);
+            client->errMsg = "Shared memory transport is not enabled";
+            client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        }
+        else if(!shm->Attach(shmFd, ringSize, errMsg))
+        {
+            client->errMsg = std::move(errMsg);
+            client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        }
+        else
+        {
+            client->shm = std::move(shm);
+            client->messageState = ClientContextImpl::MessageState::SENDING_SHM_ACK;
+        }
+        return true;
+    }
+    else if(code == PROTO_CODE::COMPRESSION)
+    {
+        // Receive the codec the client asks for
+        uint32_t codec = 0;
+        if(!input.ReadInteger(codec, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive COMPRESSION (codec): ") + errMsg);
+            return false;
+        }
+        SetupCompression(client.get(), codec);
+        return true;
+    }
+    else if(code == PROTO_CODE::CHECKSUM)
+    {
+        // Receive the checksum type the client asks for
+        uint32_t type = 0;
+        if(!input.ReadInteger(type, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive CHECKSUM (type): ") + errMsg);
+            return false;
+        }
+        SetupChecksums(client.get(), type);
+        return true;
+    }
+    else if(code == PROTO_CODE::METADATA_TABLE)
+    {
+        // Receive the table size the client asks for
+        uint32_t size = 0;
+        if(!input.ReadInteger(size, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive METADATA_TABLE (size): ") + errMsg);
+            return false;
+        }
+        SetupMetadataTable(client.get(), size);
+        return true;
+    }
+    else if(code == PROTO_CODE::CONNECTION_METADATA)
+    {
+        // Receive the count and the metadata of the connection
+        uint32_t count = 0;
+        std::string data;
+        if(!input.ReadInteger(count, errMsg) ||
+           !input.ReadData(PROTO_CODE::METADATA, data, errMsg) ||
+           !SetupConnectionMetadata(client.get(), count, data, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive CONNECTION_METADATA: ") + errMsg);
+            return false;
+        }
+        return true;
+    }
+    else if(code == PROTO_CODE::SUBSCRIBE)
+    {
+        // Receive the topic
+        std::string topic;
+        if(!input.ReadPayload(topic, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, std::string("Failed to receive SUBSCRIBE (topic): ") + errMsg);
+            return false;
+        }
+        SetupSubscription(client.get(), std::move(topic));
+        return true;
+    }
+    else if(code == PROTO_CODE::ONEWAY_STATUS)
+    {
+        client->messageState = ClientContextImpl::MessageState::SENDING_ONEWAY_STATUS;
+        return true;
+    }
+    else
+    {
+        gen::ProtoValidateCode(code, PROTO_CODE::REQ_NAME, errMsg);
+        OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ_NAME code: ") + errMsg);
+        return false;
+    }
+
+    // The request follows in the same record, or right away for a one-way call
+    if(input.IsRecord() || oneWay)
+        return OnRequest(client, input, oneWay, errMsg);
+
+    if(client->handler)
+    {
+        client->messageState = ClientContextImpl::MessageState::SENDING_ACK;
+    }
+    else
+    {
+        client->errMsg = std::move(errMsg);
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+    }
+    return true;
+}
+
+// Receive REQ (request data) and METADATA, and call the handler.
+// handlerErr tells why there is no handler to call.
+inline bool ProtoServer::OnRequest(std::unique_ptr<ClientContextImpl>& client, ProtoFrameInput& input,
+                                   bool oneWay, std::string& handlerErr)
+{
+    std::string errMsg;
+    ProtoPayload reqData;
+    std::string metadataData;
+    const std::map<std::string, std::string>* metadata = nullptr;
+    if(!input.ReadData(PROTO_CODE::REQ, reqData, errMsg) ||
+       !input.ReadData(PROTO_CODE::METADATA, metadataData, errMsg) ||
+       !(metadata = ParseMetadata(client.get(), metadataData, errMsg)))
+    {
+        OnError(__FNAME__, __LINE__, std::string("Failed to receive REQ (request data): ") + errMsg);
+        return false;
+    }
+
+    if(oneWay)
+    {
+        CallOneWay(client.get(), reqData, *metadata, handlerErr);
+        return true;
+    }
+
+    if(!client->handler)
+    {
+        client->errMsg = std::move(handlerErr);
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        return true;
+    }
+
+    // Zero copy: the last large response buffer went to the kernel,
+    // build this one in a recycled buffer
+    if(client->outQueue.ZeroCopyEnabled())
+    {
+        std::string buffer = GetBufferPool().Get();
+        if(buffer.capacity() > client->respData.str().capacity())
+            client->respData.str().swap(buffer);
+    }
+
+    // Process the request
+    Context ctx(*metadata, &client->connectionMetadata, client->methodId, &client->reqName);
+    if(client->handler->IsStreaming() || client->handler->IsClientStreaming())
+        return OnReadStream(client, ctx, reqData, input.IsRecord());
+
+    CallHandler(client->handler, ctx, reqData, client->respData, FdPayloadThreshold(input.IsRecord()));
+    EncodeResponse(client.get(), client->respData);
+    client->errMsg = std::move(ctx.GetError());
+    client->attachment = ctx.TakeAttachment();
+
+    client->messageState = ClientContextImpl::MessageState::SENDING_RESP;
+    return true;
+}
+
+// Note: The replies are queued to client->outQueue, and written out
+// without blocking by EpollServerT. Over SOCK_SEQPACKET, each reply is one record.
+inline bool ProtoServer::OnWrite(std::unique_ptr<ClientContextImpl>& client)
+{
+    bool record = (mSeqPacket && mDomainSocket);
+    std::string errMsg;
+    ProtoFrameOutput output(client->outQueue, record);
+
+    if(client->messageState == ClientContextImpl::MessageState::SENDING_ACK)
+    {
+        // Send ACK back to client to indicate we are ready to read more data
+        output.AddInteger(PROTO_CODE::ACK);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_NACK)
+    {
+        // Send NACK back to client to indicate we have no handler for the request,
+        // and ERR (error message, could be empty)
+        output.AddInteger(PROTO_CODE::NACK);
+        output.AddData(PROTO_CODE::ERR, client->errMsg);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_RESP)
+    {
+        // Send the response data, the attachment (if any), and ERR (error message, could be empty)
+        output.AddData(PROTO_CODE::RESP, client->respData);
+        if(client->attachment.fd != -1 && !output.AddAttachment(client->attachment, FdPayloadThreshold(record), errMsg))
+            client->errMsg = "Failed to send the attachment: " + errMsg;
+        output.AddData(PROTO_CODE::ERR, client->errMsg);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_STREAM_END)
+    {
+        // The streamed RESP frames are sent already: end the stream with ERR (error message, could be empty)
+        output.AddData(PROTO_CODE::ERR, client->errMsg);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::STREAM_ENDED ||
+            client->messageState == ClientContextImpl::MessageState::ONEWAY_RECEIVED)
+    {
+        client->Reset();    // Reset for a next message
+        return true;
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_ONEWAY_STATUS)
+    {
+        // Send ACK and the counts of the one-way calls handled and failed
+        output.AddInteger(PROTO_CODE::ACK);
+        for(uint64_t count : {client->oneWayHandled, client->oneWayFailed})
+        {
+            output.AddInteger(static_cast<uint32_t>(count >> 32));
+            output.AddInteger(static_cast<uint32_t>(count));
+        }
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_SHM_ACK ||
+            client->messageState == ClientContextImpl::MessageState::SENDING_SETUP_ACK)
+    {
+        // Confirm the shared memory transport, or the setup (it applies to the next messages)
+        output.AddInteger(PROTO_CODE::ACK);
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_SUBSCRIBE_ACK)
+    {
+        // Confirm the subscription: the ACK goes ahead of the messages, from the subscriber's queue
+        if(!Subscribe(client.get(), record, errMsg))
+        {
+            OnError(__FNAME__, __LINE__, "Failed to subscribe: " + errMsg);
+            return false;
+        }
+        return true;
+    }
+    else
+    {
+        OnError(__FNAME__, __LINE__, "Unexpected SENDING state");
+        return false;
+    }
+
+    if(!output.Queue(errMsg))
+    {
+        OnError(__FNAME__, __LINE__, std::string("Failed to queue response record: ") + errMsg);
+        return false;
+    }
+
+    if(client->messageState == ClientContextImpl::MessageState::SENDING_ACK)
+    {
+        client->messageState = ClientContextImpl::MessageState::READING_REQ;
+    }
+    else if(client->messageState == ClientContextImpl::MessageState::SENDING_SHM_ACK)
+    {
+        // Start serving the shared memory transport
+        client->messageState = ClientContextImpl::MessageState::SHM_SESSION;
+        client->shmThread = std::thread(&ProtoServer::ShmSession, this, client.get());
+    }
+    else
+    {
+        client->Reset();    // Reset for a next message
+    }
+    return true;
+}
+
+// Streaming calls: the handler sends (and receives) the messages itself,
+// then ERR ends the call
+inline bool ProtoServer::OnReadStream(std::unique_ptr<ClientContextImpl>& client, const Context& ctx,
+                                      const ProtoPayload& reqData, bool record)
+{
+    QueueSink sink(this, client.get(), record);
+    sink.fdThreshold = FdPayloadThreshold(record);
+    QueueSource source(this, client.get(), record, mStreamWindow);
+
+    bool clientStreaming = client->handler->IsClientStreaming();
+    bool res = (clientStreaming ? client->handler->CallClientStream(ctx, source, sink) :
+                                  client->handler->CallStream(ctx, reqData, sink));
+    client->errMsg = ctx.GetError();
+    client->messageState = ClientContextImpl::MessageState::SENDING_STREAM_END;
+
+    if(res && clientStreaming && !source.ended)
+    {
+        // The handler returned before the end of the request stream: send ERR now,
+        // so the client stops sending, and skip the rest of the requests
+        std::string errMsg;
+        ProtoFrameOutput output(client->outQueue, record);
+        output.AddData(PROTO_CODE::ERR, client->errMsg);
+        res = (output.Queue(errMsg) && source.Drain());
+        client->messageState = ClientContextImpl::MessageState::STREAM_ENDED;
+    }
+
+    if(!res)
+    {
+        if(!sink.disconnected && !source.disconnected)
+            OnError(__FNAME__, __LINE__, "Streaming call failed: " + (sink.broken ? sink.errMsg : source.errMsg));
+        else if(mVerbose)
+            OnInfo(__FNAME__, __LINE__, "Stream closed by peer");
+    }
+    return res;
+}
+
+inline bool ProtoServer::BindHandler(const std::string& reqName, Handler* handler, const BindOptions& options)
+{
+    // Check if we already have handler for this request type
+    if(auto itr = mHandlerMap.find(reqName); itr != mHandlerMap.end())
+    {
+        OnError(__FNAME__, __LINE__, "Failed to bind request " + reqName + ": it's already bound");
+        delete handler;
+        return false;
+    }
+    if(std::string errMsg; !CheckOptions(options, errMsg))
+    {
+        OnError(__FNAME__, __LINE__, "Failed to bind request " + reqName + ": " + errMsg);
+        delete handler;
         return false;
     }
+    if(handler)
+        handler->options = options;
+    mHandlerMap[reqName].reset(handler);
+    return true;
 }
 
 inline ProtoServer::Handler* ProtoServer::GetHandler(const std::string& reqName, std::string& errMsg)
@@ -276,31 +1305,800 @@ inline ProtoServer::Handler* ProtoServer::GetHandler(const std::string& reqName,
     return handler.get();
 }
 
-template<class SERVER, class REQ, class RESP>
-bool ProtoServer::HandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx,
-                                                       const std::string& reqData, std::string& respData)
+inline bool ProtoServer::RegisterMethodIds(std::initializer_list<std::pair<uint32_t, const char*>> methods)
 {
-    REQ req;
-    if(!req.ParseFromString(reqData))
+    bool res = true;
+    for(const auto& [methodId, name] : methods)
     {
-        ctx.SetError("Failed to read protobuf request message");
-        return false;
+        auto [itr, added] = mMethodNames.emplace(methodId, name);
+        if(!added && itr->second != name)
+        {
+            OnError(__FNAME__, __LINE__, "Method id collision between " + itr->second + " and " + name +
+                                         ": the calls of method id " + std::to_string(methodId) + " are refused");
+            mMethodIdCollisions.insert(methodId);
+            res = false;
+        }
     }
+    return res;
+}
 
-    // Call the handler function
-    RESP resp;
-    (srv->*fptr)(ctx, req, resp);
+inline ProtoServer::Handler* ProtoServer::GetCallHandler(uint32_t methodId, std::string& errMsg)
+{
+    if(!mMethodIdCollisions.empty() && mMethodIdCollisions.count(methodId))
+    {
+        errMsg = "Method id collision: " + std::to_string(methodId);
+        return nullptr;
+    }
+
+    Handler* handler = GetMethodHandler(methodId);
+    if(!handler && !(handler = GetDefaultHandler()))
+        errMsg = "Unknown method id: " + std::to_string(methodId);
+    return handler;
+}
+
+inline ProtoServer::Handler* ProtoServer::GetCallHandler(const std::string& reqName, std::string& errMsg)
+{
+    std::string handlerErr;
+    Handler* handler = GetHandler(reqName, handlerErr);
+    if(!handler && !(handler = GetDefaultHandler()))
+        errMsg = handlerErr;
+    return handler;
+}
 
-    // Serialize response protobuf message to string
-    if(!resp.SerializeToString(&respData))
+inline bool ProtoServer::SetMethodOptions(const std::string& reqName, const BindOptions& options)
+{
+    std::string errMsg;
+    Handler* handler = GetHandler(reqName, errMsg);
+    if(!handler || handler->IsStreaming() || handler->IsClientStreaming() || IsRunning())
     {
-        ctx.SetError("Failed to write protobuf request message");
+        OnError(__FNAME__, __LINE__, "Failed to set the options of request " + reqName + ": " +
+                                     (!handler ? errMsg : IsRunning() ? "the server is running" : "not a unary method"));
         return false;
     }
+    if(!CheckOptions(options, errMsg))
+    {
+        OnError(__FNAME__, __LINE__, "Failed to set the options of request " + reqName + ": " + errMsg);
+        return false;
+    }
+    handler->options = options;
+    return true;
+}
 
+inline bool ProtoServer::SetMethodOptions(uint32_t methodId, const BindOptions& options)
+{
+    Handler* handler = GetMethodHandler(methodId);
+    if(!handler || handler->IsStreaming() || handler->IsClientStreaming() || IsRunning())
+    {
+        OnError(__FNAME__, __LINE__, "Failed to set the options of method id " + std::to_string(methodId) + ": " +
+                                     (!handler ? "unknown method id" : IsRunning() ? "the server is running" :
+                                      "not a unary method"));
+        return false;
+    }
+    if(std::string errMsg; !CheckOptions(options, errMsg))
+    {
+        OnError(__FNAME__, __LINE__, "Failed to set the options of method id " + std::to_string(methodId) + ": " +
+                                     errMsg);
+        return false;
+    }
+    handler->options = options;
     return true;
 }
 
+// A one-way call's response is dropped: serving it from the cache, or sharing
+// another call's, would skip the handler's side effects
+inline bool ProtoServer::CheckOptions(const BindOptions& options, std::string& errMsg)
+{
+    if(options.oneWay && (options.cache || options.coalesce))
+    {
+        errMsg = "a one-way method can't be cached or coalesced";
+        return false;
+    }
+    return true;
+}
+
+inline bool ProtoServer::SetMethodCompression(const std::string& reqName, Codec codec)
+{
+    std::string errMsg;
+    Handler* handler = GetHandler(reqName, errMsg);
+    if(!handler || IsRunning())
+    {
+        OnError(__FNAME__, __LINE__, "Failed to set the compression of request " + reqName + ": " +
+                                     (handler ? "the server is running" : errMsg));
+        return false;
+    }
+    handler->codec = codec;
+    return true;
+}
+
+inline bool ProtoServer::SetMethodCompression(uint32_t methodId, Codec codec)
+{
+    Handler* handler = GetMethodHandler(methodId);
+    if(!handler || IsRunning())
+    {
+        OnError(__FNAME__, __LINE__, "Failed to set the compression of method id " + std::to_string(methodId) + ": " +
+                                     (handler ? "the server is running" : "unknown method id"));
+        return false;
+    }
+    handler->codec = codec;
+    return true;
+}
+
+inline void ProtoServer::SetupCompression(ProtoClientContext* client, uint32_t codec)
+{
+    if(codec == 0 || codec >= 32 || !(mCodecs & (1u << codec)))
+    {
+        client->errMsg = std::string("Compression with ") + gen::CodecToStr(static_cast<Codec>(codec)) + " is not enabled";
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        return;
+    }
+
+    client->codec = static_cast<Codec>(codec);
+    client->messageState = ClientContextImpl::MessageState::SENDING_SETUP_ACK;
+}
+
+// Compressed requests: only once the client has switched to compression
+inline ProtoDecompression ProtoServer::Decompression(const ProtoClientContext* client) const
+{
+    ProtoDecompression decompression;
+    decompression.codecs = (client->codec != Codec::NONE ? mCodecs : 0);
+    decompression.maxSize = mMaxDecompressedSize;
+    return decompression;
+}
+
+inline void ProtoServer::SetupChecksums(ProtoClientContext* client, uint32_t type)
+{
+    if(!mChecksumsEnabled || type != PROTO_CHECKSUM_CRC32C)
+    {
+        client->errMsg = (mChecksumsEnabled ? "Unknown checksum type " + std::to_string(type) :
+                                              std::string("Checksums are not enabled"));
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        return;
+    }
+
+    client->checksums = true;
+    client->messageState = ClientContextImpl::MessageState::SENDING_SETUP_ACK;
+}
+
+inline void ProtoServer::SetupMetadataTable(ProtoClientContext* client, uint32_t size)
+{
+    if(mMaxMetadataTableSize == 0 || size > mMaxMetadataTableSize || size < METADATA_ENTRY_OVERHEAD)
+    {
+        client->errMsg = (mMaxMetadataTableSize == 0 ? std::string("Metadata table is not enabled") :
+                          "Invalid metadata table size " + std::to_string(size) + " (maximum " +
+                          std::to_string(mMaxMetadataTableSize) + ")");
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        return;
+    }
+
+    // Note: A new table, as the client starts a new one
+    client->metadataDecoder = std::make_unique<MetadataDecoder>(size);
+    client->messageState = ClientContextImpl::MessageState::SENDING_SETUP_ACK;
+}
+
+// The connection metadata replaces the previous one. Returns false if it's malformed.
+inline bool ProtoServer::SetupConnectionMetadata(ProtoClientContext* client, uint32_t count,
+                                                 const std::string& data, std::string& errMsg)
+{
+    std::map<std::string, std::string> metadata;
+    if(!gen::ParseFromData(data.data(), data.size(), metadata, errMsg))
+        return false;
+    if(metadata.size() != count)
+    {
+        errMsg = std::to_string(metadata.size()) + " metadata entries, " + std::to_string(count) + " expected";
+        return false;
+    }
+
+    client->connectionMetadata = std::move(metadata);
+    client->messageState = ClientContextImpl::MessageState::SENDING_SETUP_ACK;
+    return true;
+}
+
+// Note: The client can't be told: a one-way call to a method that isn't
+// one-way (or doesn't exist) is refused, logged and counted as failed, which the
+// client sees with ProtoClient::SyncOneWay() only. The handler is called directly:
+// one-way methods are neither cached nor coalesced (see CheckOptions()).
+inline void ProtoServer::CallOneWay(ProtoClientContext* client, const ProtoPayload& reqData,
+                                    const std::map<std::string, std::string>& metadata, const std::string& handlerErr)
+{
+    client->messageState = ClientContextImpl::MessageState::ONEWAY_RECEIVED;
+
+    Handler* handler = client->handler;
+    if(!handler || !handler->options.oneWay)
+    {
+        client->oneWayFailed++;
+        OnError(__FNAME__, __LINE__, "One-way call refused: " +
+                (handler ? std::string("the method is not one-way") : handlerErr));
+        return;
+    }
+
+    Context ctx(metadata, &client->connectionMetadata, client->methodId, &client->reqName);
+    ProtoPayload respData;
+    if(handler->Call(ctx, reqData, respData, NO_FD_PAYLOAD) && ctx.GetError().empty())
+        client->oneWayHandled++;
+    else
+        client->oneWayFailed++;
+}
+
+// The connection becomes the subscriber's, unless OnSubscribe() refuses it
+inline void ProtoServer::SetupSubscription(ProtoClientContext* client, std::string topic)
+{
+    std::string errMsg;
+    if(!OnSubscribe(topic, client->connectionMetadata, errMsg))
+    {
+        client->errMsg = (errMsg.empty() ? std::string("Subscription refused") : errMsg);
+        client->messageState = ClientContextImpl::MessageState::SENDING_NACK;
+        return;
+    }
+
+    client->topic = std::move(topic);
+    client->messageState = ClientContextImpl::MessageState::SENDING_SUBSCRIBE_ACK;
+}
+
+// Note: The ACK is queued to the subscriber's queue, not to client->outQueue:
+// a message published meanwhile can't be written out ahead of it
+inline bool ProtoServer::Subscribe(ProtoClientContext* client, bool record, std::string& errMsg)
+{
+    auto ack = [record](OutputQueue& queue)
+    {
+        uint32_t code = htonl(PROTO_CODE::ACK);
+        if(record)
+            queue.AddRecord(std::string(reinterpret_cast<const char*>(&code), sizeof(code)), nullptr, 0);
+        else
+            queue.Add(&code, sizeof(code));
+    };
+
+    client->subscriber = mPubSub.Subscribe(client->topic, client->fd, &client->lastActivityTime, ack, errMsg);
+    if(!client->subscriber)
+        return false;
+
+    client->messageState = ClientContextImpl::MessageState::SUBSCRIBED;
+    return true;
+}
+
+inline size_t ProtoServer::Publish(const std::string& topic, const google::protobuf::Message& msg)
+{
+    // Not serialized for nobody
+    if(!mPubSub.HasSubscribers(topic))
+        return 0;
+
+    size_t size = msg.ByteSizeLong();
+    if(size > PROTO_MAX_MESSAGE_SIZE)
+    {
+        OnError(__FNAME__, __LINE__, "The protobuf message of " + std::to_string(size) +
+                " bytes published to topic '" + topic + "' exceeds the 2 GiB limit");
+        return 0;
+    }
+
+    // Large messages over Unix domain sockets: one sealed memfd, each subscriber gets a descriptor
+    bool record = (mSeqPacket && mDomainSocket);
+    size_t fdThreshold = FdPayloadThreshold(record);
+    std::string errMsg;
+    if(size > 0 && size >= fdThreshold)
+    {
+        ProtoPayload payload;
+        char* buf = payload.Allocate(size, fdThreshold, errMsg);
+        if(!buf || !msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf)) || !payload.Seal(errMsg))
+        {
+            OnError(__FNAME__, __LINE__, "Failed to write the message published to topic '" + topic + "': " + errMsg);
+            return 0;
+        }
+
+        return mPubSub.Publish(topic, [&payload, record](OutputQueue& queue)
+        {
+            std::string errMsg;
+            if(record)
+            {
+                ProtoFrameWriter writer;
+                writer.AddData(PROTO_CODE::RESP, payload);
+                return gen::ProtoQueueFrames(queue, writer, errMsg);
+            }
+
+            // The code and the memfd marker, then the memfd with the real length
+            int fd = fcntl(payload.GetFd(), F_DUPFD_CLOEXEC, 0);
+            if(fd == -1)
+                return false;
+            gen::ProtoQueueCode(queue, PROTO_CODE::RESP);
+            gen::ProtoQueueInteger(queue, PROTO_FD_PAYLOAD);
+            uint64_t len = htobe64(payload.size());
+            queue.AddWithFds(&len, sizeof(len), &fd, 1);
+            return true;
+        });
+    }
+
+    // The whole RESP frame is serialized once, and shared by the output queues
+    auto frame = std::make_shared<std::string>();
+    uint32_t header[2] = {htonl(PROTO_CODE::RESP), htonl(static_cast<uint32_t>(size))};
+    frame->resize(sizeof(header) + size);
+    memcpy(frame->data(), header, sizeof(header));
+    if(size > 0 && !msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(frame->data() + sizeof(header))))
+    {
+        OnError(__FNAME__, __LINE__, "Failed to write the message published to topic '" + topic + "'");
+        return 0;
+    }
+
+    std::shared_ptr<const std::string> buffer = std::move(frame);
+    return mPubSub.Publish(topic, [&buffer, record](OutputQueue& queue)
+    {
+        if(record)
+            queue.AddRecord(buffer);
+        else
+            queue.Add(buffer);
+        return true;
+    });
+}
+
+// Decode the metadata block of a request, valid until the next request's.
+// Note: Blocks sent through the table are decoded even for unknown methods:
+// the client has added their pairs to its table.
+inline const std::map<std::string, std::string>* ProtoServer::ParseMetadata(ProtoClientContext* client,
+                                                                           const std::string& data,
+                                                                           std::string& errMsg)
+{
+    if(client->metadataDecoder)
+    {
+        if(!client->metadataDecoder->Decode(data.data(), data.size(), errMsg))
+            return nullptr;
+        return &client->metadataDecoder->Metadata();
+    }
+
+    if(!gen::ParseFromData(data.data(), data.size(), client->metadata, errMsg))
+        return nullptr;
+    return &client->metadata;
+}
+
+// Compress the response if large enough (memfd payloads are sent as they are),
+// and add its checksum
+inline void ProtoServer::EncodeResponse(ProtoClientContext* client, ProtoPayload& data)
+{
+    if(client->codec != Codec::NONE && !data.IsFd() && data.size() >= mCompressionThreshold)
+    {
+        Codec codec = (client->handler && client->handler->codec ? *client->handler->codec : client->codec);
+        std::string errMsg;
+        if(!data.Compress(codec, errMsg))
+            OnError(__FNAME__, __LINE__, "Failed to compress the response (sent uncompressed): " + errMsg);
+    }
+
+    data.SetChecksum(client->checksums);
+}
+
+inline void ProtoServer::CallHandler(Handler* handler, const Context& ctx, const ProtoPayload& reqData,
+                                     ProtoPayload& respData, size_t fdThreshold)
+{
+    const BindOptions& options = handler->options;
+    if(!options.cache && !options.coalesce)
+    {
+        handler->Call(ctx, reqData, respData, fdThreshold);
+        return;
+    }
+
+    // The key: the method, the metadata values the response depends on, and the request bytes.
+    // A missing key ("-") is told from an empty value ("0:").
+    std::string metadata;
+    for(const std::string& key : options.cacheMetadataKeys)
+    {
+        if(!ctx.HasMetadata(key.c_str()))
+        {
+            metadata += "-";
+            continue;
+        }
+        std::string value = ctx.GetMetadata(key.c_str());
+        metadata += std::to_string(value.size()) + ":" + value;
+    }
+    ResponseCache::Key key(ctx.GetMethodId(), ctx.GetRequestName(), std::string_view(reqData.data(), reqData.size()),
+                           std::move(metadata));
+
+    if(options.cache)
+    {
+        if(ResponseCache::Buffer resp = mResponseCache.Find(key))
+            return ShareResponse(ctx, std::move(resp), respData, fdThreshold);
+    }
+
+    ResponseCache::Buffer resp;
+    if(options.coalesce)
+    {
+        bool leader = false;
+        std::shared_ptr<SingleFlight::Flight> flight = mSingleFlight.Join(key, leader);
+        if(!leader)
+        {
+            // The same call is running: share its outcome, unless it's slow or can't be shared
+            if(!SingleFlight::Wait(*flight, options.coalesceTimeout) || !flight->shared)
+                return (void)handler->Call(ctx, reqData, respData, fdThreshold);
+
+            if(!flight->errMsg.empty())
+                ctx.SetError(flight->errMsg);
+            return ShareResponse(ctx, flight->response, respData, fdThreshold);
+        }
+
+        resp = CallShared(handler, ctx, reqData, respData, fdThreshold);
+        mSingleFlight.Land(key, flight, (resp != nullptr), resp, ctx.GetError());
+    }
+    else
+    {
+        resp = CallShared(handler, ctx, reqData, respData, fdThreshold);
+    }
+
+    if(options.cache && resp && ctx.GetError().empty())
+        mResponseCache.Insert(key, std::move(resp), options.cacheTtl);
+}
+
+// Call the handler and keep its response in a shared buffer. nullptr if it has an attachment.
+inline ResponseCache::Buffer ProtoServer::CallShared(Handler* handler, const Context& ctx, const ProtoPayload& reqData,
+                                                     ProtoPayload& respData, size_t fdThreshold)
+{
+    handler->Call(ctx, reqData, respData, fdThreshold);
+    if(ctx.HasAttachment())
+        return nullptr;
+
+    // The response is sent from the shared buffer (a memfd response is read back from its memfd)
+    ResponseCache::Buffer resp;
+    if(respData.IsFd())
+    {
+        std::string data(respData.size(), '\0');
+        if(pread(respData.GetFd(), data.data(), data.size(), 0) != static_cast<ssize_t>(data.size()))
+            return nullptr;
+        resp = std::make_shared<const std::string>(std::move(data));
+    }
+    else
+    {
+        resp = std::make_shared<const std::string>(std::move(respData.str()));
+        respData.Share(resp);
+    }
+    return resp;
+}
+
+// Send a shared response buffer as it is, or in a memfd if it's large
+inline void ProtoServer::ShareResponse(const Context& ctx, ResponseCache::Buffer resp,
+                                       ProtoPayload& respData, size_t fdThreshold)
+{
+    if(resp->size() < fdThreshold)
+    {
+        respData.Share(std::move(resp));
+        return;
+    }
+
+    std::string errMsg;
+    char* buf = respData.Allocate(resp->size(), fdThreshold, errMsg);
+    if(buf)
+        memcpy(buf, resp->data(), resp->size());
+    if(!buf || !respData.Seal(errMsg))
+    {
+        respData.Clear();
+        ctx.SetError("Failed to send the shared response: " + errMsg);
+    }
+}
+
+// Serve the requests of a shared memory client. Runs in its own thread until
+// the client disconnects (the context destructor sets shmStop).
+inline void ProtoServer::ShmSession(ProtoClientContext* client)
+{
+    ShmRing& requests = client->shm->Requests();
+    ShmRing& responses = client->shm->Responses();
+    const ShmDeadline noDeadline = ShmDeadline::max();
+    const std::atomic<bool>* stop = &client->shmStop;
+
+    ProtoFrameWriter writer;
+    std::string errMsg;
+    std::string reqName, metadataData;
+    uint32_t methodId = 0;
+    ProtoPayload reqData, respData;     // Note: Always in memory, no memfd payloads over shared memory
+
+    while(true)
+    {
+        // Receive the request code: REQ_NAME (request type name) or REQ_ID (method id)
+        uint32_t code = 0;
+        if(!gen::ShmRecvInteger(requests, code, noDeadline, stop, errMsg))
+            break;
+
+        Handler* handler = nullptr;
+        std::string handlerErr;
+        if(code == PROTO_CODE::REQ_ID)
+        {
+            reqName.clear();
+            if(!gen::ShmRecvInteger(requests, methodId, noDeadline, stop, errMsg))
+                break;
+            handler = GetCallHandler(methodId, handlerErr);
+        }
+        else if(gen::ProtoValidateCode(code, PROTO_CODE::REQ_NAME, errMsg))
+        {
+            methodId = 0;
+            if(!gen::ShmRecvPayload(requests, reqName, noDeadline, stop, errMsg))
+                break;
+            handler = GetCallHandler(reqName, handlerErr);
+        }
+        else
+        {
+            break;
+        }
+
+        // Receive REQ (request data) and metadata
+        const std::map<std::string, std::string>* metadata = nullptr;
+        if(!gen::ShmRecvData(requests, PROTO_CODE::REQ, reqData.str(), noDeadline, stop, errMsg) ||
+           !gen::ShmRecvData(requests, PROTO_CODE::METADATA, metadataData, noDeadline, stop, errMsg) ||
+           !(metadata = ParseMetadata(client, metadataData, errMsg)))
+            break;
+
+        client->lastActivityTime = std::chrono::steady_clock::now();
+
+        // Process the request and send the response at once
+        Context ctx(*metadata, &client->connectionMetadata, methodId, &reqName);
+        if(handler && handler->IsClientStreaming())
+        {
+            writer.AddInteger(PROTO_CODE::NACK);
+            writer.AddData(PROTO_CODE::ERR, std::string("Client streaming is not supported over shared memory"));
+        }
+        else if(handler && handler->IsStreaming())
+        {
+            // Server streaming: RESP frames as the handler produces them, then ERR
+            ShmSink sink(client);
+            if(!handler->CallStream(ctx, reqData, sink))
+            {
+                errMsg = sink.errMsg;
+                break;
+            }
+            writer.AddData(PROTO_CODE::ERR, ctx.GetError());
+        }
+        else if(handler)
+        {
+            CallHandler(handler, ctx, reqData, respData, NO_FD_PAYLOAD);
+            if(ctx.HasAttachment())
+                ctx.SetError("File attachments are not supported over shared memory");
+            writer.AddData(PROTO_CODE::RESP, respData);
+            writer.AddData(PROTO_CODE::ERR, ctx.GetError());
+        }
+        else
+        {
+            writer.AddInteger(PROTO_CODE::NACK);
+            writer.AddData(PROTO_CODE::ERR, handlerErr);
+        }
+
+        if(!gen::ShmSendFrames(responses, writer, noDeadline, stop, errMsg))
+            break;
+    }
+
+    if(!client->shmStop)
+    {
+        // Protocol error: disconnect, the epoll loop then cleans up the client
+        OnError(__FNAME__, __LINE__, "Shared memory session failed: " + errMsg);
+        shutdown(client->fd, SHUT_RDWR);
+    }
+}
+
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::HandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx, const ProtoPayload& reqData,
+                                                       ProtoPayload& respData, size_t fdThreshold)
+{
+    // Note: Parse in place, the request data may be a mapped memfd
+    REQ req;
+    respData.Clear();
+    if(reqData.size() > INT_MAX || !req.ParseFromArray(reqData.data(), static_cast<int>(reqData.size())))
+    {
+        ctx.SetError("Failed to read protobuf request message");
+        return false;
+    }
+
+    // Call the handler function
+    RESP resp;
+    (srv->*fptr)(ctx, req, resp);
+    return SerializeResponse(ctx, resp, respData, fdThreshold);
+}
+
+inline bool ProtoServer::SerializeResponse(const Context& ctx, const google::protobuf::Message& resp,
+                                           ProtoPayload& respData, size_t fdThreshold)
+{
+    std::string errMsg;
+    size_t size = resp.ByteSizeLong();
+    if(size > PROTO_MAX_MESSAGE_SIZE)
+    {
+        ctx.SetError("The protobuf response message of " + std::to_string(size) + " bytes exceeds the 2 GiB limit");
+        return false;
+    }
+    char* buf = respData.Allocate(size, fdThreshold, errMsg);
+    if(!buf || (size > 0 && !resp.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf))) ||
+       !respData.Seal(errMsg))
+    {
+        respData.Clear();
+        ctx.SetError("Failed to write protobuf response message " + errMsg);
+        return false;
+    }
+
+    return true;
+}
+
+template<class REQ>
+const REQ& ProtoServer::Lazy<REQ>::Get() const
+{
+    if(!mReq)
+    {
+        // Note: Parse in place, the request data may be a mapped memfd
+        mReq.emplace();
+        if(mRaw.size() > INT_MAX || !mReq->ParseFromArray(mRaw.data(), static_cast<int>(mRaw.size())))
+        {
+            mReq->Clear();
+            mInvalid = true;
+        }
+    }
+    return *mReq;
+}
+
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::LazyHandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx, const ProtoPayload& reqData,
+                                                           ProtoPayload& respData, size_t fdThreshold)
+{
+    respData.Clear();
+    Lazy<REQ> req(std::string_view(reqData.data(), reqData.size()));
+    RESP resp;
+    (srv->*fptr)(ctx, req, resp);
+
+    // The handler has seen an empty message instead
+    if(req.IsInvalid())
+    {
+        ctx.SetError("Failed to read protobuf request message");
+        return false;
+    }
+    return SerializeResponse(ctx, resp, respData, fdThreshold);
+}
+
+template<class SERVER>
+bool ProtoServer::RawHandlerImpl<SERVER>::Call(const ProtoServer::Context& ctx, const ProtoPayload& reqData,
+                                               ProtoPayload& respData, size_t fdThreshold)
+{
+    // The handler writes to the payload's own buffer (recycled by the zero copy path)
+    respData.Clear();
+    std::string& resp = respData.str();
+    (srv->*fptr)(ctx, std::string_view(reqData.data(), reqData.size()), resp);
+
+    std::string errMsg;
+    if(resp.size() > PROTO_MAX_MESSAGE_SIZE)
+    {
+        ctx.SetError("The response of " + std::to_string(resp.size()) + " bytes exceeds the 2 GiB limit");
+        respData.Clear();
+        return false;
+    }
+
+    // Large responses go in a memfd
+    if(!resp.empty() && resp.size() >= fdThreshold)
+    {
+        std::string data;
+        data.swap(resp);
+        char* buf = respData.Allocate(data.size(), fdThreshold, errMsg);
+        if(buf)
+            memcpy(buf, data.data(), data.size());
+        if(!buf || !respData.Seal(errMsg))
+        {
+            respData.Clear();
+            ctx.SetError("Failed to write the response " + errMsg);
+            return false;
+        }
+    }
+    return true;
+}
+
+template<class RESP>
+bool ProtoServer::StreamWriter<RESP>::Write(const RESP& msg)
+{
+    if(mSink.broken)
+        return false;
+
+    // Serialize the message straight into the payload buffer
+    ProtoPayload data;
+    std::string errMsg;
+    size_t size = msg.ByteSizeLong();
+    if(size > PROTO_MAX_MESSAGE_SIZE)
+        return false;
+    char* buf = data.Allocate(size, mSink.fdThreshold, errMsg);
+    if(!buf || (size > 0 && !msg.SerializeWithCachedSizesToArray(reinterpret_cast<uint8_t*>(buf))) ||
+       !data.Seal(errMsg))
+        return false;
+
+    return mSink.Send(data);
+}
+
+template<class REQ>
+bool ProtoServer::StreamReader<REQ>::Read(REQ& msg)
+{
+    // Note: Parse in place, the request data may be a mapped memfd
+    ProtoPayload data;
+    if(mSource.invalid || !mSource.Recv(data))
+        return false;
+
+    if(data.size() > INT_MAX || !msg.ParseFromArray(data.data(), static_cast<int>(data.size())))
+    {
+        mSource.invalid = true;
+        return false;
+    }
+    return true;
+}
+
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::StreamHandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx, const ProtoPayload& /*reqData*/,
+                                                             ProtoPayload& respData, size_t /*fdThreshold*/)
+{
+    respData.Clear();
+    ctx.SetError("Server-streaming method called as unary");
+    return false;
+}
+
+// Returns false if the stream is broken (the connection can't be used any more)
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::StreamHandlerImpl<SERVER, REQ, RESP>::CallStream(const ProtoServer::Context& ctx, const ProtoPayload& reqData,
+                                                                   StreamSink& sink)
+{
+    // Note: Parse in place, the request data may be a mapped memfd
+    REQ req;
+    if(reqData.size() > INT_MAX || !req.ParseFromArray(reqData.data(), static_cast<int>(reqData.size())))
+    {
+        ctx.SetError("Failed to read protobuf request message");
+        return true;
+    }
+
+    // Call the handler function
+    StreamWriter<RESP> writer(sink);
+    (srv->*fptr)(ctx, req, writer);
+
+    if(ctx.HasAttachment())
+        ctx.SetError("File attachments are not supported by streaming methods");
+    return !sink.broken;
+}
+
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::ClientStreamHandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx, const ProtoPayload& /*reqData*/,
+                                                                   ProtoPayload& respData, size_t /*fdThreshold*/)
+{
+    respData.Clear();
+    ctx.SetError("Client-streaming method called as unary");
+    return false;
+}
+
+// The single response goes to the sink as a one-message stream.
+// Returns false if the stream is broken (the connection can't be used any more).
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::ClientStreamHandlerImpl<SERVER, REQ, RESP>::CallClientStream(const ProtoServer::Context& ctx, StreamSource& source,
+                                                                               StreamSink& sink)
+{
+    // Call the handler function
+    StreamReader<REQ> reader(source);
+    RESP resp;
+    (srv->*fptr)(ctx, reader, resp);
+    if(source.broken)
+        return false;
+
+    if(source.invalid)
+        ctx.SetError("Failed to read protobuf request message");
+    else if(ctx.HasAttachment())
+        ctx.SetError("File attachments are not supported by streaming methods");
+
+    StreamWriter<RESP> writer(sink);
+    if(!writer.Write(resp) && !sink.broken)
+        ctx.SetError("Failed to write protobuf response message");
+    return !sink.broken;
+}
+
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::BidiStreamHandlerImpl<SERVER, REQ, RESP>::Call(const ProtoServer::Context& ctx, const ProtoPayload& /*reqData*/,
+                                                                 ProtoPayload& respData, size_t /*fdThreshold*/)
+{
+    respData.Clear();
+    ctx.SetError("Bidirectional-streaming method called as unary");
+    return false;
+}
+
+// Returns false if the stream is broken (the connection can't be used any more)
+template<class SERVER, class REQ, class RESP>
+bool ProtoServer::BidiStreamHandlerImpl<SERVER, REQ, RESP>::CallClientStream(const ProtoServer::Context& ctx, StreamSource& source,
+                                                                             StreamSink& sink)
+{
+    // Call the handler function
+    StreamReader<REQ> reader(source);
+    StreamWriter<RESP> writer(sink);
+    (srv->*fptr)(ctx, reader, writer);
+
+    if(source.invalid)
+        ctx.SetError("Failed to read protobuf request message");
+    else if(ctx.HasAttachment())
+        ctx.SetError("File attachments are not supported by streaming methods");
+    return (!source.broken && !sink.broken);
+}
+
 } // namespace gen
 
 #endif // __PROTO_SERVER_HPP__
@@ -0,0 +1,414 @@
+//
+// pubSub.hpp
+//
+#ifndef __PUB_SUB_HPP__
+#define __PUB_SUB_HPP__
+
+#include "socketCommon.hpp"
+#include <sys/eventfd.h>    // eventfd()
+#include <poll.h>           // poll()
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace gen {
+
+const size_t DEFAULT_SUBSCRIBER_QUEUE_LIMIT = 8 * 1024 * 1024;  // Bytes
+const int PUB_SUB_KEEPALIVE_MS = 1000;
+
+//
+// Topics and their subscribers (connections, see ProtoServer::Publish()). A
+// message is queued to each subscriber's own output queue by reference (see
+// OutputQueue::Add()) and written out right away without blocking: one send
+// per subscriber. What a socket doesn't take is written out by the flusher
+// thread as the subscriber reads.
+//
+// Backpressure: a subscriber with more than the queue limit waiting (it reads
+// slower than the topic is published) is evicted, its connection shut down,
+// so the publishers never wait for it.
+//
+class PubSub
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using EvictCallback = std::function<void(const std::string& msg)>;
+
+    explicit PubSub(EvictCallback onEvict = nullptr) : mOnEvict(std::move(onEvict)) {}
+    ~PubSub() { Stop(); }
+
+    // The bytes a subscriber may have waiting (larger than the largest message)
+    void SetQueueLimit(size_t bytes) { mQueueLimit = bytes; }
+
+    struct Subscriber
+    {
+        PubSub* pubSub{nullptr};
+        std::string topic;
+
+        std::mutex mutex;
+        int fd{-1};             // The connection's socket, duplicated (-1 once unsubscribed)
+        OutputQueue queue;
+        bool pending{false};    // The flusher thread writes out the rest of the queue
+        bool closed{false};     // Unsubscribed, evicted, or the connection failed
+
+        // The connection's last activity: kept fresh while it's subscribed
+        std::atomic<Clock::time_point>* activity{nullptr};
+    };
+    using SubscriberPtr = std::shared_ptr<Subscriber>;
+
+    // Subscribe the connection sock to topic. first queues what goes before the
+    // messages (e.g. the ACK of the subscription); the connection keeps activity
+    // up to date. nullptr on error.
+    SubscriberPtr Subscribe(const std::string& topic, int sock, std::atomic<Clock::time_point>* activity,
+                            const std::function<void(OutputQueue&)>& first, std::string& errMsg);
+    void Unsubscribe(const SubscriberPtr& subscriber);
+
+    // Queue a message to the subscribers of topic with enqueue, and write it out.
+    // Returns the subscribers it was queued to.
+    size_t Publish(const std::string& topic, const std::function<bool(OutputQueue&)>& enqueue);
+
+    bool HasSubscribers(const std::string& topic) { return (GetSubscribers(topic) != nullptr); }
+    size_t GetSubscriberCount(const std::string& topic)
+    {
+        auto subscribers = GetSubscribers(topic);
+        return (subscribers ? subscribers->size() : 0);
+    }
+
+    // Stop the flusher thread (started by the first subscription) once the
+    // subscribers are gone
+    void Stop();
+
+private:
+    // Replaced (not modified) on subscribe and unsubscribe, so a publisher
+    // iterates over its own copy without holding the lock
+    using Subscribers = std::vector<SubscriberPtr>;
+
+    std::shared_ptr<const Subscribers> GetSubscribers(const std::string& topic)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto itr = mTopics.find(topic);
+        return (itr != mTopics.end() ? itr->second : nullptr);
+    }
+
+    // Write out the queue of subscriber (locked). Returns false if it's closed.
+    bool Flush(Subscriber& subscriber);
+    void Evict(Subscriber& subscriber);
+    static void Close(Subscriber& subscriber);
+
+    void Run();
+    void KeepAlive();
+    void Wake();
+
+    EvictCallback mOnEvict;
+    size_t mQueueLimit{DEFAULT_SUBSCRIBER_QUEUE_LIMIT};
+
+    std::mutex mMutex;
+    std::unordered_map<std::string, std::shared_ptr<const Subscribers>> mTopics;
+    std::thread mThread;
+    std::atomic<bool> mStop{false};
+    int mWakeFd{-1};                    // eventfd: new pending subscribers
+
+    std::mutex mPendingMutex;
+    std::vector<SubscriberPtr> mPending;    // Handed over to the flusher thread
+
+    // No copy constructors
+    PubSub(const PubSub&) = delete;
+    PubSub& operator=(const PubSub&) = delete;
+};
+
+inline PubSub::SubscriberPtr PubSub::Subscribe(const std::string& topic, int sock,
+                                               std::atomic<Clock::time_point>* activity,
+                                               const std::function<void(OutputQueue&)>& first,
+                                               std::string& errMsg)
+{
+    // Note: The socket is duplicated, so a publisher never writes to a descriptor
+    // the server has closed (and maybe reused) meanwhile
+    auto subscriber = std::make_shared<Subscriber>();
+    subscriber->pubSub = this;
+    subscriber->topic = topic;
+    subscriber->activity = activity;
+    if((subscriber->fd = fcntl(sock, F_DUPFD_CLOEXEC, 0)) == -1)
+    {
+        errMsg = "fcntl(F_DUPFD_CLOEXEC) failed: " + std::string(strerror(errno));
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if(!mThread.joinable())
+    {
+        if((mWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) == -1)
+        {
+            errMsg = "eventfd() failed: " + std::string(strerror(errno));
+            Close(*subscriber);
+            return nullptr;
+        }
+        mStop = false;
+        mThread = std::thread(&PubSub::Run, this);
+    }
+
+    // Queued before the topic's next message
+    {
+        std::lock_guard<std::mutex> subscriberLock(subscriber->mutex);
+        first(subscriber->queue);
+        if(!Flush(*subscriber))
+        {
+            errMsg = "Failed to write to the subscriber";
+            return nullptr;
+        }
+    }
+
+    auto& subscribers = mTopics[topic];
+    auto updated = std::make_shared<Subscribers>();
+    if(subscribers)
+    {
+        updated->reserve(subscribers->size() + 1);
+        *updated = *subscribers;
+    }
+    updated->push_back(subscriber);
+    subscribers = std::move(updated);
+    return subscriber;
+}
+
+inline void PubSub::Unsubscribe(const SubscriberPtr& subscriber)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(auto itr = mTopics.find(subscriber->topic); itr != mTopics.end())
+        {
+            auto updated = std::make_shared<Subscribers>();
+            updated->reserve(itr->second->size());
+            for(const SubscriberPtr& other : *itr->second)
+            {
+                if(other != subscriber)
+                    updated->push_back(other);
+            }
+
+            if(updated->empty())
+                mTopics.erase(itr);
+            else
+                itr->second = std::move(updated);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(subscriber->mutex);
+    subscriber->activity = nullptr;
+    Close(*subscriber);
+}
+
+inline size_t PubSub::Publish(const std::string& topic, const std::function<bool(OutputQueue&)>& enqueue)
+{
+    std::shared_ptr<const Subscribers> subscribers = GetSubscribers(topic);
+    if(!subscribers)
+        return 0;
+
+    size_t count = 0;
+    bool wake = false;
+    for(const SubscriberPtr& subscriber : *subscribers)
+    {
+        std::lock_guard<std::mutex> lock(subscriber->mutex);
+        if(subscriber->closed || !enqueue(subscriber->queue))
+            continue;
+
+        // Waiting for the flusher thread already: the message goes after the rest
+        if(!subscriber->pending)
+        {
+            if(!Flush(*subscriber))
+                continue;
+
+            if(!subscriber->queue.Empty() && subscriber->queue.Size() <= mQueueLimit)
+            {
+                subscriber->pending = true;
+                std::lock_guard<std::mutex> pendingLock(mPendingMutex);
+                mPending.push_back(subscriber);
+                wake = true;
+            }
+        }
+
+        if(subscriber->queue.Size() > mQueueLimit)
+        {
+            Evict(*subscriber);
+            continue;
+        }
+        count++;
+    }
+
+    if(wake)
+        Wake();
+    return count;
+}
+
+inline bool PubSub::Flush(Subscriber& subscriber)
+{
+    size_t size = subscriber.queue.Size();
+    std::string errMsg;
+    if(!subscriber.queue.Flush(subscriber.fd, errMsg))
+    {
+        // The client is gone: the server closes the connection
+        Close(subscriber);
+        return false;
+    }
+
+    if(subscriber.activity && subscriber.queue.Size() < size)
+        *subscriber.activity = Clock::now();
+    return true;
+}
+
+inline void PubSub::Evict(Subscriber& subscriber)
+{
+    if(mOnEvict)
+    {
+        mOnEvict("Evicted a slow subscriber of topic '" + subscriber.topic + "': " +
+                 std::to_string(subscriber.queue.Size()) + " bytes waiting");
+    }
+
+    // Note: The server sees the connection shut down and closes it
+    shutdown(subscriber.fd, SHUT_RDWR);
+    Close(subscriber);
+}
+
+inline void PubSub::Close(Subscriber& subscriber)
+{
+    subscriber.closed = true;
+    subscriber.queue.Clear();
+    if(subscriber.fd != -1)
+    {
+        close(subscriber.fd);
+        subscriber.fd = -1;
+    }
+}
+
+inline void PubSub::Wake()
+{
+    uint64_t value = 1;
+    if(write(mWakeFd, &value, sizeof(value)) == -1)
+    {
+        // EAGAIN: the counter is full, the thread is woken already
+    }
+}
+
+inline void PubSub::Stop()
+{
+    // Note: Joined without the lock, the thread takes it (see KeepAlive())
+    std::thread thread;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(!mThread.joinable())
+            return;
+        mStop = true;
+        Wake();
+        thread = std::move(mThread);
+    }
+    thread.join();
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    close(mWakeFd);
+    mWakeFd = -1;
+
+    std::lock_guard<std::mutex> pendingLock(mPendingMutex);
+    mPending.clear();
+}
+
+// The flusher thread: writes out the queues the sockets didn't take at once,
+// as the subscribers read
+inline void PubSub::Run()
+{
+    std::vector<SubscriberPtr> pending;
+    std::vector<pollfd> fds;
+    Clock::time_point lastKeepAlive = Clock::now();
+
+    while(!mStop)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mPendingMutex);
+            pending.insert(pending.end(), mPending.begin(), mPending.end());
+            mPending.clear();
+        }
+
+        // Wait for the wake up, and for the pending subscribers to be writable
+        fds.resize(1);
+        fds[0] = pollfd{mWakeFd, POLLIN, 0};
+        for(size_t i = 0; i < pending.size(); )
+        {
+            std::lock_guard<std::mutex> lock(pending[i]->mutex);
+            if(pending[i]->closed)
+            {
+                pending[i]->pending = false;
+                pending[i] = std::move(pending.back());
+                pending.pop_back();
+                continue;
+            }
+            fds.push_back(pollfd{pending[i]->fd, POLLOUT, 0});
+            i++;
+        }
+
+        if(poll(fds.data(), fds.size(), PUB_SUB_KEEPALIVE_MS) > 0)
+        {
+            uint64_t value = 0;
+            if((fds[0].revents & POLLIN) && read(mWakeFd, &value, sizeof(value)) == -1)
+            {
+                // EAGAIN: woken up meanwhile
+            }
+
+            // Note: Iterated backwards, the written out subscribers are removed
+            for(size_t i = pending.size(); i-- > 0; )
+            {
+                if(fds[i + 1].revents == 0)
+                    continue;
+
+                Subscriber& subscriber = *pending[i];
+                std::lock_guard<std::mutex> lock(subscriber.mutex);
+                if(!subscriber.closed && Flush(subscriber) && !subscriber.queue.Empty())
+                    continue;
+
+                subscriber.pending = false;
+                pending[i] = std::move(pending.back());
+                pending.pop_back();
+            }
+        }
+
+        if(Clock::now() - lastKeepAlive >= std::chrono::milliseconds(PUB_SUB_KEEPALIVE_MS))
+        {
+            KeepAlive();
+            lastKeepAlive = Clock::now();
+        }
+    }
+
+    for(const SubscriberPtr& subscriber : pending)
+    {
+        std::lock_guard<std::mutex> lock(subscriber->mutex);
+        subscriber->pending = false;
+    }
+}
+
+// A subscription is not idle while the topic is quiet: keep the connections
+// from the server's idle timeout
+inline void PubSub::KeepAlive()
+{
+    std::vector<std::shared_ptr<const Subscribers>> topics;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        topics.reserve(mTopics.size());
+        for(const auto& pair : mTopics)
+            topics.push_back(pair.second);
+    }
+
+    Clock::time_point now = Clock::now();
+    for(const auto& subscribers : topics)
+    {
+        for(const SubscriberPtr& subscriber : *subscribers)
+        {
+            std::lock_guard<std::mutex> lock(subscriber->mutex);
+            if(subscriber->activity)
+                *subscriber->activity = now;
+        }
+    }
+}
+
+} // namespace gen
+
+#endif // __PUB_SUB_HPP__
@@ -0,0 +1,213 @@
+//
+// responseCache.hpp
+//
+#ifndef __RESPONSE_CACHE_HPP__
+#define __RESPONSE_CACHE_HPP__
+
+#include "crc32c.hpp"
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace gen {
+
+const size_t DEFAULT_RESPONSE_CACHE_SIZE = 64 * 1024 * 1024;   // Bytes
+const size_t RESPONSE_CACHE_SHARDS = 16;
+const size_t RESPONSE_CACHE_ENTRY_OVERHEAD = 128;               // Per entry, counted in the budget
+
+//
+// Serialized responses of the methods that are pure functions of their request
+// (see ProtoServer::BindOptions), keyed by the method, the request bytes and the
+// values of the metadata keys the response depends on. Entries expire after
+// their TTL, and the least recently used ones are evicted to stay in the byte
+// budget.
+//
+// Sharded on the key hash (CRC32C), each shard with its own lock, LRU list and
+// 1/16th of the budget, so concurrent calls seldom wait on each other. An entry
+// larger than a shard's budget (MaxEntrySize(), 4 MB of the default 64 MB) is
+// not cached. A response is shared, not copied, with the output queues it's
+// sent from.
+//
+class ResponseCache
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Buffer = std::shared_ptr<const std::string>;
+
+    explicit ResponseCache(size_t maxSize = DEFAULT_RESPONSE_CACHE_SIZE) { SetMaxSize(maxSize); }
+
+    // The byte budget: request, metadata and response bytes of the entries.
+    // Shrinking it evicts the least recently used entries.
+    void SetMaxSize(size_t bytes);
+    size_t MaxSize() const { return mMaxSize; }
+
+    // The largest entry cached, a shard's budget
+    size_t MaxEntrySize() const { return mMaxSize / RESPONSE_CACHE_SHARDS; }
+
+    struct Key
+    {
+        Key(uint32_t _methodId, std::string_view _reqName, std::string_view _request, std::string _metadata) :
+            methodId(_methodId), reqName(_reqName), request(_request), metadata(std::move(_metadata))
+        {
+            hash = gen::Crc32c(&methodId, sizeof(methodId));
+            hash = gen::Crc32c(reqName.data(), reqName.size(), hash);
+            hash = gen::Crc32c(metadata.data(), metadata.size(), hash);
+            hash = gen::Crc32c(request.data(), request.size(), hash);
+        }
+
+        uint32_t methodId;          // Or 0 and
+        std::string_view reqName;   // the request type name
+        std::string_view request;
+        std::string metadata;       // The values of the keys the response depends on
+        uint32_t hash;
+    };
+
+    // The response cached for key, nullptr if there's none (or it has expired)
+    Buffer Find(const Key& key);
+
+    // Cache the response for ttl
+    void Insert(const Key& key, Buffer response, std::chrono::milliseconds ttl);
+
+    void Clear();
+
+private:
+    struct Entry
+    {
+        uint32_t hash;
+        uint32_t methodId;
+        std::string reqName;
+        std::string request;
+        std::string metadata;
+        Buffer response;
+        Clock::time_point expiry;
+        size_t size;
+
+        bool Matches(const Key& key) const
+        {
+            return (methodId == key.methodId && reqName == key.reqName &&
+                    metadata == key.metadata && request == key.request);
+        }
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> entries;   // The most recently used first
+        std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+        size_t size{0};
+        size_t maxSize{0};
+
+        void Erase(std::list<Entry>::iterator itr)
+        {
+            size -= itr->size;
+            index.erase(itr->hash);
+            entries.erase(itr);
+        }
+
+        // Make room for bytes: the expired entries first, then the least recently used
+        void Evict(size_t bytes, Clock::time_point now);
+    };
+
+    Shard& GetShard(uint32_t hash) { return mShards[(hash >> 16) % RESPONSE_CACHE_SHARDS]; }
+
+    Shard mShards[RESPONSE_CACHE_SHARDS];
+    std::atomic<size_t> mMaxSize{0};
+};
+
+inline void ResponseCache::Shard::Evict(size_t bytes, Clock::time_point now)
+{
+    // Expired entries are otherwise only dropped when looked up: drop the least
+    // recently used ones as they come, and scan for the others when short of room
+    while(!entries.empty() && entries.back().expiry <= now)
+        Erase(std::prev(entries.end()));
+    if(size + bytes > maxSize)
+    {
+        for(auto itr = entries.begin(); itr != entries.end();)
+        {
+            auto next = std::next(itr);
+            if(itr->expiry <= now)
+                Erase(itr);
+            itr = next;
+        }
+    }
+
+    while(!entries.empty() && size + bytes > maxSize)
+        Erase(std::prev(entries.end()));
+}
+
+inline void ResponseCache::SetMaxSize(size_t bytes)
+{
+    mMaxSize = bytes;
+    Clock::time_point now = Clock::now();
+    for(Shard& shard : mShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.maxSize = bytes / RESPONSE_CACHE_SHARDS;
+        shard.Evict(0, now);
+    }
+}
+
+inline ResponseCache::Buffer ResponseCache::Find(const Key& key)
+{
+    Shard& shard = GetShard(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto itr = shard.index.find(key.hash);
+    if(itr == shard.index.end())
+        return nullptr;
+
+    auto entry = itr->second;
+    if(entry->expiry <= Clock::now())
+    {
+        shard.Erase(entry);
+        return nullptr;
+    }
+    if(!entry->Matches(key))
+        return nullptr;     // Hash collision
+
+    shard.entries.splice(shard.entries.begin(), shard.entries, entry);
+    return entry->response;
+}
+
+inline void ResponseCache::Insert(const Key& key, Buffer response, std::chrono::milliseconds ttl)
+{
+    size_t size = key.reqName.size() + key.request.size() + key.metadata.size() + response->size() +
+                  RESPONSE_CACHE_ENTRY_OVERHEAD;
+
+    Clock::time_point now = Clock::now();
+    Shard& shard = GetShard(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(size > shard.maxSize)
+        return;
+
+    // Replace the entry of the same hash (the same key, or a collision)
+    if(auto itr = shard.index.find(key.hash); itr != shard.index.end())
+        shard.Erase(itr->second);
+
+    shard.Evict(size, now);
+
+    shard.entries.push_front(Entry{key.hash, key.methodId, std::string(key.reqName), std::string(key.request),
+                                   key.metadata, std::move(response), now + ttl, size});
+    shard.index[key.hash] = shard.entries.begin();
+    shard.size += size;
+}
+
+inline void ResponseCache::Clear()
+{
+    for(Shard& shard : mShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+        shard.size = 0;
+    }
+}
+
+} // namespace gen
+
+#endif // __RESPONSE_CACHE_HPP__
@@ -0,0 +1,461 @@
+//
+// shmCommon.hpp
+//
+// Shared memory transport for same-host IPC: a pair of single-producer/
+// single-consumer ring buffers in one memfd mapping. The client creates the
+// memfd and passes it to the server over the Unix domain socket (SCM_RIGHTS),
+// then the messages are copied through the rings instead of the socket.
+// A waiting side spins for a while and then sleeps on a futex placed in the
+// shared mapping; the other side wakes it only if it actually sleeps.
+//
+#ifndef __SHM_COMMON_HPP__
+#define __SHM_COMMON_HPP__
+
+#include <unistd.h>
+#include <sys/mman.h>       // memfd_create(), mmap()
+#include <sys/stat.h>       // fstat()
+#include <sys/syscall.h>    // SYS_futex
+#include <sys/uio.h>        // iovec
+#include <fcntl.h>          // F_ADD_SEALS
+#include <linux/futex.h>
+#include <climits>          // INT_MAX
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>         // hardware_concurrency()
+#include <new>
+#include "protoCommon.hpp"
+
+namespace gen {
+
+const size_t SHM_DEFAULT_RING_SIZE = 1024 * 1024;       // Bytes per direction
+const size_t SHM_MAX_RING_SIZE = 1024 * 1024 * 1024;
+const int SHM_SPIN_COUNT = 4000;        // Busy-wait iterations before sleeping on the futex
+const long SHM_SLEEP_SLICE_MS = 100;    // Sleep at most this long, then re-check cancel flag and deadline
+
+using ShmDeadline = std::chrono::time_point<std::chrono::steady_clock>;
+
+inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Note: Shared (not FUTEX_PRIVATE_FLAG) futex: the waiter and the waker are different processes
+inline void FutexWait(std::atomic<uint32_t>* addr, uint32_t expected, long timeoutMs)
+{
+    struct timespec ts = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000};
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline void FutexWake(std::atomic<uint32_t>* addr)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+// Ring header at the beginning of each ring in the shared mapping.
+// Producer and consumer fields are kept on separate cache lines.
+struct ShmRingHeader
+{
+    // Written by the producer
+    alignas(64) std::atomic<uint64_t> head{0};          // Total bytes written
+    std::atomic<uint32_t> dataSeq{0};                   // Futex word: bumped on every publish
+    std::atomic<uint32_t> spaceWaiters{0};              // Producer is sleeping on spaceSeq
+
+    // Written by the consumer
+    alignas(64) std::atomic<uint64_t> tail{0};          // Total bytes read
+    std::atomic<uint32_t> spaceSeq{0};                  // Futex word: bumped on every consume
+    std::atomic<uint32_t> dataWaiters{0};               // Consumer is sleeping on dataSeq
+
+    alignas(64) uint64_t capacity{0};                   // Size of the data area that follows
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "Shared memory rings require address-free (lock-free) atomics");
+
+//
+// Single-producer/single-consumer byte stream over a ring in shared memory
+//
+class ShmRing
+{
+public:
+    static size_t MappingSize(size_t capacity) { return sizeof(ShmRingHeader) + capacity; }
+
+    void Attach(void* mem, size_t capacity)
+    {
+        mHeader = static_cast<ShmRingHeader*>(mem);
+        mData = static_cast<char*>(mem) + sizeof(ShmRingHeader);
+        mCapacity = capacity;
+    }
+
+    // Producer: write the buffers as one contiguous byte stream
+    bool Write(const iovec* iov, int iovCount, ShmDeadline deadline,
+               const std::atomic<bool>* cancel, std::string& errMsg);
+
+    // Consumer: read exactly len bytes
+    bool Read(void* buf, size_t len, ShmDeadline deadline,
+              const std::atomic<bool>* cancel, std::string& errMsg);
+
+    // Wake up both sides (e.g. to let them see the cancel flag)
+    void WakeAll()
+    {
+        mHeader->dataSeq.fetch_add(1);
+        FutexWake(&mHeader->dataSeq);
+        mHeader->spaceSeq.fetch_add(1);
+        FutexWake(&mHeader->spaceSeq);
+    }
+
+private:
+    template<class COND>
+    bool Wait(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters, COND cond,
+              ShmDeadline deadline, const std::atomic<bool>* cancel, std::string& errMsg);
+
+    void PublishHead(uint64_t head);
+    void PublishTail(uint64_t tail);
+
+    ShmRingHeader* mHeader{nullptr};
+    char* mData{nullptr};
+    size_t mCapacity{0};    // Local copy: the peer can't change it under us
+};
+
+template<class COND>
+inline bool ShmRing::Wait(std::atomic<uint32_t>& seq, std::atomic<uint32_t>& waiters, COND cond,
+                          ShmDeadline deadline, const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    // Spin first: the peer is likely to respond within microseconds.
+    // Note: Spinning on a single CPU only delays the peer, so sleep right away.
+    static const int spinCount = (std::thread::hardware_concurrency() > 1 ? SHM_SPIN_COUNT : 0);
+    for(int i = 0; i < spinCount; i++)
+    {
+        if(cond())
+            return true;
+        CpuRelax();
+    }
+
+    // Then sleep on the futex. The peer wakes us up only if it sees the waiter flag,
+    // so the flag must be raised before the condition is checked again.
+    while(true)
+    {
+        waiters.fetch_add(1);
+        uint32_t value = seq.load();
+        if(cond())
+        {
+            waiters.fetch_sub(1);
+            return true;
+        }
+
+        if(cancel && cancel->load())
+        {
+            waiters.fetch_sub(1);
+            errMsg = "Shared memory transport is closed";
+            errno = ECANCELED;
+            return false;
+        }
+
+        auto remaining = deadline - std::chrono::steady_clock::now();
+        if(remaining <= std::chrono::microseconds(0))
+        {
+            waiters.fetch_sub(1);
+            errMsg = "Timed out waiting for the peer";
+            errno = ETIMEDOUT;
+            return false;
+        }
+
+        long sleepMs = std::min<long>(SHM_SLEEP_SLICE_MS,
+            std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count() + 1);
+        FutexWait(&seq, value, sleepMs);
+        waiters.fetch_sub(1);
+    }
+}
+
+inline void ShmRing::PublishHead(uint64_t head)
+{
+    mHeader->head.store(head);
+    mHeader->dataSeq.fetch_add(1);
+    if(mHeader->dataWaiters.load() > 0)
+        FutexWake(&mHeader->dataSeq);
+}
+
+inline void ShmRing::PublishTail(uint64_t tail)
+{
+    mHeader->tail.store(tail);
+    mHeader->spaceSeq.fetch_add(1);
+    if(mHeader->spaceWaiters.load() > 0)
+        FutexWake(&mHeader->spaceSeq);
+}
+
+inline bool ShmRing::Write(const iovec* iov, int iovCount, ShmDeadline deadline,
+                           const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    uint64_t head = mHeader->head.load(std::memory_order_relaxed);
+    uint64_t published = head;
+
+    for(int i = 0; i < iovCount; i++)
+    {
+        const char* data = static_cast<const char*>(iov[i].iov_base);
+        size_t left = iov[i].iov_len;
+
+        while(left > 0)
+        {
+            uint64_t tail = mHeader->tail.load(std::memory_order_acquire);
+            if(head - tail > mCapacity)
+            {
+                errMsg = "Shared memory ring is corrupted";
+                return false;
+            }
+
+            size_t space = mCapacity - (head - tail);
+            if(space == 0)
+            {
+                // Let the consumer drain what we've written so far and wait for space
+                if(published != head)
+                    PublishHead(published = head);
+
+                auto hasSpace = [&]() { return (head - mHeader->tail.load() < mCapacity); };
+                if(!Wait(mHeader->spaceSeq, mHeader->spaceWaiters, hasSpace, deadline, cancel, errMsg))
+                    return false;
+                continue;
+            }
+
+            // Copy with wrap-around
+            size_t count = std::min(left, space);
+            size_t offset = head % mCapacity;
+            size_t first = std::min(count, mCapacity - offset);
+            memcpy(mData + offset, data, first);
+            memcpy(mData, data + first, count - first);
+
+            head += count;
+            data += count;
+            left -= count;
+
+            // Large messages: publish in chunks so the consumer copies in parallel
+            if(head - published >= mCapacity / 4)
+                PublishHead(published = head);
+        }
+    }
+
+    if(published != head)
+        PublishHead(head);
+    return true;
+}
+
+inline bool ShmRing::Read(void* buf, size_t len, ShmDeadline deadline,
+                          const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    char* data = static_cast<char*>(buf);
+    uint64_t tail = mHeader->tail.load(std::memory_order_relaxed);
+
+    while(len > 0)
+    {
+        uint64_t head = mHeader->head.load(std::memory_order_acquire);
+        if(head - tail > mCapacity)
+        {
+            errMsg = "Shared memory ring is corrupted";
+            return false;
+        }
+
+        size_t available = head - tail;
+        if(available == 0)
+        {
+            auto hasData = [&]() { return (mHeader->head.load() != tail); };
+            if(!Wait(mHeader->dataSeq, mHeader->dataWaiters, hasData, deadline, cancel, errMsg))
+                return false;
+            continue;
+        }
+
+        // Copy with wrap-around
+        size_t count = std::min(len, available);
+        size_t offset = tail % mCapacity;
+        size_t first = std::min(count, mCapacity - offset);
+        memcpy(data, mData + offset, first);
+        memcpy(data + first, mData, count - first);
+
+        tail += count;
+        data += count;
+        len -= count;
+
+        PublishTail(tail);
+    }
+
+    return true;
+}
+
+//
+// Shared memory mapping holding both rings: client-to-server (requests)
+// and server-to-client (responses)
+//
+class ShmChannel
+{
+public:
+    ShmChannel() = default;
+    ~ShmChannel();
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    // Client: create the memfd and initialize the rings. The returned memfd
+    // is to be sent to the server and closed.
+    int Create(size_t ringSize, std::string& errMsg);
+
+    // Server: map the memfd received from the client (takes ownership of fd)
+    bool Attach(int fd, size_t ringSize, std::string& errMsg);
+
+    ShmRing& Requests() { return mRings[0]; }
+    ShmRing& Responses() { return mRings[1]; }
+
+    void WakeAll()
+    {
+        mRings[0].WakeAll();
+        mRings[1].WakeAll();
+    }
+
+private:
+    bool Map(int fd, size_t ringSize, std::string& errMsg);
+
+    void* mMem{MAP_FAILED};
+    size_t mSize{0};
+    ShmRing mRings[2];
+};
+
+inline ShmChannel::~ShmChannel()
+{
+    if(mMem != MAP_FAILED)
+        munmap(mMem, mSize);
+}
+
+inline bool ShmChannel::Map(int fd, size_t ringSize, std::string& errMsg)
+{
+    mSize = 2 * ShmRing::MappingSize(ringSize);
+    mMem = mmap(nullptr, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(mMem == MAP_FAILED)
+    {
+        errMsg = "mmap() failed: " + std::string(strerror(errno));
+        return false;
+    }
+
+    mRings[0].Attach(mMem, ringSize);
+    mRings[1].Attach(static_cast<char*>(mMem) + ShmRing::MappingSize(ringSize), ringSize);
+    return true;
+}
+
+inline int ShmChannel::Create(size_t ringSize, std::string& errMsg)
+{
+    // Keep the header cache line alignment for the second ring
+    if(ringSize == 0 || ringSize > SHM_MAX_RING_SIZE || ringSize % 64 != 0)
+    {
+        errMsg = "Invalid shared memory ring size " + std::to_string(ringSize);
+        return -1;
+    }
+
+    int fd = memfd_create("protorpc-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if(fd == -1)
+    {
+        errMsg = "memfd_create() failed: " + std::string(strerror(errno));
+        return -1;
+    }
+
+    // Seal the size, so the server can safely rely on it
+    if(ftruncate(fd, 2 * ShmRing::MappingSize(ringSize)) == -1 ||
+       fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1)
+    {
+        errMsg = "Failed to size the shared memory: " + std::string(strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    if(!Map(fd, ringSize, errMsg))
+    {
+        close(fd);
+        return -1;
+    }
+
+    // Note: memfd memory is zero-filled, but construct the headers anyway
+    for(size_t i = 0; i < 2; i++)
+    {
+        auto header = new (static_cast<char*>(mMem) + i * ShmRing::MappingSize(ringSize)) ShmRingHeader();
+        header->capacity = ringSize;
+    }
+
+    return fd;
+}
+
+inline bool ShmChannel::Attach(int fd, size_t ringSize, std::string& errMsg)
+{
+    // Check the memfd really holds both rings: the client can't shrink it later (sealed)
+    struct stat st;
+    int seals = fcntl(fd, F_GET_SEALS);
+    if(ringSize == 0 || ringSize > SHM_MAX_RING_SIZE || ringSize % 64 != 0 ||
+       fstat(fd, &st) == -1 || static_cast<size_t>(st.st_size) != 2 * ShmRing::MappingSize(ringSize) ||
+       seals == -1 || !(seals & F_SEAL_SHRINK))
+    {
+        errMsg = "Invalid shared memory from the client, ring size " + std::to_string(ringSize);
+        close(fd);
+        return false;
+    }
+
+    bool res = Map(fd, ringSize, errMsg);
+    close(fd);
+    return res;
+}
+
+//
+// Protocol frames over the rings: the same [code][length][data] layout
+// as on the socket. A whole request (or response) is written at once.
+//
+inline bool ShmSendFrames(ShmRing& ring, ProtoFrameWriter& writer, ShmDeadline deadline,
+                          const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    bool res = ring.Write(writer.Iov(), writer.IovCount(), deadline, cancel, errMsg);
+    writer.Clear();
+    return res;
+}
+
+inline bool ShmRecvInteger(ShmRing& ring, uint32_t& value, ShmDeadline deadline,
+                           const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    uint32_t data = 0;
+    if(!ring.Read(&data, sizeof(data), deadline, cancel, errMsg))
+        return false;
+    value = ntohl(data);
+    return true;
+}
+
+// Receive the data length and the data itself (the data code is already received)
+inline bool ShmRecvPayload(ShmRing& ring, std::string& data, ShmDeadline deadline,
+                           const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    uint32_t len32 = 0;
+    if(!ShmRecvInteger(ring, len32, deadline, cancel, errMsg))
+        return false;
+
+    // The PROTO_LONG_PAYLOAD marker is followed by the 64-bit length
+    uint64_t len = len32;
+    if(len32 == PROTO_LONG_PAYLOAD)
+    {
+        if(!ring.Read(&len, sizeof(len), deadline, cancel, errMsg))
+            return false;
+        len = be64toh(len);
+    }
+
+    return gen::ProtoRecvSegments(data, len, [&](char* buf, size_t segment)
+    {
+        return ring.Read(buf, segment, deadline, cancel, errMsg);
+    }, errMsg);
+}
+
+inline bool ShmRecvData(ShmRing& ring, PROTO_CODE code, std::string& data, ShmDeadline deadline,
+                        const std::atomic<bool>* cancel, std::string& errMsg)
+{
+    uint32_t value = 0;
+    if(!ShmRecvInteger(ring, value, deadline, cancel, errMsg) ||
+       !gen::ProtoValidateCode(value, code, errMsg))
+        return false;
+
+    return ShmRecvPayload(ring, data, deadline, cancel, errMsg);
+}
+
+} // namespace gen
+
+#endif // __SHM_COMMON_HPP__
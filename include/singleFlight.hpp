@@ -0,0 +1,129 @@
+//
+// singleFlight.hpp
+//
+#ifndef __SINGLE_FLIGHT_HPP__
+#define __SINGLE_FLIGHT_HPP__
+
+#include "responseCache.hpp"
+#include <condition_variable>
+
+namespace gen {
+
+//
+// Coalesce the identical calls in flight (see ProtoServer::BindOptions): the
+// first call with a key (the leader) runs the handler, the calls with the same
+// key that come meanwhile wait for it, for a bounded time, and share its
+// serialized response. Keyed as the response cache, sharded the same way.
+//
+class SingleFlight
+{
+public:
+    using Buffer = ResponseCache::Buffer;
+    using Key = ResponseCache::Key;
+
+    struct Flight
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        bool finished{false};
+
+        // The leader's outcome
+        bool shared{false};     // false: the response can't be shared, run the handler again
+        Buffer response;
+        std::string errMsg;
+    };
+
+    // Join the flight of key. leader is set if there was none: the caller runs the
+    // handler and calls Land(). Otherwise Wait() for the leader's outcome.
+    std::shared_ptr<Flight> Join(const Key& key, bool& leader);
+
+    // The leader is done: wake up the calls waiting for it
+    void Land(const Key& key, const std::shared_ptr<Flight>& flight, bool shared, Buffer response, std::string errMsg);
+
+    // false if the leader isn't done within timeout
+    static bool Wait(Flight& flight, std::chrono::milliseconds timeout)
+    {
+        std::unique_lock<std::mutex> lock(flight.mutex);
+        return flight.done.wait_for(lock, timeout, [&flight] { return flight.finished; });
+    }
+
+private:
+    struct Entry
+    {
+        uint32_t methodId;
+        std::string reqName;
+        std::string request;
+        std::string metadata;
+        std::shared_ptr<Flight> flight;
+
+        bool Matches(const Key& key) const
+        {
+            return (methodId == key.methodId && reqName == key.reqName &&
+                    metadata == key.metadata && request == key.request);
+        }
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_multimap<uint32_t, Entry> flights;
+    };
+
+    Shard& GetShard(uint32_t hash) { return mShards[(hash >> 16) % RESPONSE_CACHE_SHARDS]; }
+
+    Shard mShards[RESPONSE_CACHE_SHARDS];
+};
+
+inline std::shared_ptr<SingleFlight::Flight> SingleFlight::Join(const Key& key, bool& leader)
+{
+    Shard& shard = GetShard(key.hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto range = shard.flights.equal_range(key.hash);
+    for(auto itr = range.first; itr != range.second; ++itr)
+    {
+        if(itr->second.Matches(key))
+        {
+            leader = false;
+            return itr->second.flight;
+        }
+    }
+
+    leader = true;
+    auto flight = std::make_shared<Flight>();
+    shard.flights.emplace(key.hash, Entry{key.methodId, std::string(key.reqName), std::string(key.request),
+                                          key.metadata, flight});
+    return flight;
+}
+
+inline void SingleFlight::Land(const Key& key, const std::shared_ptr<Flight>& flight, bool shared,
+                               Buffer response, std::string errMsg)
+{
+    {
+        // The calls that come from now on start a new flight
+        Shard& shard = GetShard(key.hash);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto range = shard.flights.equal_range(key.hash);
+        for(auto itr = range.first; itr != range.second; ++itr)
+        {
+            if(itr->second.flight == flight)
+            {
+                shard.flights.erase(itr);
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(flight->mutex);
+        flight->shared = shared;
+        flight->response = std::move(response);
+        flight->errMsg = std::move(errMsg);
+        flight->finished = true;
+    }
+    flight->done.notify_all();
+}
+
+} // namespace gen
+
+#endif // __SINGLE_FLIGHT_HPP__
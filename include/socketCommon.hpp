@@ -7,12 +7,22 @@
 #include <unistd.h>
 #include <sys/socket.h>
 #include <poll.h>           // poll()
+#include <fcntl.h>
+#include <sys/sendfile.h>   // sendfile()
+#include <netinet/in.h>     // IP_RECVERR
+#include <linux/errqueue.h> // sock_extended_err (MSG_ZEROCOPY completions)
 #include <arpa/inet.h>      // htonl()/ntohl()
 #include <sys/un.h>
 #include <string.h>         // strerror()
 #include <string>
 #include <sstream>
 #include <chrono>
+#include <deque>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <algorithm>        // std::min()
 
 // victor test - for debugging
 //#include <iomanip>
@@ -106,8 +116,10 @@ inline int SetupServerSocket(unsigned short port, bool nonblocking,
     return sock;
 }
 
+// Note: sockType is SOCK_STREAM or SOCK_SEQPACKET (see SendRecord()/RecvRecord())
 inline int SetupServerDomainSocket(const char* sockName, bool isAbstract, 
-                                   int backlog, bool nonblocking, std::string& errMsg)
+                                   int backlog, bool nonblocking, std::string& errMsg,
+                                   int sockType = SOCK_STREAM)
 {
     if(!sockName || *sockName == '\0')
     {
@@ -116,7 +128,7 @@ inline int SetupServerDomainSocket(const char* sockName, bool isAbstract,
     }
 
     // Create socket
-    int sock = socket(AF_UNIX, (nonblocking ? SOCK_STREAM | SOCK_NONBLOCK : SOCK_STREAM), 0);
+    int sock = socket(AF_UNIX, (nonblocking ? sockType | SOCK_NONBLOCK : sockType), 0);
     if(sock == -1)
     {
         errMsg = "socket() failed: " + std::string(strerror(errno));
@@ -208,10 +220,11 @@ inline int SetupClientSocket(const char* host, int port, std::string& errMsg)
     return sock;
 }
 
-inline int SetupClientDomainSocket(const char* domainSocketPath, std::string& errMsg)
+inline int SetupClientDomainSocket(const char* domainSocketPath, std::string& errMsg,
+                                   int sockType = SOCK_STREAM)
 {
     // Create a socket
-    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    int sock = socket(AF_UNIX, sockType, 0);
     if(sock == -1)
     {
         errMsg = std::string("socket() failed: ") + strerror(errno);
@@ -246,6 +259,37 @@ inline int SetupClientDomainSocket(const char* domainSocketPath, std::string& er
     return sock;
 }
 
+// Wait until the socket is ready for events (POLLIN/POLLOUT). If timeout is 0, wait forever.
+inline bool WaitSocket(int sock, short events, long timeoutMs, std::string& errMsg)
+{
+    pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = events;
+    pfd.revents = 0;
+
+    int retval = -1;
+    while((retval = poll(&pfd, 1, (timeoutMs > 0 ? timeoutMs : -1))) == -1 && errno == EINTR)
+        ;
+
+    if(retval <= 0)
+    {
+        std::stringstream ss;
+        if(retval == 0)
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " Timed out after " << timeoutMs << " ms";
+            errno = ETIMEDOUT;
+        }
+        else
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " poll() failed: " << strerror(errno);
+        }
+        errMsg = std::move(ss.str());
+        return false;
+    }
+
+    return true;
+}
+
 // If timeout is 0, then Recv() will block until all the requested data is available.
 // Returns: true if succeeded, false otherwise with errno set to:
 //    ETIMEDOUT  - operation timed out
@@ -332,8 +376,10 @@ inline bool Recv(int sock, void* buf, size_t len, int flags, long timeoutMs, std
             }
             else if(errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                // No data available yet, but the call would not have blocked indefinitely.
-                // We should continue to the next iteration of the poll loop to wait for data
+                // No data available yet (nonblocking socket). With a timeout, the next
+                // iteration polls for data. Without, wait here instead of spinning.
+                if(timeoutMs <= 0 && !WaitSocket(sock, POLLIN, 0, errMsg))
+                    return false;
                 continue;
             }
             else
@@ -455,7 +501,10 @@ inline bool Send(int sock, const void* buf, size_t len, int flags, long timeoutM
             }
             else if(errno == EAGAIN || errno == EWOULDBLOCK)
             {
-                // Socket is non-blocking, try again later
+                // Socket buffer is full (nonblocking socket). With a timeout, the next
+                // iteration polls for writability. Without, wait here instead of spinning.
+                if(timeoutMs <= 0 && !WaitSocket(sock, POLLOUT, 0, errMsg))
+                    return false;
                 continue;
             }
             else if(errno == EPIPE || errno == ECONNRESET)
@@ -484,6 +533,966 @@ inline bool Send(int sock, const void* buf, size_t len, int flags, long timeoutM
     return true;
 }
 
+// Max number of file descriptors passed by one SendFds() call
+const size_t MAX_SEND_FDS = 16;
+
+// Send file descriptors over a Unix domain socket (SCM_RIGHTS) along with
+// a small data payload (at least one byte must be sent with the descriptors).
+inline bool SendFds(int sock, const int* fds, size_t fdsCount, const void* buf, size_t len, std::string& errMsg)
+{
+    if(fdsCount == 0 || fdsCount > MAX_SEND_FDS || len == 0)
+    {
+        errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " Invalid number of descriptors or empty data";
+        return false;
+    }
+
+    iovec iov;
+    iov.iov_base = const_cast<void*>(buf);
+    iov.iov_len = len;
+
+    char control[CMSG_SPACE(sizeof(int) * MAX_SEND_FDS)];
+    memset(control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdsCount);
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdsCount);
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fdsCount);
+
+    ssize_t bytesSent = -1;
+    while((bytesSent = sendmsg(sock, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+        ;
+
+    if(bytesSent != static_cast<ssize_t>(len))
+    {
+        std::stringstream ss;
+        ss << __FNAME__ << ":" << __LINE__ << " sendmsg(SCM_RIGHTS) failed: "
+           << (bytesSent == -1 ? strerror(errno) : "partial send");
+        errMsg = std::move(ss.str());
+        return false;
+    }
+
+    return true;
+}
+
+// Receive file descriptors sent by SendFds(). On input fdsCount is the capacity
+// of fds, on output it's the number of descriptors received. The data payload
+// must be exactly len bytes.
+inline bool RecvFds(int sock, int* fds, size_t& fdsCount, void* buf, size_t len, long timeoutMs, std::string& errMsg)
+{
+    if(timeoutMs > 0)
+    {
+        pollfd pfd;
+        pfd.fd = sock;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        int retval = -1;
+        while((retval = poll(&pfd, 1, timeoutMs)) == -1 && errno == EINTR)
+            ;
+
+        if(retval <= 0)
+        {
+            std::stringstream ss;
+            if(retval == 0)
+            {
+                ss << __FNAME__ << ":" << __LINE__ << " Timed out after " << timeoutMs << " ms";
+                errno = ETIMEDOUT;
+            }
+            else
+            {
+                ss << __FNAME__ << ":" << __LINE__ << " poll() failed: " << strerror(errno);
+            }
+            errMsg = std::move(ss.str());
+            return false;
+        }
+    }
+
+    iovec iov;
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    char control[CMSG_SPACE(sizeof(int) * MAX_SEND_FDS)];
+    memset(control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t bytesReceived = -1;
+    while((bytesReceived = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR)
+        ;
+
+    // Collect the received descriptors (close the ones that don't fit)
+    size_t capacity = fdsCount;
+    fdsCount = 0;
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i = 0; i < count; i++)
+        {
+            int fd = -1;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if(fdsCount < capacity)
+                fds[fdsCount++] = fd;
+            else
+                close(fd);
+        }
+    }
+
+    if(bytesReceived != static_cast<ssize_t>(len) || fdsCount == 0 || (msg.msg_flags & MSG_CTRUNC))
+    {
+        for(size_t i = 0; i < fdsCount; i++)
+            close(fds[i]);
+        fdsCount = 0;
+
+        std::stringstream ss;
+        ss << __FNAME__ << ":" << __LINE__ << " recvmsg(SCM_RIGHTS) failed: "
+           << (bytesReceived == -1 ? strerror(errno) : bytesReceived == 0 ? "connection closed by peer" : "unexpected message");
+        errMsg = std::move(ss.str());
+        return false;
+    }
+
+    return true;
+}
+
+// Check without blocking whether there is something to read on the socket
+// (data, end of stream or an error to be reported by the next read)
+inline bool IsReadable(int sock)
+{
+    char c = 0;
+    ssize_t res = -1;
+    while((res = recv(sock, &c, 1, MSG_PEEK | MSG_DONTWAIT)) == -1 && errno == EINTR)
+        ;
+    return (res != -1 || (errno != EAGAIN && errno != EWOULDBLOCK));
+}
+
+// SOCK_SEQPACKET sockets: send one record (message) gathered from iov with one
+// sendmsg(), along with the file descriptors (if any). The record is delivered whole.
+inline bool SendRecord(int sock, const iovec* iov, int iovCount, const int* fds, size_t fdsCount,
+                       long timeoutMs, std::string& errMsg)
+{
+    if(fdsCount > MAX_SEND_FDS)
+    {
+        errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " Too many descriptors";
+        return false;
+    }
+
+    char control[CMSG_SPACE(sizeof(int) * MAX_SEND_FDS)];
+    memset(control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = const_cast<iovec*>(iov);
+    msg.msg_iovlen = iovCount;
+
+    if(fdsCount > 0)
+    {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdsCount);
+
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdsCount);
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * fdsCount);
+    }
+
+    while(true)
+    {
+        if(timeoutMs > 0 && !WaitSocket(sock, POLLOUT, timeoutMs, errMsg))
+            return false;
+
+        if(sendmsg(sock, &msg, MSG_NOSIGNAL | (timeoutMs > 0 ? MSG_DONTWAIT : 0)) != -1)
+            return true;
+
+        if(errno == EINTR)
+            continue;
+
+        // Nonblocking socket without a timeout: wait instead of spinning
+        if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            if(timeoutMs <= 0 && !WaitSocket(sock, POLLOUT, 0, errMsg))
+                return false;
+            continue;
+        }
+
+        std::stringstream ss;
+        if(errno == EPIPE || errno == ECONNRESET)
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " Connection closed by peer: " << strerror(errno);
+            errno = ECONNRESET;
+        }
+        else
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " sendmsg() failed: " << strerror(errno);
+        }
+        errMsg = std::move(ss.str());
+        return false;
+    }
+}
+
+// SOCK_SEQPACKET sockets: receive one whole record into buf with one recvmsg().
+// On input fdsCount is the capacity of fds, on output it's the number of
+// descriptors received with the record.
+// Returns: true if succeeded, false otherwise with errno set to ENOTCONN
+// if the peer has closed the connection.
+inline bool RecvRecord(int sock, std::string& buf, int* fds, size_t& fdsCount, long timeoutMs, std::string& errMsg)
+{
+    size_t capacity = fdsCount;
+    fdsCount = 0;
+
+    if(timeoutMs > 0 && !WaitSocket(sock, POLLIN, timeoutMs, errMsg))
+        return false;
+
+    // Get the record size first, so it's never truncated
+    ssize_t len = -1;
+    while((len = recv(sock, nullptr, 0, MSG_PEEK | MSG_TRUNC)) == -1 && errno == EINTR)
+        ;
+
+    if(len <= 0)
+    {
+        std::stringstream ss;
+        if(len == 0)
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " Socket is not connected (recv returned 0)";
+            errno = ENOTCONN;
+        }
+        else
+        {
+            ss << __FNAME__ << ":" << __LINE__ << " recv() failed: " << strerror(errno);
+        }
+        errMsg = std::move(ss.str());
+        return false;
+    }
+
+    buf.resize(len);
+
+    iovec iov;
+    iov.iov_base = buf.data();
+    iov.iov_len = buf.size();
+
+    char control[CMSG_SPACE(sizeof(int) * MAX_SEND_FDS)];
+    memset(control, 0, sizeof(control));
+
+    msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    while((len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR)
+        ;
+
+    // Collect the received descriptors (close the ones that don't fit)
+    for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(size_t i = 0; i < count; i++)
+        {
+            int fd = -1;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if(fdsCount < capacity)
+                fds[fdsCount++] = fd;
+            else
+                close(fd);
+        }
+    }
+
+    if(len != static_cast<ssize_t>(buf.size()) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+        for(size_t i = 0; i < fdsCount; i++)
+            close(fds[i]);
+        fdsCount = 0;
+
+        std::stringstream ss;
+        ss << __FNAME__ << ":" << __LINE__ << " recvmsg() failed: "
+           << (len == -1 ? strerror(errno) : "truncated record");
+        errMsg = std::move(ss.str());
+        return false;
+    }
+
+    return true;
+}
+
+const size_t RECV_TO_FILE_CHUNK_SIZE = 1024 * 1024;   // Bytes moved by one splice()
+
+// Receive len bytes from the socket into the file (at its current offset) with
+// splice() through a pipe, so the data isn't copied through user space.
+// Falls back to recv()/write() for files that don't support splice (e.g. O_APPEND).
+// If timeout is 0, wait forever.
+inline bool RecvToFile(int sock, int fd, size_t len, long timeoutMs, std::string& errMsg)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    auto remainingMs = [&]() -> long
+    {
+        if(timeoutMs <= 0)
+            return 0;
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        return std::max(remaining.count(), 1L);
+    };
+
+    int pipeFds[2] = {-1, -1};
+    bool useSplice = (pipe2(pipeFds, O_CLOEXEC) == 0);
+    std::string buf;
+    size_t left = len;
+
+    while(left > 0)
+    {
+        if(timeoutMs > 0 && std::chrono::steady_clock::now() >= deadline)
+        {
+            errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " Timed out after " +
+                     std::to_string(timeoutMs) + " ms";
+            errno = ETIMEDOUT;
+            break;
+        }
+        if(!gen::WaitSocket(sock, POLLIN, remainingMs(), errMsg))
+            break;
+
+        ssize_t received = -1;
+        size_t count = std::min(left, RECV_TO_FILE_CHUNK_SIZE);
+        if(useSplice)
+        {
+            received = splice(sock, nullptr, pipeFds[1], nullptr, count, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            for(ssize_t pending = received; pending > 0; )
+            {
+                ssize_t written = splice(pipeFds[0], nullptr, fd, nullptr, pending, SPLICE_F_MOVE);
+                if(written <= 0)
+                {
+                    if(written == -1 && errno == EINTR)
+                        continue;
+                    if(written == -1 && errno == EINVAL && pending == received)
+                    {
+                        // The file doesn't support splice: move what's in the pipe with read()/write()
+                        useSplice = false;
+                        buf.resize(received);
+                        ssize_t n = read(pipeFds[0], buf.data(), received);
+                        if(n != received || write(fd, buf.data(), received) != received)
+                            received = -1;
+                        break;
+                    }
+                    received = -1;
+                    break;
+                }
+                pending -= written;
+            }
+        }
+        else
+        {
+            buf.resize(count);
+            received = recv(sock, buf.data(), count, MSG_DONTWAIT);
+            if(received > 0 && write(fd, buf.data(), received) != received)
+                received = -1;
+        }
+
+        if(received == 0)
+        {
+            errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " Socket is not connected (recv returned 0)";
+            errno = ENOTCONN;
+            break;
+        }
+        if(received == -1)
+        {
+            if(errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)
+                continue;
+            errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " Failed to receive to file: " + strerror(errno);
+            break;
+        }
+        left -= received;
+    }
+
+    if(pipeFds[0] != -1)
+    {
+        close(pipeFds[0]);
+        close(pipeFds[1]);
+    }
+    return (left == 0);
+}
+
+class BufferPool;
+
+//
+// The MSG_ZEROCOPY sends of a socket. Each send gets the next id, and the kernel
+// reads from its buffer until it reports the id completed on the socket's error
+// queue (in ranges, usually in order).
+//
+class ZeroCopySends
+{
+public:
+    uint32_t Next() { return mNext++; }     // Id of a new send
+    bool InFlight() const { return (mDone != mNext); }
+
+    // The kernel may read from the buffer until the send id (and those before) completes
+    void Keep(uint32_t id, std::string&& buffer) { mBuffers.emplace_back(id, std::move(buffer)); }
+
+    // Collect the completions from the error queue, and release the buffers of the
+    // completed sends: recycled to the pool, or freed. copied: the kernel copied the data anyway.
+    bool Reap(int sock, BufferPool* pool, bool& copied, std::string& errMsg);
+
+private:
+    void Complete(uint32_t first, uint32_t last);
+    static bool Before(uint32_t id1, uint32_t id2) { return (static_cast<int32_t>(id1 - id2) < 0); }
+
+    uint32_t mNext{0};                              // Id of the next send
+    uint32_t mDone{0};                              // All the sends before this id have completed
+    std::map<uint32_t, uint32_t> mRanges;           // Completed out of order: first -> last id
+    std::deque<std::pair<uint32_t, std::string>> mBuffers;  // Sent: the last id, and the buffer
+};
+
+//
+// Pool of large buffers, recycled between responses (e.g. the buffers of
+// zero-copy sends, once the kernel is done with them). Thread-safe.
+//
+class BufferPool
+{
+public:
+    explicit BufferPool(size_t maxBuffers = DEFAULT_MAX_POOL_BUFFERS) : mMaxBuffers(maxBuffers) {}
+    ~BufferPool();
+
+    // An empty string, with the capacity of a recycled buffer if there is one
+    std::string Get()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        ReapRetired();
+        if(mBuffers.empty())
+            return std::string();
+        std::string buffer = std::move(mBuffers.back());
+        mBuffers.pop_back();
+        return buffer;
+    }
+
+    void Put(std::string&& buffer)
+    {
+        buffer.clear();
+        std::lock_guard<std::mutex> lock(mMutex);
+        ReapRetired();
+        if(mBuffers.size() < mMaxBuffers)
+            mBuffers.push_back(std::move(buffer));
+    }
+
+    // A connection is being closed with zero-copy sends in flight: its buffers
+    // are kept until they complete (reaped as the pool is used), then freed.
+    // Note: The socket is shut down, the caller may close it.
+    void Retire(int sock, ZeroCopySends&& sends);
+
+    static const size_t DEFAULT_MAX_POOL_BUFFERS = 16;
+
+private:
+    void ReapRetired();
+
+    std::mutex mMutex;
+    std::vector<std::string> mBuffers;
+    size_t mMaxBuffers;
+    std::vector<std::pair<int, ZeroCopySends>> mRetired;    // A duplicate of the socket, and its sends
+};
+
+inline bool ZeroCopySends::Reap(int sock, BufferPool* pool, bool& copied, std::string& errMsg)
+{
+    for(;;)
+    {
+        char control[CMSG_SPACE(sizeof(sock_extended_err) + sizeof(sockaddr_in6))];
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if(recvmsg(sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) +
+                     " recvmsg(MSG_ERRQUEUE) failed: " + strerror(errno);
+            return false;
+        }
+
+        for(cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if(!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+               !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+                continue;
+
+            sock_extended_err serr;
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if(serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno != 0)
+                continue;
+
+            Complete(serr.ee_info, serr.ee_data);
+            if(serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                copied = true;
+        }
+    }
+
+    // Release the buffers of the completed sends
+    while(!mBuffers.empty() && Before(mBuffers.front().first, mDone))
+    {
+        if(pool)
+            pool->Put(std::move(mBuffers.front().second));
+        mBuffers.pop_front();
+    }
+    return true;
+}
+
+inline void ZeroCopySends::Complete(uint32_t first, uint32_t last)
+{
+    if(first != mDone)
+    {
+        mRanges[first] = last;
+        return;
+    }
+
+    mDone = last + 1;
+
+    // Merge the ranges that completed earlier, out of order
+    for(auto itr = mRanges.find(mDone); itr != mRanges.end(); itr = mRanges.find(mDone))
+    {
+        mDone = itr->second + 1;
+        mRanges.erase(itr);
+    }
+}
+
+inline BufferPool::~BufferPool()
+{
+    // Reset the connections still sending: the kernel drops their data, and the buffers with it
+    linger lin{1, 0};
+    for(auto& retired : mRetired)
+    {
+        setsockopt(retired.first, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+        close(retired.first);
+    }
+}
+
+inline void BufferPool::Retire(int sock, ZeroCopySends&& sends)
+{
+    // The duplicate keeps the socket open for the completions: shut it down for the peer
+    int dupFd = fcntl(sock, F_DUPFD_CLOEXEC, 0);
+    if(dupFd == -1)
+    {
+        // Reset the connection on close, so the kernel drops the data
+        linger lin{1, 0};
+        setsockopt(sock, SOL_SOCKET, SO_LINGER, &lin, sizeof(lin));
+        return;
+    }
+    shutdown(dupFd, SHUT_RDWR);
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRetired.emplace_back(dupFd, std::move(sends));
+    ReapRetired();
+}
+
+// Note: mMutex is held
+inline void BufferPool::ReapRetired()
+{
+    for(size_t i = 0; i < mRetired.size(); )
+    {
+        bool copied = false;
+        std::string errMsg;
+        auto& retired = mRetired[i];
+        if(retired.second.Reap(retired.first, nullptr, copied, errMsg) && retired.second.InFlight())
+        {
+            i++;
+            continue;
+        }
+
+        close(retired.first);
+        retired = std::move(mRetired.back());
+        mRetired.pop_back();
+    }
+}
+
+//
+// Per-connection output queue. Whole frames are queued and then written without
+// blocking, as far as the socket allows; the rest stays queued until the socket
+// is writable again. Descriptors queued with data are passed (SCM_RIGHTS) with
+// the first byte of that data, and closed once sent.
+//
+// With zero copy enabled (TCP), large data is sent with MSG_ZEROCOPY: the kernel
+// reads it from the queued buffer, which is kept until the completion arrives on
+// the socket's error queue (signaled as EPOLLERR), and then recycled to the pool.
+// If the connection is closed first, the pool keeps the buffer until then.
+//
+class OutputQueue
+{
+public:
+    OutputQueue() = default;
+    ~OutputQueue() { Clear(); }
+
+    // Small data is appended to the last chunk, so it's written with the neighbouring frames
+    void Add(const void* data, size_t len);
+    // Large data is queued as is (moved, not copied)
+    void Add(std::string&& data);
+    // Large data shared with other queues (e.g. a cached response) is queued by reference
+    void Add(const std::shared_ptr<const std::string>& data);
+    // Data passed with descriptors, sent with its own sendmsg(). The queue owns the descriptors.
+    void AddWithFds(const void* data, size_t len, const int* fds, size_t fdsCount);
+    // SOCK_SEQPACKET: one record, sent whole along with its descriptors (owned by the queue)
+    void AddRecord(std::string&& record, const int* fds, size_t fdsCount);
+    // SOCK_SEQPACKET: one record shared with other queues (e.g. a published message)
+    void AddRecord(const std::shared_ptr<const std::string>& record);
+    // A file range, sent with sendfile() straight from the page cache. The queue owns the descriptor.
+    // Note: sendfile() can't take MSG_NOSIGNAL, SIGPIPE must be ignored.
+    void AddFile(int fd, off_t offset, size_t length);
+
+    // Write as much as the socket takes without blocking.
+    // Returns: false on error, with errno set to ECONNRESET if the peer has closed the connection.
+    bool Flush(int sock, std::string& errMsg);
+
+    bool Empty() const { return mChunks.empty(); }
+    size_t Size() const { return mSize; }     // Bytes queued
+    void Clear();
+
+    // Send data of threshold bytes or more with MSG_ZEROCOPY (SO_ZEROCOPY must be set on the socket).
+    // Note: The queue must be cleared before the socket is closed.
+    void EnableZeroCopy(int sock, size_t threshold, BufferPool* pool)
+    {
+        mZeroCopySock = sock;
+        mZeroCopyThreshold = threshold;
+        mBufferPool = pool;
+    }
+    bool ZeroCopyEnabled() const { return (mZeroCopyThreshold != 0); }
+    // Zero-copy sends are waiting for their completions
+    bool InFlight() const { return mZeroCopySends.InFlight(); }
+    // Collect the completions from the error queue and release the buffers
+    bool ReapZeroCopy(int sock, std::string& errMsg);
+
+private:
+    struct Chunk
+    {
+        std::string data;
+        std::shared_ptr<const std::string> shared;  // Instead of data
+        size_t offset{0};       // Bytes already sent
+        std::vector<int> fds;   // Passed with the first byte
+        bool record{false};
+        bool zeroCopy{false};   // Sent alone, with MSG_ZEROCOPY
+        bool zeroCopySent{false};   // Partly sent with MSG_ZEROCOPY: the kernel may read from data
+        uint32_t lastId{0};     // Zero copy: id of the last send of this chunk
+        int fileFd{-1};         // A file range to send with sendfile() instead of data
+        off_t fileOffset{0};
+        size_t fileLength{0};   // Bytes left to send
+
+        const char* Data() const { return (shared ? shared->data() : data.data()); }
+        size_t Size() const { return (shared ? shared->size() : data.size()); }
+    };
+
+    bool FlushFile(int sock, Chunk& chunk, std::string& errMsg);
+
+    void PopFront();
+
+    // No copy constructors
+    OutputQueue(const OutputQueue&) = delete;
+    OutputQueue& operator=(const OutputQueue&) = delete;
+
+    static const size_t MAX_APPEND_SIZE = 16 * 1024;   // Larger data gets its own chunk
+    static const int MAX_FLUSH_IOV = 64;                // Chunks written by one sendmsg()
+
+    std::deque<Chunk> mChunks;
+    size_t mSize{0};
+
+    // Zero copy
+    int mZeroCopySock{-1};
+    size_t mZeroCopyThreshold{0};
+    BufferPool* mBufferPool{nullptr};
+    ZeroCopySends mZeroCopySends;
+};
+
+inline void OutputQueue::Add(const void* data, size_t len)
+{
+    if(mChunks.empty() || mChunks.back().record || !mChunks.back().fds.empty() || mChunks.back().zeroCopy ||
+       mChunks.back().zeroCopySent || mChunks.back().fileFd != -1 || mChunks.back().shared || mChunks.back().data.size() + len > MAX_APPEND_SIZE)
+        mChunks.emplace_back();
+
+    mChunks.back().data.append(static_cast<const char*>(data), len);
+    mSize += len;
+}
+
+inline void OutputQueue::Add(std::string&& data)
+{
+    if(data.size() <= MAX_APPEND_SIZE / 4)
+        return Add(data.data(), data.size());
+
+    mSize += data.size();
+    mChunks.emplace_back();
+    mChunks.back().data = std::move(data);
+    mChunks.back().zeroCopy = (mZeroCopyThreshold != 0 && mChunks.back().data.size() >= mZeroCopyThreshold);
+}
+
+inline void OutputQueue::Add(const std::shared_ptr<const std::string>& data)
+{
+    if(data->size() <= MAX_APPEND_SIZE / 4)
+        return Add(data->data(), data->size());
+
+    // Note: Not sent with MSG_ZEROCOPY, the buffer isn't recycled
+    mSize += data->size();
+    mChunks.emplace_back();
+    mChunks.back().shared = data;
+}
+
+inline void OutputQueue::AddWithFds(const void* data, size_t len, const int* fds, size_t fdsCount)
+{
+    mChunks.emplace_back();
+    mChunks.back().data.assign(static_cast<const char*>(data), len);
+    mChunks.back().fds.assign(fds, fds + fdsCount);
+    mSize += len;
+}
+
+inline void OutputQueue::AddRecord(std::string&& record, const int* fds, size_t fdsCount)
+{
+    mSize += record.size();
+    mChunks.emplace_back();
+    mChunks.back().data = std::move(record);
+    mChunks.back().fds.assign(fds, fds + fdsCount);
+    mChunks.back().record = true;
+}
+
+inline void OutputQueue::AddRecord(const std::shared_ptr<const std::string>& record)
+{
+    mSize += record->size();
+    mChunks.emplace_back();
+    mChunks.back().shared = record;
+    mChunks.back().record = true;
+}
+
+inline void OutputQueue::AddFile(int fd, off_t offset, size_t length)
+{
+    mSize += length;
+    mChunks.emplace_back();
+    mChunks.back().fileFd = fd;
+    mChunks.back().fileOffset = offset;
+    mChunks.back().fileLength = length;
+}
+
+inline void OutputQueue::PopFront()
+{
+    Chunk& chunk = mChunks.front();
+    mSize -= (chunk.Size() - chunk.offset + chunk.fileLength);
+    for(int fd : chunk.fds)
+        close(fd);
+    if(chunk.fileFd != -1)
+        close(chunk.fileFd);
+    mChunks.pop_front();
+}
+
+inline void OutputQueue::Clear()
+{
+    while(!mChunks.empty())
+    {
+        // The kernel may still read from a partly sent buffer
+        if(mChunks.front().zeroCopySent)
+            mZeroCopySends.Keep(mChunks.front().lastId, std::move(mChunks.front().data));
+        PopFront();
+    }
+
+    // Note: The connection is being closed. The kernel may still read from the
+    // buffers of the sends not completed: the pool keeps them until they are.
+    if(mZeroCopySends.InFlight() && mBufferPool && mZeroCopySock != -1)
+        mBufferPool->Retire(mZeroCopySock, std::move(mZeroCopySends));
+    mZeroCopySends = ZeroCopySends();
+}
+
+inline bool OutputQueue::ReapZeroCopy(int sock, std::string& errMsg)
+{
+    // The kernel copied the data anyway (e.g. loopback, or a device
+    // without scatter-gather): zero copy only costs here, stop using it
+    bool copied = false;
+    if(!mZeroCopySends.Reap(sock, mBufferPool, copied, errMsg))
+        return false;
+    if(copied)
+        mZeroCopyThreshold = 0;
+    return true;
+}
+
+inline bool OutputQueue::Flush(int sock, std::string& errMsg)
+{
+    if(InFlight() && !ReapZeroCopy(sock, errMsg))
+        return false;
+
+    while(!mChunks.empty())
+    {
+        if(mChunks.front().fileFd != -1)
+        {
+            // A file range: as much as the socket takes
+            if(!FlushFile(sock, mChunks.front(), errMsg))
+                return false;
+            if(mChunks.front().fileLength > 0)
+                return true;    // The rest is written when the socket is writable again
+            PopFront();
+            continue;
+        }
+
+        iovec iov[MAX_FLUSH_IOV];
+        int iovCount = 0;
+        char control[CMSG_SPACE(sizeof(int) * MAX_SEND_FDS)];
+
+        msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+
+        Chunk& first = mChunks.front();
+        if(first.record || !first.fds.empty() || first.zeroCopy)
+        {
+            // A record, data with descriptors, or zero-copy data: sent alone
+            iov[iovCount].iov_base = const_cast<char*>(first.Data() + first.offset);
+            iov[iovCount++].iov_len = first.Size() - first.offset;
+
+            if(!first.fds.empty())
+            {
+                size_t fdsCount = std::min(first.fds.size(), MAX_SEND_FDS);
+                memset(control, 0, sizeof(control));
+                msg.msg_control = control;
+                msg.msg_controllen = CMSG_SPACE(sizeof(int) * fdsCount);
+
+                cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level = SOL_SOCKET;
+                cmsg->cmsg_type = SCM_RIGHTS;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fdsCount);
+                memcpy(CMSG_DATA(cmsg), first.fds.data(), sizeof(int) * fdsCount);
+            }
+        }
+        else
+        {
+            // Gather the plain chunks up to the next one with descriptors
+            for(const Chunk& chunk : mChunks)
+            {
+                if(chunk.record || !chunk.fds.empty() || chunk.zeroCopy || chunk.fileFd != -1 || iovCount == MAX_FLUSH_IOV)
+                    break;
+                iov[iovCount].iov_base = const_cast<char*>(chunk.Data() + chunk.offset);
+                iov[iovCount++].iov_len = chunk.Size() - chunk.offset;
+            }
+        }
+        msg.msg_iovlen = iovCount;
+
+        ssize_t sent = sendmsg(sock, &msg, MSG_DONTWAIT | MSG_NOSIGNAL | (first.zeroCopy ? MSG_ZEROCOPY : 0));
+        if(sent == -1)
+        {
+            if(errno == EINTR)
+                continue;
+            if(errno == ENOBUFS && first.zeroCopy)
+            {
+                // Over the socket's optmem limit for zero-copy sends: copy this one
+                first.zeroCopy = false;
+                continue;
+            }
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;    // The rest is written when the socket is writable again
+
+            std::stringstream ss;
+            if(errno == EPIPE || errno == ECONNRESET)
+            {
+                ss << __FNAME__ << ":" << __LINE__ << " Connection closed by peer: " << strerror(errno);
+                errno = ECONNRESET;
+            }
+            else
+            {
+                ss << __FNAME__ << ":" << __LINE__ << " sendmsg() failed: " << strerror(errno);
+            }
+            errMsg = std::move(ss.str());
+            return false;
+        }
+
+        // The descriptors went with the first byte
+        for(int fd : first.fds)
+            close(fd);
+        first.fds.clear();
+
+        if(first.zeroCopy)
+        {
+            first.lastId = mZeroCopySends.Next();
+            first.zeroCopySent = true;
+        }
+
+        // Drop the chunks sent
+        size_t left = static_cast<size_t>(sent);
+        while(!mChunks.empty())
+        {
+            Chunk& chunk = mChunks.front();
+            size_t len = std::min(left, chunk.Size() - chunk.offset);
+            chunk.offset += len;
+            mSize -= len;
+            left -= len;
+            if(chunk.offset < chunk.Size() || chunk.fileFd != -1)
+                break;
+
+            if(chunk.zeroCopySent)
+            {
+                // The kernel reads from the buffer until the last zero-copy send of it
+                // completes (even if the rest was copied, see ENOBUFS above)
+                mZeroCopySends.Keep(chunk.lastId, std::move(chunk.data));
+                chunk.data.clear();
+                chunk.offset = 0;
+            }
+            PopFront();
+        }
+    }
+
+    return true;
+}
+
+inline bool OutputQueue::FlushFile(int sock, Chunk& chunk, std::string& errMsg)
+{
+    // Note: sendfile() has no MSG_DONTWAIT, make the socket nonblocking meanwhile
+    int flags = fcntl(sock, F_GETFL, 0);
+    if(flags == -1 || (!(flags & O_NONBLOCK) && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1))
+    {
+        errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " fcntl() failed: " + strerror(errno);
+        return false;
+    }
+
+    ssize_t sent = 0;
+    while(chunk.fileLength > 0)
+    {
+        while((sent = sendfile(sock, chunk.fileFd, &chunk.fileOffset, chunk.fileLength)) == -1 && errno == EINTR)
+            ;
+        if(sent <= 0)
+            break;
+        chunk.fileLength -= sent;
+        mSize -= sent;
+    }
+
+    int err = errno;
+    if(!(flags & O_NONBLOCK))
+        fcntl(sock, F_SETFL, flags);
+
+    if(sent == 0 && chunk.fileLength > 0)
+    {
+        // Note: The length is sent ahead, so the connection can't be used anymore
+        errMsg = std::string(__FNAME__) + ":" + std::to_string(__LINE__) + " sendfile() failed: the file is shorter than " +
+                 "the range queued";
+        errno = EIO;
+        return false;
+    }
+    if(sent == -1 && err != EAGAIN && err != EWOULDBLOCK)
+    {
+        std::stringstream ss;
+        if(err == EPIPE || err == ECONNRESET)
+            ss << __FNAME__ << ":" << __LINE__ << " Connection closed by peer: " << strerror(err);
+        else
+            ss << __FNAME__ << ":" << __LINE__ << " sendfile() failed: " << strerror(err);
+        errMsg = std::move(ss.str());
+        errno = (err == EPIPE ? ECONNRESET : err);
+        return false;
+    }
+    return true;
+}
+
 } // namespace gen
 
 #endif // __SOCKET_COMMON_HPP__
@@ -10,17 +10,28 @@
 #include <functional>           // std::function
 #include <list>                 // std::list
 #include <vector>               // std::vector
+#include <set>                  // std::set
+#include <atomic>               // std::atomic
+#include <new>                  // placement new
+#include <pthread.h>            // pthread_atfork()
 #include <assert.h>             // assert()
 
 //
 // A class ThreadPool to manage a pool of threads where the task function
 // can be different as specified by each request.
 //
+// ThreadPool is fork-safe: all pools are quiesced (locked) before fork(),
+// and in the child process they are only marked stale (the atfork child
+// handler may only make async-signal-safe calls). A stale pool is
+// reinitialized with a fresh state by its next call, and restarted with the
+// same number of threads if it was running. Requests posted in the parent
+// are not carried over to the child.
+//
 class ThreadPool
 {
 public:
-    ThreadPool() = default;
-    ~ThreadPool() { Destroy(); }
+    ThreadPool() { RegisterForFork(this); }
+    ~ThreadPool() { UnregisterForFork(this); Destroy(); }
 
     void Start(int threadCount);
 
@@ -45,6 +56,20 @@ public:
 private:
     void JoinThreads();
 
+    // Fork support (pthread_atfork handlers)
+    struct ForkRegistry
+    {
+        std::mutex mutex;
+        std::set<ThreadPool*> pools;
+    };
+    static ForkRegistry& GetForkRegistry();
+    static void RegisterForFork(ThreadPool* pool);
+    static void UnregisterForFork(ThreadPool* pool);
+    static void OnForkPrepare();
+    static void OnForkParent();
+    static void OnForkChild();
+    void CheckFork(bool restart = true);
+
     int mThreadCount{0};
     std::vector<std::thread> mThreads;
     std::mutex mMutex;
@@ -55,6 +80,7 @@ private:
     unsigned long mStoppedCount{0};
     unsigned long mReqCount{0};
     bool mHasMore{false};
+    std::atomic<bool> mForkStale{false};    // Inherited by a child process, not reset yet
 };
 
 //
@@ -82,7 +108,9 @@ private:
 //
 inline void ThreadPool::Start(int threadCount)
 {
+    CheckFork(false);
     assert(mThreads.empty());
+    mThreadCount = threadCount;
     mThreads.resize(threadCount);
 
     for(auto& thread : mThreads)
@@ -140,6 +168,8 @@ inline void ThreadPool::Start(int threadCount)
 template<class FUNC, class... ARGS>
 inline void ThreadPool::Post(FUNC&& func, ARGS&&... args)
 {
+    CheckFork();
+
     // Add request to the list for a next available thread to pick up
     {
         std::unique_lock<std::mutex> lock(mMutex);
@@ -157,6 +187,8 @@ inline void ThreadPool::Post(FUNC&& func, ARGS&&... args)
 // join itself because of deadlock.
 inline void ThreadPool::Wait()
 {
+    CheckFork();
+
     // Indicate that we are not going to add more
     // request and then wait for a "Done" notification
     std::unique_lock<std::mutex> lock(mMutex);
@@ -164,19 +196,15 @@ inline void ThreadPool::Wait()
     if(mReqCount == 0)
         return; // All requests are processed or never started
 
-    // We use loop to handle spurious wakeups
+    // We use loop to handle spurious wakeups. The state is checked before
+    // waiting: after Stop(), the threads may all be stopped already, leaving
+    // requests that will never run (mReqCount > 0) and no notification to come.
     while(true)
     {
-        mCvDone.wait(lock);
-
         if(mStop)
         {
             if(mStoppedCount == mThreads.size())
             {
-                // If are here because of "Stop" action, then
-                // all threads must be already stopped.
-                assert(mStoppedCount == mThreads.size());
-
                 // Wait for all threads to exit
                 JoinThreads();
 
@@ -189,6 +217,8 @@ inline void ThreadPool::Wait()
         {
             break;
         }
+
+        mCvDone.wait(lock);
     }
 }
 
@@ -198,6 +228,7 @@ inline void ThreadPool::Wait()
 inline void ThreadPool::Destroy()
 {
     // Stop all threads and wait for them to exit
+    CheckFork(false);
     Stop();
     JoinThreads();
 }
@@ -206,6 +237,7 @@ inline void ThreadPool::Destroy()
 // It can be called by any thread, including pool threads.
 inline void ThreadPool::Stop()
 {
+    CheckFork(false);
     std::unique_lock<std::mutex> lock(mMutex);
     if(mStop)
         return; // Already stopped or in a process of stopping
@@ -228,4 +260,98 @@ inline void ThreadPool::JoinThreads()
     mReqCount = 0;
 }
 
+inline ThreadPool::ForkRegistry& ThreadPool::GetForkRegistry()
+{
+    // Note: Function-local static of an inline function is
+    // shared by all translation units
+    static ForkRegistry registry;
+    static std::once_flag atforkFlag;
+    std::call_once(atforkFlag, []()
+    {
+        pthread_atfork(&ThreadPool::OnForkPrepare, &ThreadPool::OnForkParent, &ThreadPool::OnForkChild);
+    });
+    return registry;
+}
+
+inline void ThreadPool::RegisterForFork(ThreadPool* pool)
+{
+    ForkRegistry& registry = GetForkRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pools.insert(pool);
+}
+
+inline void ThreadPool::UnregisterForFork(ThreadPool* pool)
+{
+    ForkRegistry& registry = GetForkRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pools.erase(pool);
+}
+
+// Called in the parent before fork(): lock all pools, so the child
+// inherits them in a consistent state (no mutex is held half-way)
+inline void ThreadPool::OnForkPrepare()
+{
+    ForkRegistry& registry = GetForkRegistry();
+    registry.mutex.lock();
+    for(ThreadPool* pool : registry.pools)
+        pool->mMutex.lock();
+}
+
+// Called in the parent after fork()
+inline void ThreadPool::OnForkParent()
+{
+    ForkRegistry& registry = GetForkRegistry();
+    for(ThreadPool* pool : registry.pools)
+        pool->mMutex.unlock();
+    registry.mutex.unlock();
+}
+
+// Called in the child after fork(): only the forking thread exists, and only
+// async-signal-safe calls are allowed. Release the locks taken before fork()
+// and mark the pools stale; they are reset from normal code (see CheckFork()).
+inline void ThreadPool::OnForkChild()
+{
+    ForkRegistry& registry = GetForkRegistry();
+    for(ThreadPool* pool : registry.pools)
+    {
+        pool->mForkStale.store(true, std::memory_order_relaxed);
+        pool->mMutex.unlock();
+    }
+    registry.mutex.unlock();
+}
+
+// A pool inherited by a child process: reinitialize it with a fresh state,
+// and restart it with the same number of threads if it was running (and restart is set)
+inline void ThreadPool::CheckFork(bool restart)
+{
+    if(!mForkStale.load(std::memory_order_relaxed))
+        return;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if(!mForkStale.load(std::memory_order_relaxed))
+        return;
+
+    // The parent's threads may have been waiting on the condition variables.
+    // Reinitialize them, and forget the parent's threads without join() or detach().
+    new (&mCv) std::condition_variable();
+    new (&mCvDone) std::condition_variable();
+
+    bool wasRunning = (!mThreads.empty() && !mStop);
+    for(std::thread& thread : mThreads)
+        new (&thread) std::thread();
+    mThreads.clear();
+
+    // Start with a fresh state: requests belong to the parent
+    mReqList.clear();
+    mStop = false;
+    mStoppedCount = 0;
+    mReqCount = 0;
+    mHasMore = false;
+    mForkStale.store(false, std::memory_order_relaxed);
+
+    // Note: The new threads wait for the lock to be released
+    if(wasRunning && restart)
+        Start(mThreadCount);
+}
+
 #endif // __THREADPOOL_HPP__
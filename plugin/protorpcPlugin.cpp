@@ -0,0 +1,424 @@
+//
+// protorpcPlugin.cpp
+//
+// protoc-gen-protorpc: protoc plugin that generates, for every service
+// in a .proto file, a gen::ProtoServer service base class and a
+// gen::ProtoClient client stub (<name>.protorpc.h).
+//
+// Usage:
+//   protoc --plugin=protoc-gen-protorpc=<path> --protorpc_out=<dir> foo.proto
+//
+// The generated service base dispatches by method id (REQ_ID) through a
+// switch statement, so calls do not need a per-call string lookup and
+// several methods can share the same request type.
+//
+// Streaming methods get a StreamReader to read the request messages from
+// (rpc Foo(stream Req)) and/or a StreamWriter to write the response messages
+// to (returns (stream Resp)). Their client stubs take callbacks instead.
+//
+#include <google/protobuf/compiler/code_generator.h>
+#include <google/protobuf/compiler/plugin.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/io/printer.h>
+#include <google/protobuf/io/zero_copy_stream.h>
+#include <memory>
+#include <string>
+#include <map>
+#include "protoCommon.hpp"      // gen::MethodId()
+
+using google::protobuf::FileDescriptor;
+using google::protobuf::ServiceDescriptor;
+using google::protobuf::MethodDescriptor;
+using google::protobuf::Descriptor;
+using google::protobuf::io::Printer;
+using google::protobuf::compiler::GeneratorContext;
+
+class ProtoRpcGenerator : public google::protobuf::compiler::CodeGenerator
+{
+public:
+    ProtoRpcGenerator() = default;
+    virtual ~ProtoRpcGenerator() = default;
+
+    virtual bool Generate(const FileDescriptor* file, const std::string& parameter,
+                          GeneratorContext* context, std::string* error) const override;
+
+    virtual uint64_t GetSupportedFeatures() const override { return FEATURE_PROTO3_OPTIONAL; }
+
+private:
+    static std::string StripProto(const std::string& fileName);
+    static std::string ClassName(const Descriptor* descriptor);
+    static std::string HeaderGuard(const std::string& fileName);
+    static std::string MethodName(const MethodDescriptor* method);
+
+    void PrintMethodIds(Printer& printer, const ServiceDescriptor* service) const;
+    void PrintService(Printer& printer, const ServiceDescriptor* service) const;
+    void PrintClient(Printer& printer, const ServiceDescriptor* service) const;
+};
+
+std::string ProtoRpcGenerator::StripProto(const std::string& fileName)
+{
+    const std::string ext = ".proto";
+    if(fileName.size() >= ext.size() && fileName.compare(fileName.size() - ext.size(), ext.size(), ext) == 0)
+        return fileName.substr(0, fileName.size() - ext.size());
+    return fileName;
+}
+
+std::string ProtoRpcGenerator::ClassName(const Descriptor* descriptor)
+{
+    // Fully qualified C++ class name, e.g. "test.PingRequest" -> "::test::PingRequest"
+    std::string name = "::" + descriptor->full_name();
+    for(size_t pos = 0; (pos = name.find('.', pos)) != std::string::npos; )
+        name.replace(pos, 1, "::");
+    return name;
+}
+
+std::string ProtoRpcGenerator::HeaderGuard(const std::string& fileName)
+{
+    std::string guard = "__PROTORPC_" + StripProto(fileName) + "_H__";
+    for(char& c : guard)
+        c = (isalnum(static_cast<unsigned char>(c)) ? toupper(static_cast<unsigned char>(c)) : '_');
+    return guard;
+}
+
+std::string ProtoRpcGenerator::MethodName(const MethodDescriptor* method)
+{
+    // Full method name, the same as used by gRPC: "/package.Service/Method"
+    return "/" + method->service()->full_name() + "/" + method->name();
+}
+
+bool ProtoRpcGenerator::Generate(const FileDescriptor* file, const std::string& /*parameter*/,
+                                 GeneratorContext* context, std::string* error) const
+{
+    if(file->service_count() == 0)
+        return true; // Nothing to generate
+
+    // Method ids must be unique: the service base dispatches on them.
+    // Note: Services of different files are checked when they are registered with
+    // the same server (see ProtoServer::RegisterMethodIds()).
+    std::map<uint32_t, std::string> methodIds;
+    for(int i = 0; i < file->service_count(); i++)
+    {
+        const ServiceDescriptor* service = file->service(i);
+        for(int j = 0; j < service->method_count(); j++)
+        {
+            const MethodDescriptor* method = service->method(j);
+            std::string name = MethodName(method);
+            auto res = methodIds.emplace(gen::MethodId(name.c_str()), name);
+            if(!res.second)
+            {
+                *error = "Method id collision between " + res.first->second + " and " + name;
+                return false;
+            }
+        }
+    }
+
+    std::string baseName = StripProto(file->name());
+    std::unique_ptr<google::protobuf::io::ZeroCopyOutputStream> output(context->Open(baseName + ".protorpc.h"));
+    Printer printer(output.get(), '$');
+
+    std::map<std::string, std::string> vars;
+    vars["file"] = file->name();
+    vars["guard"] = HeaderGuard(file->name());
+    vars["pb_h"] = baseName + ".pb.h";
+
+    printer.Print(vars,
+        "//\n"
+        "// Generated by protoc-gen-protorpc. DO NOT EDIT!\n"
+        "// source: $file$\n"
+        "//\n"
+        "#ifndef $guard$\n"
+        "#define $guard$\n"
+        "\n"
+        "#include \"$pb_h$\"\n"
+        "#include \"protoServer.hpp\"\n"
+        "#include \"protoClient.hpp\"\n"
+        "\n");
+
+    // Open the package namespace(s)
+    std::string package = file->package();
+    std::vector<std::string> namespaces;
+    for(size_t start = 0, end = 0; !package.empty() && end != std::string::npos; start = end + 1)
+    {
+        end = package.find('.', start);
+        namespaces.push_back(package.substr(start, end == std::string::npos ? end : end - start));
+    }
+
+    for(const std::string& ns : namespaces)
+        printer.Print("namespace $ns$ {\n", "ns", ns);
+    if(!namespaces.empty())
+        printer.Print("\n");
+
+    for(int i = 0; i < file->service_count(); i++)
+    {
+        PrintMethodIds(printer, file->service(i));
+        PrintService(printer, file->service(i));
+        PrintClient(printer, file->service(i));
+    }
+
+    for(auto itr = namespaces.rbegin(); itr != namespaces.rend(); ++itr)
+        printer.Print("} // namespace $ns$\n", "ns", *itr);
+
+    printer.Print(vars,
+        "\n"
+        "#endif // $guard$\n");
+
+    if(printer.failed())
+    {
+        *error = "Failed to write " + baseName + ".protorpc.h";
+        return false;
+    }
+    return true;
+}
+
+void ProtoRpcGenerator::PrintMethodIds(Printer& printer, const ServiceDescriptor* service) const
+{
+    std::map<std::string, std::string> vars;
+    vars["service"] = service->name();
+
+    // The ids are constants of their own, so the client stub doesn't need the service base
+    printer.Print(vars,
+        "//\n"
+        "// $service$Methods: method ids (REQ_ID) of service $service$\n"
+        "//\n"
+        "struct $service$Methods\n"
+        "{\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        printer.Print("    static constexpr uint32_t $method$Id = gen::MethodId(\"$name$\");\n",
+                      "method", method->name(), "name", MethodName(method));
+    }
+
+    printer.Print("};\n\n");
+}
+
+void ProtoRpcGenerator::PrintService(Printer& printer, const ServiceDescriptor* service) const
+{
+    std::map<std::string, std::string> vars;
+    vars["service"] = service->name();
+
+    // Service base class. BASE allows several generated services
+    // to be chained into a single server:
+    //   class MyServer : public FooService<BarService<>> { ... };
+    printer.Print(vars,
+        "//\n"
+        "// $service$Service: ProtoServer base class for service $service$\n"
+        "//\n"
+        "template<class BASE = gen::ProtoServer>\n"
+        "class $service$Service : public BASE\n"
+        "{\n"
+        "public:\n"
+        "    using BASE::BASE;\n"
+        "    virtual ~$service$Service() = default;\n"
+        "\n");
+
+    printer.Indent();
+    printer.Indent();
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        printer.Print("static constexpr uint32_t $method$Id = $service$Methods::$method$Id;\n",
+                      "method", method->name(), "service", service->name());
+    }
+    printer.Outdent();
+    printer.Outdent();
+
+    printer.Print(vars,
+        "\n"
+        "protected:\n"
+        "    using typename BASE::Context;\n"
+        "    using typename BASE::Handler;\n");
+
+    bool clientStreaming = false, serverStreaming = false;
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        clientStreaming = (clientStreaming || service->method(i)->client_streaming());
+        serverStreaming = (serverStreaming || service->method(i)->server_streaming());
+    }
+    if(clientStreaming)
+        printer.Print("    template<class REQ> using StreamReader = typename BASE::template StreamReader<REQ>;\n");
+    if(serverStreaming)
+        printer.Print("    template<class RESP> using StreamWriter = typename BASE::template StreamWriter<RESP>;\n");
+
+    printer.Print(vars,
+        "\n"
+        "    // Service methods to implement\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        std::string in = (method->client_streaming() ? "StreamReader<$req$>& reader" : "const $req$& req");
+        std::string out = (method->server_streaming() ? "StreamWriter<$resp$>& writer" : "$resp$& resp");
+        printer.Print(("    virtual void On$method$(const Context& ctx, " + in + ", " + out + ") = 0;\n").c_str(),
+                      "method", method->name(),
+                      "req", ClassName(method->input_type()),
+                      "resp", ClassName(method->output_type()));
+    }
+
+    printer.Print(vars,
+        "\n"
+        "    // Method id dispatch\n"
+        "    virtual Handler* GetMethodHandler(uint32_t methodId) override\n"
+        "    {\n"
+        "        switch(methodId)\n"
+        "        {\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        printer.Print("        case $method$Id: return &m$method$Handler;\n", "method", method->name());
+    }
+
+    printer.Print(vars,
+        "        default: return BASE::GetMethodHandler(methodId);\n"
+        "        }\n"
+        "    }\n"
+        "\n"
+        "private:\n"
+        "    // The ids are checked against those of the other services of the server\n"
+        "    const bool mMethodIdsRegistered{this->RegisterMethodIds({\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        printer.Print("        {$method$Id, \"$name$\"}$sep$\n", "method", method->name(), "name", MethodName(method),
+                      "sep", (i + 1 < service->method_count() ? "," : ""));
+    }
+    printer.Print("    })};\n"
+                  "\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        printer.Print("    typename BASE::template $impl$<$service$Service, $req$, $resp$> m$method$Handler"
+                      "{this, &$service$Service::On$method$};\n",
+                      "impl", (method->client_streaming() ?
+                               (method->server_streaming() ? "BidiStreamHandlerImpl" : "ClientStreamHandlerImpl") :
+                               (method->server_streaming() ? "StreamHandlerImpl" : "HandlerImpl")),
+                      "service", service->name(),
+                      "method", method->name(),
+                      "req", ClassName(method->input_type()),
+                      "resp", ClassName(method->output_type()));
+    }
+
+    printer.Print("};\n\n");
+}
+
+void ProtoRpcGenerator::PrintClient(Printer& printer, const ServiceDescriptor* service) const
+{
+    std::map<std::string, std::string> vars;
+    vars["service"] = service->name();
+
+    printer.Print(vars,
+        "//\n"
+        "// $service$Client: ProtoClient stub for service $service$\n"
+        "//\n"
+        "class $service$Client : public gen::ProtoClient\n"
+        "{\n"
+        "public:\n"
+        "    using gen::ProtoClient::ProtoClient;\n"
+        "\n");
+
+    for(int i = 0; i < service->method_count(); i++)
+    {
+        const MethodDescriptor* method = service->method(i);
+        std::map<std::string, std::string> mvars = vars;
+        mvars["method"] = method->name();
+        mvars["req"] = ClassName(method->input_type());
+        mvars["resp"] = ClassName(method->output_type());
+
+        if(i > 0)
+            printer.Print("\n");
+
+        if(method->client_streaming())
+        {
+            // Client streaming: the single response message, or a callback per message (bidirectional)
+            mvars["out"] = (method->server_streaming() ? "const std::function<bool(const " + mvars["resp"] + "&)>& onMessage" :
+                                                         mvars["resp"] + "& resp");
+            mvars["outArg"] = (method->server_streaming() ? "onMessage" : "resp");
+            printer.Print(mvars,
+                "    // Client streaming: nextRequest fills the next message, or returns false at the end of the stream\n"
+                "    bool $method$(const std::function<bool($req$&)>& nextRequest,\n"
+                "            $out$,\n"
+                "            const std::map<std::string, std::string>& metadata,\n"
+                "            std::string& errMsg, long timeoutMs = 5000)\n"
+                "    {\n"
+                "        $req$ req;\n");
+            if(method->server_streaming())
+                printer.Print(mvars,
+                    "        $resp$ resp;\n"
+                    "        return CallBidiStream($service$Methods::$method$Id, req, [&]() { req.Clear(); return nextRequest(req); },\n"
+                    "                              resp, [&]() { return onMessage(resp); }, metadata, errMsg, timeoutMs);\n");
+            else
+                printer.Print(mvars,
+                    "        return CallBidiStream($service$Methods::$method$Id, req, [&]() { req.Clear(); return nextRequest(req); },\n"
+                    "                              resp, []() { return true; }, metadata, errMsg, timeoutMs);\n");
+            printer.Print(mvars,
+                "    }\n"
+                "\n"
+                "    bool $method$(const std::function<bool($req$&)>& nextRequest,\n"
+                "            $out$,\n"
+                "            std::string& errMsg, long timeoutMs = 5000)\n"
+                "    {\n"
+                "        return $method$(nextRequest, $outArg$, std::map<std::string, std::string>(), errMsg, timeoutMs);\n"
+                "    }\n");
+            continue;
+        }
+
+        if(method->server_streaming())
+        {
+            printer.Print(mvars,
+                "    // Server streaming: onMessage is called with each message, returning false cancels the call\n"
+                "    bool $method$(const $req$& req,\n"
+                "            const std::function<bool(const $resp$&)>& onMessage,\n"
+                "            const std::map<std::string, std::string>& metadata,\n"
+                "            std::string& errMsg, long timeoutMs = 5000)\n"
+                "    {\n"
+                "        $resp$ resp;\n"
+                "        return CallStream($service$Methods::$method$Id, req, resp,\n"
+                "                          [&]() { return onMessage(resp); }, metadata, errMsg, timeoutMs);\n"
+                "    }\n"
+                "\n"
+                "    bool $method$(const $req$& req,\n"
+                "            const std::function<bool(const $resp$&)>& onMessage,\n"
+                "            std::string& errMsg, long timeoutMs = 5000)\n"
+                "    {\n"
+                "        return $method$(req, onMessage, std::map<std::string, std::string>(), errMsg, timeoutMs);\n"
+                "    }\n");
+            continue;
+        }
+
+        printer.Print(mvars,
+            "    bool $method$(const $req$& req, $resp$& resp,\n"
+            "            const std::map<std::string, std::string>& metadata,\n"
+            "            std::string& errMsg, long timeoutMs = 5000)\n"
+            "    {\n"
+            "        return Call($service$Methods::$method$Id, req, resp, metadata, errMsg, timeoutMs);\n"
+            "    }\n"
+            "\n"
+            "    bool $method$(const $req$& req, $resp$& resp,\n"
+            "            std::string& errMsg, long timeoutMs = 5000)\n"
+            "    {\n"
+            "        return Call($service$Methods::$method$Id, req, resp,\n"
+            "                    std::map<std::string, std::string>(), errMsg, timeoutMs);\n"
+            "    }\n"
+            "\n"
+            "    // Receives the file attached to the response (see gen::ProtoAttachment)\n"
+            "    bool $method$(const $req$& req, $resp$& resp,\n"
+            "            const std::map<std::string, std::string>& metadata,\n"
+            "            gen::ProtoAttachment& attachment,\n"
+            "            std::string& errMsg, long timeoutMs = 5000)\n"
+            "    {\n"
+            "        return Call($service$Methods::$method$Id, req, resp, metadata, attachment, errMsg, timeoutMs);\n"
+            "    }\n");
+    }
+
+    printer.Print("};\n\n");
+}
+
+int main(int argc, char* argv[])
+{
+    ProtoRpcGenerator generator;
+    return google::protobuf::compiler::PluginMain(argc, argv, &generator);
+}
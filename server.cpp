@@ -3,7 +3,7 @@
 //
 #include "epollServer.hpp"
 #include "protoServer.hpp"
-#include "hello.pb.h"
+#include "hello.protorpc.h"
 #include <signal.h>
 
 // Handler for SIGHUP, SIGINT, SIGQUIT and SIGTERM
@@ -36,17 +36,18 @@ int Signal(int signum, void (*handler)(int))
     return sigaction(signum, &sa, &old_sa);
 }
 
-class MyServer : public gen::ProtoServer
+class MyServer : public test::GreeterService<>
 {
 public:
-    MyServer(size_t threadsCount) : gen::ProtoServer(threadsCount) {}
+    MyServer(size_t threadsCount) : test::GreeterService<>(threadsCount) {}
     MyServer() = delete;
     virtual ~MyServer() = default;
 
 private:
     virtual bool OnInit() override
     {
-        Bind(&MyServer::OnPing);
+        // Greeter methods are dispatched by the generated GreeterService base.
+        // Handlers can also be bound by request type name, e.g. Bind(&MyServer::OnPing).
         return true;
     }
 
@@ -60,9 +61,9 @@ private:
         std::cout << fname << ":" << lineNum << " " << info << std::endl;
     }
 
-    void OnPing(const Context& ctx,
-                const test::PingRequest& req,
-                test::PingResponse& resp)
+    virtual void OnPing(const Context& /*ctx*/,
+                        const test::PingRequest& /*req*/,
+                        test::PingResponse& resp) override
     {
     //    std::cout << __func__
     //              << ": sessionId='" << ctx.GetMetadata("sessionId") << "'"
@@ -89,6 +90,13 @@ int main()
     unsigned int threadsCount = std::thread::hardware_concurrency();
     MyServer server(threadsCount);
 //    server.SetVerbose(true);
+//    server.SetWorkerProcesses(4);   // Pre-fork mode with 4 worker processes
+//    server.SetHandoffSocket("protorpc_handoff.sock", true);   // Zero-downtime restart: start a new server to take over
+//    server.SetShmTransport(true);   // Allow clients to switch to shared memory (ProtoClient::InitShm())
+//    server.SetSeqPacket(true);      // SOCK_SEQPACKET Unix domain socket (ProtoClient::Init(path, errMsg, true))
+//    server.SetImmediateWrite(true); // Reply from the worker right away, persistent epoll registration
+//    server.SetOutputHighWaterMark(1024 * 1024);   // Stop reading from a client with 1 MB of replies unsent
+//    server.SetZeroCopyThreshold(64 * 1024);       // TCP: send responses of 64 KB or more with MSG_ZEROCOPY
 
     // Start a helper thread to observer exit signal
     std::thread signalObserverThread([&server]() 